@@ -0,0 +1,12 @@
+#include "buffer.hpp"
+#include "gl_state.hpp"
+
+Buffer::Buffer(size_t size, const void *data, GLbitfield flags) : size(size) {
+  glCreateBuffers(1, &id);
+  glNamedBufferStorage(id, (GLsizeiptr)size, data, flags);
+}
+
+Buffer::~Buffer() {
+  glState().forgetBuffer(id);
+  glDeleteBuffers(1, &id);
+}
@@ -0,0 +1,21 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <glad/gl.h>
+#include <cstddef>
+
+// Immutable GL buffer created through direct state access
+class Buffer {
+public:
+  GLuint id = 0;
+  size_t size = 0;
+
+  // flags are glNamedBufferStorage flags, 0 makes the contents fixed after creation
+  Buffer(size_t size, const void *data, GLbitfield flags = 0);
+  ~Buffer();
+
+  Buffer(const Buffer &) = delete;
+  Buffer &operator=(const Buffer &) = delete;
+};
+
+#endif
@@ -0,0 +1,366 @@
+#include "buffer_arena.hpp"
+#include <algorithm>
+#include <cstdio>
+
+static inline int highestBit(uint64_t value) { return 63 - __builtin_clzll(value); }
+static inline int lowestBit(uint64_t value) { return __builtin_ctzll(value); }
+
+TlsfAllocator::TlsfAllocator(size_t capacity) : totalSize(capacity) {
+  for (auto &row : freeLists) {
+    std::fill(std::begin(row), std::end(row), INVALID_BLOCK);
+  }
+  if (capacity > 0) {
+    uint32_t block = newNode();
+    blocks[block] = {0, capacity, INVALID_BLOCK, INVALID_BLOCK, INVALID_BLOCK, INVALID_BLOCK, true};
+    last = block;
+    insertFree(block);
+  }
+}
+
+void TlsfAllocator::mapping(size_t size, int &fl, int &sl) {
+  // Sizes below SL_COUNT get one exact list each, larger ones split every power of two range into SL_COUNT lists
+  if (size < (size_t)SL_COUNT) {
+    fl = 0;
+    sl = (int)size;
+  } else {
+    int msb = highestBit(size);
+    sl = (int)((size >> (msb - SL_BITS)) ^ SL_COUNT);
+    fl = msb - SL_BITS + 1;
+  }
+}
+
+uint32_t TlsfAllocator::newNode() {
+  if (!unusedNodes.empty()) {
+    uint32_t node = unusedNodes.back();
+    unusedNodes.pop_back();
+    return node;
+  }
+  blocks.push_back(Block());
+  return (uint32_t)(blocks.size() - 1);
+}
+
+void TlsfAllocator::insertFree(uint32_t block) {
+  int fl, sl;
+  mapping(blocks[block].size, fl, sl);
+  uint32_t head = freeLists[fl][sl];
+  blocks[block].free = true;
+  blocks[block].prevFree = INVALID_BLOCK;
+  blocks[block].nextFree = head;
+  if (head != INVALID_BLOCK) {
+    blocks[head].prevFree = block;
+  }
+  freeLists[fl][sl] = block;
+  flBitmap |= 1ull << fl;
+  slBitmap[fl] |= 1u << sl;
+  freeBlocks++;
+}
+
+void TlsfAllocator::removeFree(uint32_t block) {
+  int fl, sl;
+  mapping(blocks[block].size, fl, sl);
+  Block &b = blocks[block];
+  if (b.prevFree != INVALID_BLOCK) {
+    blocks[b.prevFree].nextFree = b.nextFree;
+  } else {
+    freeLists[fl][sl] = b.nextFree;
+    if (b.nextFree == INVALID_BLOCK) {
+      slBitmap[fl] &= ~(1u << sl);
+      if (slBitmap[fl] == 0) {
+        flBitmap &= ~(1ull << fl);
+      }
+    }
+  }
+  if (b.nextFree != INVALID_BLOCK) {
+    blocks[b.nextFree].prevFree = b.prevFree;
+  }
+  b.free = false;
+  freeBlocks--;
+}
+
+uint32_t TlsfAllocator::allocate(size_t size) {
+  if (size == 0) {
+    size = 1;
+  }
+
+  size_t rounded = roundUp(size);
+  int fl, sl;
+  mapping(rounded, fl, sl);
+  if (fl >= FL_COUNT) {
+    return INVALID_BLOCK;
+  }
+
+  uint32_t slMap = slBitmap[fl] & (~0u << sl);
+  if (slMap == 0) {
+    uint64_t flMap = fl + 1 < 64 ? flBitmap & (~0ull << (fl + 1)) : 0;
+    if (flMap == 0) {
+      return INVALID_BLOCK;
+    }
+    fl = lowestBit(flMap);
+    slMap = slBitmap[fl];
+  }
+  sl = lowestBit(slMap);
+
+  uint32_t block = freeLists[fl][sl];
+  removeFree(block);
+
+  // Return the tail to the free lists
+  if (blocks[block].size > size) {
+    uint32_t rest = newNode();
+    Block &b = blocks[block];
+    blocks[rest] = {b.offset + size, b.size - size, block, b.nextPhysical, INVALID_BLOCK, INVALID_BLOCK, true};
+    if (b.nextPhysical != INVALID_BLOCK) {
+      blocks[b.nextPhysical].prevPhysical = rest;
+    } else {
+      last = rest;
+    }
+    b.nextPhysical = rest;
+    b.size = size;
+    insertFree(rest);
+  }
+  usedSize += blocks[block].size;
+  return block;
+}
+
+size_t TlsfAllocator::roundUp(size_t size) {
+  // Round up to the start of the next list, so every block found there is guaranteed to fit
+  if (size >= (size_t)SL_COUNT) {
+    size += ((size_t)1 << (highestBit(size) - SL_BITS)) - 1;
+  }
+  return size;
+}
+
+uint32_t TlsfAllocator::merge(uint32_t block, uint32_t next) {
+  // Absorb next into block and recycle its node
+  Block &b = blocks[block];
+  Block &n = blocks[next];
+  b.size += n.size;
+  b.nextPhysical = n.nextPhysical;
+  if (n.nextPhysical != INVALID_BLOCK) {
+    blocks[n.nextPhysical].prevPhysical = block;
+  } else {
+    last = block;
+  }
+  unusedNodes.push_back(next);
+  return block;
+}
+
+void TlsfAllocator::free(uint32_t block) {
+  usedSize -= blocks[block].size;
+
+  uint32_t next = blocks[block].nextPhysical;
+  if (next != INVALID_BLOCK && blocks[next].free) {
+    removeFree(next);
+    merge(block, next);
+  }
+  uint32_t previous = blocks[block].prevPhysical;
+  if (previous != INVALID_BLOCK && blocks[previous].free) {
+    removeFree(previous);
+    block = merge(previous, block);
+  }
+  insertFree(block);
+}
+
+size_t TlsfAllocator::largestFree() const {
+  if (flBitmap == 0) {
+    return 0;
+  }
+  // The largest block is in the highest non-empty list, which is short in practice
+  int fl = highestBit(flBitmap);
+  int sl = highestBit(slBitmap[fl]);
+  size_t largest = 0;
+  for (uint32_t block = freeLists[fl][sl]; block != INVALID_BLOCK; block = blocks[block].nextFree) {
+    largest = std::max(largest, blocks[block].size);
+  }
+  return largest;
+}
+
+BufferArena::BufferArena(size_t pageSize, size_t granularity)
+    : pageSize((pageSize + granularity - 1) / granularity * granularity), granularity(granularity) {}
+
+uint32_t BufferArena::addPage(size_t size) {
+  auto buffer = std::make_unique<Buffer>(size, nullptr, (GLbitfield)GL_DYNAMIC_STORAGE_BIT);
+  pages.push_back(std::unique_ptr<Page>(new Page{std::move(buffer), TlsfAllocator(units(size)), {}}));
+  return (uint32_t)(pages.size() - 1);
+}
+
+void BufferArena::setOwner(uint32_t page, uint32_t block, uint32_t id) {
+  std::vector<uint32_t> &owners = pages[page]->owners;
+  if (block >= owners.size()) {
+    owners.resize(block + 1, INVALID_ALLOCATION);
+  }
+  owners[block] = id;
+}
+
+uint32_t BufferArena::allocate(size_t size, const void *data) {
+  // First page with room, or a new one. An oversized allocation fills a page sized for it, which later requests and
+  // defragmentation simply find full.
+  uint32_t page = 0, block = TlsfAllocator::INVALID_BLOCK;
+  for (; page < pages.size(); page++) {
+    block = pages[page]->allocator.allocate(units(size));
+    if (block != TlsfAllocator::INVALID_BLOCK) {
+      break;
+    }
+  }
+  if (block == TlsfAllocator::INVALID_BLOCK) {
+    page = addPage(std::max(pageSize, TlsfAllocator::roundUp(units(size)) * granularity));
+    block = pages[page]->allocator.allocate(units(size));
+  }
+
+  uint32_t id;
+  if (!unusedIds.empty()) {
+    id = unusedIds.back();
+    unusedIds.pop_back();
+  } else {
+    allocations.push_back(Allocation());
+    id = (uint32_t)(allocations.size() - 1);
+  }
+  allocations[id] = {page, block, size, true};
+  setOwner(page, block, id);
+
+  if (data != nullptr) {
+    ArenaRange location = range(id);
+    glNamedBufferSubData(location.buffer, location.offset, (GLsizeiptr)size, data);
+  }
+  return id;
+}
+
+void BufferArena::free(uint32_t allocation) {
+  Allocation &a = allocations[allocation];
+  if (!a.live) {
+    return;
+  }
+  pages[a.page]->allocator.free(a.block);
+  a.live = false;
+  unusedIds.push_back(allocation);
+}
+
+ArenaRange BufferArena::range(uint32_t allocation) const {
+  const Allocation &a = allocations[allocation];
+  const Page &page = *pages[a.page];
+  return {page.buffer->id, (GLintptr)(page.allocator.offset(a.block) * granularity), a.size};
+}
+
+bool BufferArena::move(uint32_t id, uint32_t targetPage, bool mustBeLower) {
+  Allocation &a = allocations[id];
+  TlsfAllocator &target = pages[targetPage]->allocator;
+  uint32_t block = target.allocate(units(a.size));
+  if (block == TlsfAllocator::INVALID_BLOCK) {
+    return false;
+  }
+  if (mustBeLower && target.offset(block) >= pages[a.page]->allocator.offset(a.block)) {
+    target.free(block);
+    return false;
+  }
+
+  // The copy is ordered after earlier draws reading the old range and before later draws reading the new one
+  ArenaRange from = range(id);
+  glCopyNamedBufferSubData(from.buffer,
+                           pages[targetPage]->buffer->id,
+                           from.offset,
+                           (GLintptr)(target.offset(block) * granularity),
+                           (GLsizeiptr)a.size);
+  pages[a.page]->allocator.free(a.block);
+  a.page = targetPage;
+  a.block = block;
+  setOwner(targetPage, block, id);
+  bytesMoved += a.size;
+  return true;
+}
+
+size_t BufferArena::defragment(size_t maxBytes) {
+  if (pages.empty()) {
+    return 0;
+  }
+
+  std::vector<double> utilization(pages.size());
+  for (size_t p = 0; p < pages.size(); p++) {
+    utilization[p] = (double)pages[p]->allocator.used() / pages[p]->allocator.capacity();
+  }
+  // Fullest pages are the preferred destinations
+  std::vector<uint32_t> destinations(pages.size());
+  for (uint32_t p = 0; p < pages.size(); p++) {
+    destinations[p] = p;
+  }
+  std::sort(destinations.begin(), destinations.end(), [&](uint32_t a, uint32_t b) {
+    return utilization[a] > utilization[b];
+  });
+
+  // Sparsest page first, and within a page the highest offsets first. Walking each page's blocks from its end keeps
+  // them in order without sorting the allocations, and the candidate cap bounds the work when nothing can move.
+  size_t moved = 0, considered = 0;
+  for (auto source = destinations.rbegin(); source != destinations.rend(); ++source) {
+    const TlsfAllocator &allocator = pages[*source]->allocator;
+    uint32_t block = allocator.lastBlock();
+    while (block != TlsfAllocator::INVALID_BLOCK && moved < maxBytes && considered < MAX_DEFRAGMENT_CANDIDATES) {
+      // Moving frees the block, which may merge it away, so step first
+      uint32_t current = block;
+      block = allocator.previousBlock(block);
+      if (allocator.isFree(current)) {
+        continue;
+      }
+      considered++;
+      uint32_t id = pages[*source]->owners[current];
+      bool done = false;
+      for (uint32_t destination : destinations) {
+        // Only move into fuller pages, so two half-empty pages never trade allocations back and forth
+        if (destination != *source && utilization[destination] > utilization[*source] &&
+            move(id, destination, false)) {
+          done = true;
+          break;
+        }
+      }
+      if (!done) {
+        done = move(id, *source, true);
+      }
+      if (done) {
+        moved += allocations[id].size;
+      }
+    }
+  }
+
+  // Drop trailing empty pages, earlier ones are kept so page indices stay valid
+  while (pages.size() > 1 && pages.back()->allocator.used() == 0) {
+    pages.pop_back();
+  }
+  return moved;
+}
+
+BufferArenaStats BufferArena::stats() const {
+  BufferArenaStats stats;
+  stats.pages = pages.size();
+  size_t totalFree = 0, largestFree = 0;
+  for (const auto &page : pages) {
+    const TlsfAllocator &allocator = page->allocator;
+    stats.capacity += allocator.capacity() * granularity;
+    stats.used += allocator.used() * granularity;
+    stats.freeBlocks += allocator.freeBlockCount();
+    totalFree += (allocator.capacity() - allocator.used()) * granularity;
+    largestFree = std::max(largestFree, allocator.largestFree() * granularity);
+  }
+  stats.allocations = allocations.size() - unusedIds.size();
+  stats.fragmentation = totalFree > 0 ? 1.0 - (double)largestFree / totalFree : 0.0;
+  stats.bytesMoved = bytesMoved;
+  return stats;
+}
+
+void BufferArenaStats::print() const {
+  printf("Buffer arena: %zu allocations in %zu pages, %.1f%% used (%.1f of %.1f KiB), %zu free blocks, "
+         "%.1f%% fragmented, %.1f KiB moved\n",
+         allocations,
+         pages,
+         utilization() * 100.0,
+         used / 1024.0,
+         capacity / 1024.0,
+         freeBlocks,
+         fragmentation * 100.0,
+         bytesMoved / 1024.0);
+}
+
+ArenaBlock::ArenaBlock(BufferArena &arena, size_t size, const void *data)
+    : arena(arena), id(arena.allocate(size, data)) {}
+
+ArenaBlock::~ArenaBlock() {
+  if (valid()) {
+    arena.free(id);
+  }
+}
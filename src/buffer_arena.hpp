@@ -0,0 +1,159 @@
+#ifndef BUFFER_ARENA_H
+#define BUFFER_ARENA_H
+
+#include "buffer.hpp"
+#include <glad/gl.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Two-level segregated fit allocator over an abstract [0, capacity) range. Allocation and free are O(1): two bitmap
+// scans find a free list whose blocks are all big enough, and freed blocks merge with their physical neighbours.
+class TlsfAllocator {
+public:
+  static constexpr uint32_t INVALID_BLOCK = UINT32_MAX;
+
+  explicit TlsfAllocator(size_t capacity);
+
+  // Returns a block handle, or INVALID_BLOCK when no free block is large enough
+  uint32_t allocate(size_t size);
+  // Smallest free block that allocate(size) is guaranteed to find, requests are rounded up to their free list
+  static size_t roundUp(size_t size);
+  void free(uint32_t block);
+
+  size_t offset(uint32_t block) const { return blocks[block].offset; }
+  size_t size(uint32_t block) const { return blocks[block].size; }
+  bool isFree(uint32_t block) const { return blocks[block].free; }
+  // Walk the blocks from the end of the range towards its start
+  uint32_t lastBlock() const { return last; }
+  uint32_t previousBlock(uint32_t block) const { return blocks[block].prevPhysical; }
+  size_t capacity() const { return totalSize; }
+  size_t used() const { return usedSize; }
+  size_t largestFree() const;
+  size_t freeBlockCount() const { return freeBlocks; }
+
+private:
+  static constexpr int SL_BITS = 4;
+  static constexpr int SL_COUNT = 1 << SL_BITS;
+  static constexpr int FL_COUNT = 48;
+
+  struct Block {
+    size_t offset;
+    size_t size;
+    uint32_t prevPhysical;
+    uint32_t nextPhysical;
+    uint32_t prevFree;
+    uint32_t nextFree;
+    bool free;
+  };
+
+  std::vector<Block> blocks;
+  std::vector<uint32_t> unusedNodes;
+  uint32_t freeLists[FL_COUNT][SL_COUNT];
+  uint64_t flBitmap = 0;
+  uint32_t slBitmap[FL_COUNT] = {};
+  uint32_t last = INVALID_BLOCK;
+  size_t totalSize;
+  size_t usedSize = 0;
+  size_t freeBlocks = 0;
+
+  static void mapping(size_t size, int &fl, int &sl);
+  uint32_t newNode();
+  void insertFree(uint32_t block);
+  void removeFree(uint32_t block);
+  uint32_t merge(uint32_t block, uint32_t next);
+};
+
+// Location of an arena allocation. Only valid until the next defragment(), which may move it.
+struct ArenaRange {
+  GLuint buffer = 0;
+  GLintptr offset = 0;
+  size_t size = 0;
+};
+
+struct BufferArenaStats {
+  size_t pages = 0;
+  size_t capacity = 0;
+  size_t used = 0;
+  size_t allocations = 0;
+  size_t freeBlocks = 0;
+  // 1 - largest free block / total free bytes, 0 when all free space is one block
+  double fragmentation = 0.0;
+  size_t bytesMoved = 0;
+
+  double utilization() const { return capacity > 0 ? (double)used / capacity : 0.0; }
+  void print() const;
+};
+
+// Carves vertex and index ranges for many meshes out of a few large immutable buffers. Allocations are addressed by
+// id rather than by location, so defragment() can move them with GPU copies behind the callers' backs.
+class BufferArena {
+public:
+  static constexpr uint32_t INVALID_ALLOCATION = UINT32_MAX;
+
+  // granularity is the alignment of every allocation, it must be a multiple of the largest index size
+  explicit BufferArena(size_t pageSize, size_t granularity = 16);
+
+  BufferArena(const BufferArena &) = delete;
+  BufferArena &operator=(const BufferArena &) = delete;
+
+  // Reserve size bytes and optionally fill them. Anything larger than a page gets a dedicated page of its own size.
+  uint32_t allocate(size_t size, const void *data = nullptr);
+  void free(uint32_t allocation);
+  ArenaRange range(uint32_t allocation) const;
+
+  // Move up to maxBytes of allocations out of sparse pages or down towards the start of their page, then release
+  // pages that became empty. Meant to be called a little every frame, so at most MAX_DEFRAGMENT_CANDIDATES
+  // allocations are considered per call. Returns the bytes moved.
+  size_t defragment(size_t maxBytes);
+
+  BufferArenaStats stats() const;
+
+private:
+  static constexpr size_t MAX_DEFRAGMENT_CANDIDATES = 256;
+
+  struct Page {
+    std::unique_ptr<Buffer> buffer;
+    TlsfAllocator allocator;
+    // Allocation id of each live block, indexed by block handle
+    std::vector<uint32_t> owners;
+  };
+  struct Allocation {
+    uint32_t page;
+    uint32_t block;
+    size_t size;
+    bool live;
+  };
+
+  size_t pageSize;
+  size_t granularity;
+  std::vector<std::unique_ptr<Page>> pages;
+  std::vector<Allocation> allocations;
+  std::vector<uint32_t> unusedIds;
+  size_t bytesMoved = 0;
+
+  size_t units(size_t bytes) const { return (bytes + granularity - 1) / granularity; }
+  uint32_t addPage(size_t size);
+  void setOwner(uint32_t page, uint32_t block, uint32_t id);
+  bool move(uint32_t id, uint32_t targetPage, bool mustBeLower);
+};
+
+// Owning handle to an arena allocation, freed when the last reference goes away
+class ArenaBlock {
+public:
+  ArenaBlock(BufferArena &arena, size_t size, const void *data);
+  ~ArenaBlock();
+
+  ArenaBlock(const ArenaBlock &) = delete;
+  ArenaBlock &operator=(const ArenaBlock &) = delete;
+
+  bool valid() const { return id != BufferArena::INVALID_ALLOCATION; }
+  ArenaRange range() const { return arena.range(id); }
+
+private:
+  BufferArena &arena;
+  uint32_t id;
+};
+
+#endif
@@ -0,0 +1,289 @@
+#include "command_buffer.hpp"
+#include "gl_state.hpp"
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+
+namespace {
+
+// Payloads as stored after each header word. 64 bit fields are copied in and out with memcpy, so word alignment is
+// enough.
+struct Pipeline {
+  const PipelineState *pipeline;
+};
+struct Name {
+  GLuint name;
+};
+struct TextureBinding {
+  GLuint unit;
+  GLuint texture;
+};
+struct BufferBinding {
+  GLenum target;
+  GLuint buffer;
+};
+struct BufferRangeBinding {
+  GLenum target;
+  GLuint index;
+  GLuint buffer;
+  GLuint padding;
+  int64_t offset;
+  int64_t size;
+};
+struct VertexBufferAttachment {
+  GLuint vertexArray;
+  GLuint binding;
+  GLuint buffer;
+  GLsizei stride;
+  int64_t offset;
+};
+struct ElementBufferAttachment {
+  GLuint vertexArray;
+  GLuint buffer;
+};
+struct UniformInt {
+  GLuint program;
+  GLint location;
+  GLint value;
+};
+struct UniformFloats {
+  GLuint program;
+  GLint location;
+  GLfloat values[4];
+};
+struct Capability {
+  GLenum capability;
+  GLuint enabled;
+};
+struct BlendFactors {
+  GLenum source;
+  GLenum destination;
+};
+struct ElementDraw {
+  GLenum mode;
+  GLsizei count;
+  GLenum type;
+  GLsizei instanceCount;
+  GLint baseVertex;
+  GLuint baseInstance;
+  int64_t indexOffset;
+};
+struct ArrayDraw {
+  GLenum mode;
+  GLint first;
+  GLsizei count;
+};
+struct IndirectDraw {
+  GLenum mode;
+  GLenum type;
+  GLsizei drawCount;
+  GLuint padding;
+  int64_t commandOffset;
+};
+
+template <typename Payload> Payload read(const uint32_t *words) {
+  Payload payload;
+  std::memcpy(&payload, words, sizeof(Payload));
+  return payload;
+}
+
+} // namespace
+
+template <typename Payload> void CommandBuffer::push(CommandType type, const Payload &payload) {
+  static_assert(std::is_trivially_copyable_v<Payload> && sizeof(Payload) % sizeof(uint32_t) == 0);
+  constexpr size_t payloadWords = sizeof(Payload) / sizeof(uint32_t);
+  size_t at = words.size();
+  words.resize(at + 1 + payloadWords);
+  words[at] = (uint32_t)type | (uint32_t)payloadWords << 8;
+  std::memcpy(&words[at + 1], &payload, sizeof(Payload));
+  commands++;
+}
+
+void CommandBuffer::bindPipeline(const PipelineState *pipeline) { push(CommandType::BindPipeline, Pipeline{pipeline}); }
+
+void CommandBuffer::useProgram(GLuint program) { push(CommandType::UseProgram, Name{program}); }
+
+void CommandBuffer::bindVertexArray(GLuint vertexArray) { push(CommandType::BindVertexArray, Name{vertexArray}); }
+
+void CommandBuffer::bindTexture(GLuint unit, GLuint texture) {
+  push(CommandType::BindTexture, TextureBinding{unit, texture});
+}
+
+void CommandBuffer::bindBuffer(GLenum target, GLuint buffer) {
+  push(CommandType::BindBuffer, BufferBinding{target, buffer});
+}
+
+void CommandBuffer::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+  push(CommandType::BindBufferRange, BufferRangeBinding{target, index, buffer, 0, offset, size});
+}
+
+void CommandBuffer::vertexBuffer(GLuint vertexArray, GLuint binding, GLuint buffer, GLintptr offset, GLsizei stride) {
+  push(CommandType::VertexBuffer, VertexBufferAttachment{vertexArray, binding, buffer, stride, offset});
+}
+
+void CommandBuffer::elementBuffer(GLuint vertexArray, GLuint buffer) {
+  push(CommandType::ElementBuffer, ElementBufferAttachment{vertexArray, buffer});
+}
+
+void CommandBuffer::uniform1i(GLuint program, GLint location, GLint value) {
+  push(CommandType::Uniform1i, UniformInt{program, location, value});
+}
+
+void CommandBuffer::uniform1f(GLuint program, GLint location, GLfloat value) {
+  push(CommandType::Uniform1f, UniformFloats{program, location, {value, 0.0f, 0.0f, 0.0f}});
+}
+
+void CommandBuffer::uniform4f(GLuint program, GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3) {
+  push(CommandType::Uniform4f, UniformFloats{program, location, {v0, v1, v2, v3}});
+}
+
+void CommandBuffer::setEnabled(GLenum capability, bool enabled) {
+  push(CommandType::SetEnabled, Capability{capability, enabled});
+}
+
+void CommandBuffer::blendFunc(GLenum source, GLenum destination) {
+  push(CommandType::BlendFunc, BlendFactors{source, destination});
+}
+
+void CommandBuffer::drawElements(GLenum mode,
+                                 GLsizei count,
+                                 GLenum type,
+                                 GLintptr indexOffset,
+                                 GLsizei instanceCount,
+                                 GLint baseVertex,
+                                 GLuint baseInstance) {
+  push(CommandType::DrawElements,
+       ElementDraw{mode, count, type, instanceCount, baseVertex, baseInstance, indexOffset});
+}
+
+void CommandBuffer::drawArrays(GLenum mode, GLint first, GLsizei count) {
+  push(CommandType::DrawArrays, ArrayDraw{mode, first, count});
+}
+
+void CommandBuffer::multiDrawElementsIndirect(GLenum mode, GLenum type, GLintptr commandOffset, GLsizei drawCount) {
+  push(CommandType::MultiDrawElementsIndirect, IndirectDraw{mode, type, drawCount, 0, commandOffset});
+}
+
+void CommandBuffer::clear() {
+  words.clear();
+  commands = 0;
+}
+
+void CommandBuffer::execute() const {
+  GlStateCache &state = glState();
+  const uint32_t *word = words.data(), *end = words.data() + words.size();
+  while (word < end) {
+    CommandType type = (CommandType)(*word & 0xFF);
+    const uint32_t *payload = word + 1;
+    word = payload + (*word >> 8);
+    switch (type) {
+    case CommandType::BindPipeline:
+      state.bindPipeline(read<Pipeline>(payload).pipeline);
+      break;
+    case CommandType::UseProgram:
+      state.useProgram(read<Name>(payload).name);
+      break;
+    case CommandType::BindVertexArray:
+      state.bindVertexArray(read<Name>(payload).name);
+      break;
+    case CommandType::BindTexture: {
+      TextureBinding binding = read<TextureBinding>(payload);
+      state.bindTextureUnit(binding.unit, binding.texture);
+      break;
+    }
+    case CommandType::BindBuffer: {
+      BufferBinding binding = read<BufferBinding>(payload);
+      state.bindBuffer(binding.target, binding.buffer);
+      break;
+    }
+    case CommandType::BindBufferRange: {
+      BufferRangeBinding binding = read<BufferRangeBinding>(payload);
+      state.bindBufferRange(binding.target, binding.index, binding.buffer, binding.offset, binding.size);
+      break;
+    }
+    case CommandType::VertexBuffer: {
+      VertexBufferAttachment attachment = read<VertexBufferAttachment>(payload);
+      state.vertexArrayVertexBuffer(
+          attachment.vertexArray, attachment.binding, attachment.buffer, attachment.offset, attachment.stride);
+      break;
+    }
+    case CommandType::ElementBuffer: {
+      ElementBufferAttachment attachment = read<ElementBufferAttachment>(payload);
+      state.vertexArrayElementBuffer(attachment.vertexArray, attachment.buffer);
+      break;
+    }
+    case CommandType::Uniform1i: {
+      UniformInt uniform = read<UniformInt>(payload);
+      glProgramUniform1i(uniform.program, uniform.location, uniform.value);
+      break;
+    }
+    case CommandType::Uniform1f: {
+      UniformFloats uniform = read<UniformFloats>(payload);
+      glProgramUniform1f(uniform.program, uniform.location, uniform.values[0]);
+      break;
+    }
+    case CommandType::Uniform4f: {
+      UniformFloats uniform = read<UniformFloats>(payload);
+      glProgramUniform4fv(uniform.program, uniform.location, 1, uniform.values);
+      break;
+    }
+    case CommandType::SetEnabled: {
+      Capability capability = read<Capability>(payload);
+      state.setEnabled(capability.capability, capability.enabled != 0);
+      break;
+    }
+    case CommandType::BlendFunc: {
+      BlendFactors factors = read<BlendFactors>(payload);
+      state.blendFunc(factors.source, factors.destination);
+      break;
+    }
+    case CommandType::DrawElements: {
+      ElementDraw draw = read<ElementDraw>(payload);
+      glDrawElementsInstancedBaseVertexBaseInstance(draw.mode,
+                                                    draw.count,
+                                                    draw.type,
+                                                    (const void *)draw.indexOffset,
+                                                    draw.instanceCount,
+                                                    draw.baseVertex,
+                                                    draw.baseInstance);
+      break;
+    }
+    case CommandType::DrawArrays: {
+      ArrayDraw draw = read<ArrayDraw>(payload);
+      glDrawArrays(draw.mode, draw.first, draw.count);
+      break;
+    }
+    case CommandType::MultiDrawElementsIndirect: {
+      IndirectDraw draw = read<IndirectDraw>(payload);
+      glMultiDrawElementsIndirect(draw.mode, draw.type, (const void *)draw.commandOffset, draw.drawCount, 0);
+      break;
+    }
+    }
+  }
+}
+
+void recordParallel(ThreadPool &pool,
+                    std::vector<CommandBuffer> &buffers,
+                    const std::function<void(size_t job, CommandBuffer &commands)> &record) {
+  for (size_t job = 0; job < buffers.size(); job++) {
+    pool.enqueue([&, job]() {
+      buffers[job].clear();
+      record(job, buffers[job]);
+    });
+  }
+  pool.waitIdle();
+}
+
+void executeInOrder(const std::vector<CommandBuffer> &buffers) {
+  for (const CommandBuffer &buffer : buffers) {
+    buffer.execute();
+  }
+}
+
+void CommandStats::print() const {
+  printf("Commands: %zu in %.1f KiB, recorded at %.1f M/s, replayed at %.1f M/s\n",
+         commands,
+         bytes / 1024.0,
+         recordRate() / 1e6,
+         replayRate() / 1e6);
+}
@@ -0,0 +1,99 @@
+#ifndef COMMAND_BUFFER_H
+#define COMMAND_BUFFER_H
+
+#include "pipeline_state.hpp"
+#include "thread_pool.hpp"
+#include <glad/gl.h>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+enum class CommandType : uint8_t {
+  BindPipeline,
+  UseProgram,
+  BindVertexArray,
+  BindTexture,
+  BindBuffer,
+  BindBufferRange,
+  VertexBuffer,
+  ElementBuffer,
+  Uniform1i,
+  Uniform1f,
+  Uniform4f,
+  SetEnabled,
+  BlendFunc,
+  DrawElements,
+  DrawArrays,
+  MultiDrawElementsIndirect,
+};
+
+// GL commands encoded as plain 32 bit words: a header word holding the type and payload length, then the payload
+// copied in as is. Recording touches no GL and no shared state, so any thread can fill its own buffer. execute()
+// replays on the GL thread, with binds going through the state cache. Uniforms are written with glProgramUniform*,
+// so they do not depend on the bound program, and take locations looked up beforehand on the GL thread.
+class CommandBuffer {
+public:
+  // The pipeline must outlive the buffer
+  void bindPipeline(const PipelineState *pipeline);
+  void useProgram(GLuint program);
+  void bindVertexArray(GLuint vertexArray);
+  void bindTexture(GLuint unit, GLuint texture);
+  void bindBuffer(GLenum target, GLuint buffer);
+  // size 0 binds the whole buffer
+  void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+  // Vertex array buffer attachments, as Mesh makes before each draw
+  void vertexBuffer(GLuint vertexArray, GLuint binding, GLuint buffer, GLintptr offset, GLsizei stride);
+  void elementBuffer(GLuint vertexArray, GLuint buffer);
+  void uniform1i(GLuint program, GLint location, GLint value);
+  void uniform1f(GLuint program, GLint location, GLfloat value);
+  void uniform4f(GLuint program, GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3);
+  void setEnabled(GLenum capability, bool enabled);
+  void blendFunc(GLenum source, GLenum destination);
+  void drawElements(GLenum mode,
+                    GLsizei count,
+                    GLenum type,
+                    GLintptr indexOffset,
+                    GLsizei instanceCount = 1,
+                    GLint baseVertex = 0,
+                    GLuint baseInstance = 0);
+  void drawArrays(GLenum mode, GLint first, GLsizei count);
+  // Commands come from the bound GL_DRAW_INDIRECT_BUFFER at commandOffset
+  void multiDrawElementsIndirect(GLenum mode, GLenum type, GLintptr commandOffset, GLsizei drawCount);
+
+  void execute() const;
+  // Keeps the capacity, so a buffer reused every frame stops allocating
+  void clear();
+
+  size_t commandCount() const { return commands; }
+  size_t bytes() const { return words.size() * sizeof(uint32_t); }
+
+private:
+  std::vector<uint32_t> words;
+  size_t commands = 0;
+
+  template <typename Payload> void push(CommandType type, const Payload &payload);
+};
+
+// Record buffers.size() command buffers on the pool, job i filling buffers[i] after clearing it, and wait for all of
+// them. Replaying the buffers in index order gives the same command stream whichever worker ran which job.
+void recordParallel(ThreadPool &pool,
+                    std::vector<CommandBuffer> &buffers,
+                    const std::function<void(size_t job, CommandBuffer &commands)> &record);
+void executeInOrder(const std::vector<CommandBuffer> &buffers);
+
+// Recording and replay run on different threads and may lag each other by a frame, so each side counts its own
+// commands
+struct CommandStats {
+  size_t commands = 0;
+  size_t bytes = 0;
+  double recordSeconds = 0.0;
+  size_t replayed = 0;
+  double replaySeconds = 0.0;
+
+  double recordRate() const { return recordSeconds > 0.0 ? commands / recordSeconds : 0.0; }
+  double replayRate() const { return replaySeconds > 0.0 ? replayed / replaySeconds : 0.0; }
+  void print() const;
+};
+
+#endif
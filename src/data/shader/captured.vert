@@ -0,0 +1,8 @@
+#version 460 core
+
+// Positions already deformed by a capture pass, see DeformCache
+layout(location = 0) in vec4 aPos;
+
+void main() {
+    gl_Position = aPos;
+}
@@ -0,0 +1,12 @@
+#version 460 core
+
+out vec4 fragColour;
+
+in vec3 outColour;
+in vec3 outTexCoord;
+
+uniform sampler2DArray textureImgs;
+
+void main(){
+  fragColour = texture(textureImgs, outTexCoord) * vec4(outColour, 1.0f);
+}
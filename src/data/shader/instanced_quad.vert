@@ -0,0 +1,16 @@
+#version 460 core
+
+// Vertex and instance inputs are generated from PackedTexturedFormat and QuadInstanceFormat
+
+out vec3 outColour;
+out vec3 outTexCoord;
+
+void main() {
+  float s = sin(aTransform.w);
+  float c = cos(aTransform.w);
+  vec2 local = aPos.xy * aTransform.z;
+  vec2 rotated = vec2(local.x * c - local.y * s, local.x * s + local.y * c);
+  gl_Position = vec4(rotated + aTransform.xy, aPos.z, 1.0f);
+  outColour = aColour * aTint.rgb;
+  outTexCoord = vec3(mix(aUvRect.xy, aUvRect.zw, aTexCoord), aLayer);
+}
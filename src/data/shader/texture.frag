@@ -6,7 +6,9 @@ in vec3 outColour;
 in vec2 outTexCoord;
 
 uniform sampler2D textureImg;
+// Repeats the texture across the quad, sprites set it to 1 to sample their exact UV rect
+uniform float texCoordScale = 2.5f;
 
 void main(){
-  fragColour = texture(textureImg, outTexCoord * 2.5f) * vec4(outColour, 1.0f);  
+  fragColour = texture(textureImg, outTexCoord * texCoordScale) * vec4(outColour, 1.0f);  
 }
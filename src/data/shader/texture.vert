@@ -7,8 +7,11 @@ layout(location = 2) in vec2 aTexCoord;
 out vec3 outColour;
 out vec2 outTexCoord;
 
+// Fits model space into the view: xyz is subtracted from the position, which is then scaled by w
+uniform vec4 modelFit = vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
 void main() {
-  gl_Position = vec4(aPos, 1.0f);
+  gl_Position = vec4((aPos - modelFit.xyz) * modelFit.w, 1.0f);
   outColour = aColour;
   outTexCoord = aTexCoord;
 }
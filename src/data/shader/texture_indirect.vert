@@ -0,0 +1,30 @@
+#version 460 core
+
+// Vertex inputs are generated from PackedTexturedFormat and inserted after the version line
+
+struct DrawData {
+  vec4 transform;
+  vec4 tint;
+  vec4 uvRect;
+  uint layer;
+};
+
+layout(std430, binding = 0) readonly buffer DrawDataBuffer {
+  DrawData draws[];
+};
+
+out vec3 outColour;
+out vec3 outTexCoord;
+
+void main() {
+  // Instances of a merged command sit next to each other in the buffer
+  DrawData draw = draws[gl_BaseInstance + gl_InstanceID];
+
+  float s = sin(draw.transform.w);
+  float c = cos(draw.transform.w);
+  vec2 local = aPos.xy * draw.transform.z;
+  vec2 rotated = vec2(local.x * c - local.y * s, local.x * s + local.y * c);
+  gl_Position = vec4(rotated + draw.transform.xy, aPos.z, 1.0f);
+  outColour = aColour * draw.tint.rgb;
+  outTexCoord = vec3(mix(draw.uvRect.xy, draw.uvRect.zw, aTexCoord), float(draw.layer));
+}
@@ -0,0 +1,12 @@
+#version 460 core
+
+// Inputs are generated from PackedTexturedFormat and inserted after the version line
+
+out vec3 outColour;
+out vec2 outTexCoord;
+
+void main() {
+  gl_Position = vec4(aPos, 1.0f);
+  outColour = aColour;
+  outTexCoord = aTexCoord;
+}
@@ -0,0 +1,44 @@
+#version 460 core
+
+// No vertex inputs, vertices are fetched from storage buffers by gl_VertexID in the layout their mesh records
+
+struct PulledMesh {
+  uint firstWord;
+  uint format;
+  uint strideWords;
+  uint padding;
+};
+
+layout(std430, binding = 1) readonly buffer VertexWords {
+  uint words[];
+};
+
+layout(std430, binding = 2) readonly buffer PulledMeshBuffer {
+  PulledMesh meshes[];
+};
+
+// Values of PulledFormat
+const uint FORMAT_TEXTURED = 0u;
+const uint FORMAT_PACKED_TEXTURED = 1u;
+
+out vec3 outColour;
+out vec2 outTexCoord;
+
+void main() {
+  PulledMesh mesh = meshes[gl_BaseInstance];
+  uint base = mesh.firstWord + uint(gl_VertexID) * mesh.strideWords;
+
+  vec3 position;
+  if (mesh.format == FORMAT_PACKED_TEXTURED) {
+    // Snorm16 xy | Snorm16 z, padding | Unorm8 rgb, padding | Half uv
+    position = vec3(unpackSnorm2x16(words[base]), unpackSnorm2x16(words[base + 1u]).x);
+    outColour = unpackUnorm4x8(words[base + 2u]).rgb;
+    outTexCoord = unpackHalf2x16(words[base + 3u]);
+  } else {
+    // Three floats each of position and colour, two of texture coordinates
+    position = uintBitsToFloat(uvec3(words[base], words[base + 1u], words[base + 2u]));
+    outColour = uintBitsToFloat(uvec3(words[base + 3u], words[base + 4u], words[base + 5u]));
+    outTexCoord = uintBitsToFloat(uvec2(words[base + 6u], words[base + 7u]));
+  }
+  gl_Position = vec4(position, 1.0f);
+}
@@ -0,0 +1,79 @@
+#include "deform_cache.hpp"
+#include "gl_state.hpp"
+#include <cstdio>
+#include <iostream>
+
+DeformCache::DeformCache(size_t vertexCapacity) : vertexCapacity(vertexCapacity) {
+  positions = std::make_unique<Buffer>(vertexCapacity * CAPTURED_STRIDE, nullptr);
+
+  glCreateTransformFeedbacks(1, &feedback);
+  glTransformFeedbackBufferBase(feedback, 0, positions->id);
+
+  glCreateVertexArrays(1, &vao);
+  glEnableVertexArrayAttrib(vao, 0);
+  glVertexArrayAttribFormat(vao, 0, 4, GL_FLOAT, GL_FALSE, 0);
+  glVertexArrayAttribBinding(vao, 0, 0);
+}
+
+DeformCache::~DeformCache() {
+  glState().forgetVertexArray(vao);
+  glDeleteVertexArrays(1, &vao);
+  glState().forgetTransformFeedback(feedback);
+  glDeleteTransformFeedbacks(1, &feedback);
+}
+
+void DeformCache::capture(Shader &program, const std::vector<const Mesh *> &meshes) {
+  captured.clear();
+  offsets.clear();
+  size_t total = 0;
+  for (const Mesh *mesh : meshes) {
+    if (total + mesh->vertexCount > vertexCapacity) {
+      std::cout << "ERROR::DEFORM_CACHE::OUT_OF_SPACE" << std::endl;
+      break;
+    }
+    captured.push_back(mesh);
+    offsets.push_back((GLintptr)(total * CAPTURED_STRIDE));
+    total += mesh->vertexCount;
+  }
+  if (captured.empty()) {
+    return;
+  }
+
+  // Points in, points out, so every vertex is written exactly once and in order, one mesh after the other
+  program.use();
+  glState().setEnabled(GL_RASTERIZER_DISCARD, true);
+  glState().bindTransformFeedback(feedback);
+  glBeginTransformFeedback(GL_POINTS);
+  for (const Mesh *mesh : captured) {
+    mesh->drawVertices();
+  }
+  glEndTransformFeedback();
+  glState().bindTransformFeedback(0);
+  glState().setEnabled(GL_RASTERIZER_DISCARD, false);
+
+  counts.captures++;
+  counts.capturedVertices += total;
+}
+
+void DeformCache::draw(size_t i) {
+  if (i >= captured.size()) {
+    return;
+  }
+  captured[i]->drawWith(vao, positions->id, offsets[i], CAPTURED_STRIDE);
+  counts.cachedDraws++;
+  counts.cachedVertices += captured[i]->vertexCount;
+}
+
+DeformCacheStats DeformCache::takeStats() {
+  DeformCacheStats stats = counts;
+  counts = {};
+  return stats;
+}
+
+void DeformCacheStats::print() const {
+  printf("Deform cache: %zu captures of %zu vertices, %zu draws reused %zu deformed vertices\n",
+         captures,
+         capturedVertices,
+         cachedDraws,
+         cachedVertices);
+}
@@ -0,0 +1,55 @@
+#ifndef DEFORM_CACHE_H
+#define DEFORM_CACHE_H
+
+#include "buffer.hpp"
+#include "mesh.hpp"
+#include "shader.hpp"
+#include <glad/gl.h>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+struct DeformCacheStats {
+  size_t captures = 0;
+  size_t capturedVertices = 0;
+  // Draws served from the captured vertices, each would otherwise have run the deforming stage again
+  size_t cachedDraws = 0;
+  size_t cachedVertices = 0;
+
+  void print() const;
+};
+
+// Runs a deforming vertex stage once per frame and keeps its output for every later pass. capture() draws each mesh's
+// vertices as points with rasterization off and records gl_Position through transform feedback, one vec4 per vertex.
+// draw() then feeds those positions to location 0 of the bound program, with the mesh's own indices, so shadow, depth
+// and main passes cost one deformation per mesh instead of one per mesh per pass.
+class DeformCache {
+public:
+  // Captured vertices are vec4 positions
+  static constexpr GLsizei CAPTURED_STRIDE = 4 * sizeof(GLfloat);
+
+  explicit DeformCache(size_t vertexCapacity);
+  ~DeformCache();
+
+  DeformCache(const DeformCache &) = delete;
+  DeformCache &operator=(const DeformCache &) = delete;
+
+  // Run program, a capture Shader recording gl_Position, over the meshes' vertices. Replaces the last capture.
+  void capture(Shader &program, const std::vector<const Mesh *> &meshes);
+  // Draw mesh i of the last capture with the bound program
+  void draw(size_t i);
+
+  // Counts since the last call
+  DeformCacheStats takeStats();
+
+private:
+  GLuint vao = 0;
+  GLuint feedback = 0;
+  std::unique_ptr<Buffer> positions;
+  size_t vertexCapacity;
+  std::vector<const Mesh *> captured;
+  std::vector<GLintptr> offsets;
+  DeformCacheStats counts;
+};
+
+#endif
@@ -0,0 +1,136 @@
+#include "draw_queue.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+// Sort key bit layout, most significant first. Opaque draws sort by material and then front to back, translucent
+// ones back to front and only then by material, since blending needs them in depth order.
+//   opaque:      pass:4 | 0:1 | pipeline:8 | texture:12 | vertex array:8 | depth:31
+//   translucent: pass:4 | 1:1 | inverted depth:31 | pipeline:8 | texture:12 | vertex array:8
+static constexpr int PASS_SHIFT = 60;
+static constexpr int TRANSLUCENT_SHIFT = 59;
+static constexpr int OPAQUE_MATERIAL_SHIFT = 31;
+static constexpr int TRANSLUCENT_DEPTH_SHIFT = 28;
+static constexpr int PIPELINE_SHIFT = 20;
+static constexpr int TEXTURE_SHIFT = 8;
+static constexpr uint32_t PASS_MASK = 0xf;
+static constexpr uint32_t PIPELINE_MASK = 0xff;
+static constexpr uint32_t TEXTURE_MASK = 0xfff;
+static constexpr uint32_t VERTEX_ARRAY_MASK = 0xff;
+static constexpr uint32_t DEPTH_MAX = 0x7fffffff;
+
+void radixSort(std::vector<std::pair<uint64_t, uint32_t>> &keys,
+               std::vector<std::pair<uint64_t, uint32_t>> &scratch) {
+  constexpr int DIGITS = 8;
+  if (keys.size() < 2) {
+    return;
+  }
+
+  // Histograms of all digits in one read of the keys
+  size_t counts[DIGITS][256] = {};
+  for (const auto &key : keys) {
+    for (int digit = 0; digit < DIGITS; digit++) {
+      counts[digit][(key.first >> (digit * 8)) & 0xff]++;
+    }
+  }
+
+  scratch.resize(keys.size());
+  for (int digit = 0; digit < DIGITS; digit++) {
+    int shift = digit * 8;
+    size_t *count = counts[digit];
+    if (count[(keys[0].first >> shift) & 0xff] == keys.size()) {
+      continue;
+    }
+    size_t offset = 0;
+    for (int bucket = 0; bucket < 256; bucket++) {
+      size_t bucketCount = count[bucket];
+      count[bucket] = offset;
+      offset += bucketCount;
+    }
+    for (const auto &key : keys) {
+      scratch[count[(key.first >> shift) & 0xff]++] = key;
+    }
+    keys.swap(scratch);
+  }
+}
+
+void DrawQueueStats::print() const {
+  printf("Draw queue: %zu draws, %zu pipeline, %zu texture, %zu vertex array and %zu buffer changes, sort %.3f ms\n",
+         draws,
+         pipelineChanges,
+         textureChanges,
+         vertexArrayChanges,
+         bufferChanges,
+         sortSeconds * 1000.0);
+}
+
+uint64_t DrawQueue::sortKey(const DrawItem &item) {
+  // Ids are handed out in order of first use, so they stay stable for the lifetime of the queue
+  uint32_t texture = textureIds.try_emplace(item.texture, (uint32_t)textureIds.size()).first->second;
+  uint32_t vertexArray = vertexArrayIds.try_emplace(item.mesh->vao, (uint32_t)vertexArrayIds.size()).first->second;
+  uint64_t material = ((uint64_t)(item.pipeline->id() & PIPELINE_MASK) << PIPELINE_SHIFT) |
+                      ((uint64_t)(texture & TEXTURE_MASK) << TEXTURE_SHIFT) | (vertexArray & VERTEX_ARRAY_MASK);
+  uint64_t depth = (uint64_t)(std::clamp(item.depth, 0.0f, 1.0f) * DEPTH_MAX);
+
+  uint64_t key = (uint64_t)(item.pass & PASS_MASK) << PASS_SHIFT;
+  if (item.pipeline->desc().blend.enabled) {
+    return key | (uint64_t)1 << TRANSLUCENT_SHIFT | (DEPTH_MAX - depth) << TRANSLUCENT_DEPTH_SHIFT | material;
+  }
+  return key | material << OPAQUE_MATERIAL_SHIFT | depth;
+}
+
+void DrawQueue::submit(const DrawItem &item) {
+  keys.emplace_back(sortKey(item), (uint32_t)items.size());
+  items.push_back(item);
+}
+
+void DrawQueue::flush(CommandBuffer &commands, bool sorted) {
+  lastStats = DrawQueueStats();
+  lastStats.draws = items.size();
+  if (sorted) {
+    auto start = std::chrono::steady_clock::now();
+    radixSort(keys, scratch);
+    lastStats.sortSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  const PipelineState *pipeline = nullptr;
+  const Texture *texture = nullptr;
+  GLuint vertexArray = 0;
+  MeshAttachment attached;
+  bool attachedKnown = false;
+  for (const auto &key : keys) {
+    const DrawItem &item = items[key.second];
+    if (item.pipeline != pipeline) {
+      pipeline = item.pipeline;
+      commands.bindPipeline(pipeline);
+      lastStats.pipelineChanges++;
+    }
+    if (item.texture != texture && item.texture) {
+      texture = item.texture;
+      commands.bindTexture(0, texture->id);
+      lastStats.textureChanges++;
+    }
+    // Mesh::record binds the vertex array and attaches its buffers every draw, the state cache drops the repeats on
+    // replay. Count what it will let through, as an upper bound: attachments belong to the vertex array, and are
+    // taken as unknown at the start of the flush and after switching vertex arrays.
+    MeshAttachment next = item.mesh->attachment();
+    bool vertexArrayChanged = item.mesh->vao != vertexArray;
+    if (vertexArrayChanged) {
+      vertexArray = item.mesh->vao;
+      lastStats.vertexArrayChanges++;
+    }
+    if (!attachedKnown || vertexArrayChanged || next.vertexBuffer != attached.vertexBuffer ||
+        next.vertexOffset != attached.vertexOffset) {
+      lastStats.bufferChanges++;
+    }
+    if (!attachedKnown || vertexArrayChanged || next.indexBuffer != attached.indexBuffer) {
+      lastStats.bufferChanges++;
+    }
+    attached = next;
+    attachedKnown = true;
+    item.mesh->record(commands);
+  }
+
+  items.clear();
+  keys.clear();
+}
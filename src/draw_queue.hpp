@@ -0,0 +1,70 @@
+#ifndef DRAW_QUEUE_H
+#define DRAW_QUEUE_H
+
+#include "command_buffer.hpp"
+#include "mesh.hpp"
+#include "pipeline_state.hpp"
+#include "texture.hpp"
+#include <glad/gl.h>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Sort (key, index) pairs by key with an LSD radix sort, 8 bits per pass. Stable, so draws with equal keys keep their
+// submission order. Passes over a digit every key shares are skipped, which for draw keys is most of the material
+// bits. scratch is resized to match and can be kept between calls.
+void radixSort(std::vector<std::pair<uint64_t, uint32_t>> &keys,
+               std::vector<std::pair<uint64_t, uint32_t>> &scratch);
+
+struct DrawItem {
+  const Mesh *mesh = nullptr;
+  // Pipelines that blend draw translucent, after the opaque draws of the same pass
+  const PipelineState *pipeline = nullptr;
+  // Bound to unit 0, nullptr leaves the unit as it is
+  const Texture *texture = nullptr;
+  // Lower passes draw first
+  uint8_t pass = 0;
+  // Distance from the viewer in [0, 1], opaque draws go front to back within a material and translucent ones back to
+  // front across materials
+  float depth = 0.0f;
+};
+
+struct DrawQueueStats {
+  size_t draws = 0;
+  // State set between draws, including the first draw
+  size_t pipelineChanges = 0;
+  size_t textureChanges = 0;
+  size_t vertexArrayChanges = 0;
+  // Vertex and element buffer attachments that reach GL, meshes in one arena page share them
+  size_t bufferChanges = 0;
+  double sortSeconds = 0.0;
+
+  void print() const;
+};
+
+// Collects a frame's draws, each with a 64 bit key of (pass, translucency, material, depth), radix sorts the keys and
+// records the draws in key order, leaving out the pipeline and texture binds that repeat the previous draw.
+// State changes then scale with the number of materials rather than the number of draws. Nothing here calls GL, so
+// the queue can be filled and flushed on any thread and the command buffer replayed on the GL thread.
+class DrawQueue {
+public:
+  void submit(const DrawItem &item);
+  // Record everything submitted since the last flush, in key order or, with sorted false, in submission order
+  void flush(CommandBuffer &commands, bool sorted = true);
+
+  const DrawQueueStats &stats() const { return lastStats; }
+
+private:
+  std::vector<DrawItem> items;
+  std::vector<std::pair<uint64_t, uint32_t>> keys, scratch;
+  // Small ids for textures and vertex arrays so they fit in the sort key, pipelines come with their own
+  std::unordered_map<const void *, uint32_t> textureIds;
+  std::unordered_map<GLuint, uint32_t> vertexArrayIds;
+  DrawQueueStats lastStats;
+
+  uint64_t sortKey(const DrawItem &item);
+};
+
+#endif
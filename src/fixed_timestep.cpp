@@ -0,0 +1,41 @@
+#include "fixed_timestep.hpp"
+#include <cstdio>
+
+void FixedTimestepStats::print() const {
+  printf("Simulation: %zu steps over %zu frames (%.2f per frame), dropped %.2f ms\n",
+         steps,
+         frames,
+         frames > 0 ? (double)steps / frames : 0.0,
+         droppedSeconds * 1000.0);
+}
+
+FixedTimestep::FixedTimestep(double stepSeconds, size_t maxStepsPerFrame)
+    : stepSeconds(stepSeconds), maxStepsPerFrame(maxStepsPerFrame) {}
+
+size_t FixedTimestep::advance(double now) {
+  counts.frames++;
+  if (!started) {
+    started = true;
+    last = now;
+    return 0;
+  }
+  accumulator += now - last;
+  last = now;
+
+  size_t steps = (size_t)(accumulator / stepSeconds);
+  if (steps > maxStepsPerFrame) {
+    double dropped = (steps - maxStepsPerFrame) * stepSeconds;
+    accumulator -= dropped;
+    counts.droppedSeconds += dropped;
+    steps = maxStepsPerFrame;
+  }
+  accumulator -= steps * stepSeconds;
+  counts.steps += steps;
+  return steps;
+}
+
+FixedTimestepStats FixedTimestep::takeStats() {
+  FixedTimestepStats stats = counts;
+  counts = {};
+  return stats;
+}
@@ -0,0 +1,44 @@
+#ifndef FIXED_TIMESTEP_H
+#define FIXED_TIMESTEP_H
+
+#include <cstddef>
+#include <cstdint>
+
+struct FixedTimestepStats {
+  size_t frames = 0;
+  size_t steps = 0;
+  // Real time skipped because frames fell more than maxStepsPerFrame steps behind
+  double droppedSeconds = 0.0;
+
+  void print() const;
+};
+
+// Turns real frame times into a whole number of fixed simulation steps. Leftover time carries over to the next
+// frame, and alpha() says how far into the next step rendering is, so the renderer draws the last two simulated
+// states blended and runs at any rate while the simulation always advances by the same step. A frame that falls
+// more than maxStepsPerFrame steps behind drops the excess, otherwise every slow frame would have to simulate more
+// and fall further behind.
+class FixedTimestep {
+public:
+  explicit FixedTimestep(double stepSeconds, size_t maxStepsPerFrame = 8);
+
+  // Add the real time passed since the last call and return how many steps to simulate this frame. The first call
+  // only starts the clock.
+  size_t advance(double now);
+  // Leftover time in steps, in [0, 1), to blend the previous state towards the current one with
+  float alpha() const { return (float)(accumulator / stepSeconds); }
+  double step() const { return stepSeconds; }
+
+  // Counts since the last call
+  FixedTimestepStats takeStats();
+
+private:
+  double stepSeconds;
+  size_t maxStepsPerFrame;
+  double accumulator = 0.0;
+  double last = 0.0;
+  bool started = false;
+  FixedTimestepStats counts;
+};
+
+#endif
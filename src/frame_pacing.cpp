@@ -0,0 +1,146 @@
+#include "frame_pacing.hpp"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <thread>
+
+const char *vsyncModeName(VsyncMode mode) {
+  switch (mode) {
+  case VsyncMode::Off:
+    return "off";
+  case VsyncMode::On:
+    return "on";
+  case VsyncMode::Adaptive:
+    return "adaptive";
+  }
+  return "unknown";
+}
+
+VsyncMode setVsync(VsyncMode mode) {
+  if (mode == VsyncMode::Adaptive && !glfwExtensionSupported("WGL_EXT_swap_control_tear") &&
+      !glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+    std::cout << "ERROR::FRAME_PACING::ADAPTIVE_VSYNC_UNSUPPORTED" << std::endl;
+    mode = VsyncMode::On;
+  }
+  // A negative interval is how swap tear control asks for adaptive vsync
+  glfwSwapInterval(mode == VsyncMode::Off ? 0 : mode == VsyncMode::On ? 1 : -1);
+  return mode;
+}
+
+FrameLimiter::FrameLimiter(double maxFps) : period(maxFps > 0.0 ? 1.0 / maxFps : 0.0) {}
+
+void FrameLimiter::wait() {
+  if (period <= 0.0) {
+    return;
+  }
+  double now = glfwGetTime();
+  if (now < deadline) {
+    double remaining = deadline - now;
+    if (remaining > SPIN_SECONDS) {
+      std::this_thread::sleep_for(std::chrono::duration<double>(remaining - SPIN_SECONDS));
+      double woke = glfwGetTime();
+      sleptSeconds += woke - now;
+      now = woke;
+    }
+    double spinStart = now;
+    while (now < deadline) {
+      now = glfwGetTime();
+    }
+    spunSeconds += now - spinStart;
+  }
+  // A frame that ran more than a period late restarts the schedule, rather than letting the next frames rush to
+  // catch up
+  deadline = now - deadline > period ? now + period : deadline + period;
+}
+
+void FramePacingStats::print() const {
+  printf("Frame pacing: limiter slept %.2f ms and spun %.2f ms, fence waits %.2f ms, input held back %.2f ms\n",
+         limiterSleepSeconds * 1000.0,
+         limiterSpinSeconds * 1000.0,
+         fenceWaitSeconds * 1000.0,
+         inputWaitSeconds * 1000.0);
+}
+
+FramePacer::FramePacer(const FramePacing &pacing) : pacing(pacing), limiter(pacing.maxFps) {
+  this->pacing.vsync = setVsync(pacing.vsync);
+}
+
+FramePacer::~FramePacer() {
+  for (GLsync fence : fences) {
+    glDeleteSync(fence);
+  }
+}
+
+void FramePacer::beginFrame() {
+  limiter.wait();
+  framesBegun++;
+  if (!pacing.lowLatency || framesBegun <= 2) {
+    return;
+  }
+  // The GL thread caps frames in flight at 1 in this mode, so once it has ended the previous frame this one's
+  // target is done
+  size_t target = framesBegun - 2;
+  if (framesCompleted.load(std::memory_order_acquire) < target) {
+    auto start = std::chrono::steady_clock::now();
+    while (framesCompleted.load(std::memory_order_acquire) < target) {
+      if (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < INPUT_SPIN_SECONDS) {
+        std::this_thread::yield();
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(completedMutex);
+      completed.wait(lock, [this, target]() { return framesCompleted.load(std::memory_order_acquire) >= target; });
+    }
+    inputWaitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+}
+
+void FramePacer::endFrame() {
+  fences.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+  size_t cap = pacing.lowLatency ? 1 : pacing.maxFramesInFlight;
+  while (!fences.empty() && retireOldest(false)) {
+  }
+  while (cap > 0 && fences.size() > cap) {
+    retireOldest(true);
+  }
+}
+
+bool FramePacer::retireOldest(bool wait) {
+  GLsync fence = fences.front();
+  // Poll first, a signalled fence is the common case and should not count as a wait
+  GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+  if (result == GL_TIMEOUT_EXPIRED) {
+    if (!wait) {
+      return false;
+    }
+    auto waitStart = std::chrono::steady_clock::now();
+    do {
+      result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    } while (result == GL_TIMEOUT_EXPIRED);
+    fenceWaitNanoseconds.fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - waitStart).count(),
+        std::memory_order_relaxed);
+  }
+  if (result == GL_WAIT_FAILED) {
+    std::cout << "ERROR::FRAME_PACING::FENCE_WAIT_FAILED" << std::endl;
+  }
+  glDeleteSync(fence);
+  fences.pop_front();
+  framesCompleted.fetch_add(1, std::memory_order_release);
+  // Taking the lock orders the count before the check of a main thread that is about to sleep
+  {
+    std::lock_guard<std::mutex> lock(completedMutex);
+  }
+  completed.notify_one();
+  return true;
+}
+
+FramePacingStats FramePacer::takeStats() {
+  FramePacingStats stats;
+  stats.limiterSleepSeconds = limiter.sleptSeconds;
+  stats.limiterSpinSeconds = limiter.spunSeconds;
+  stats.fenceWaitSeconds = fenceWaitNanoseconds.exchange(0, std::memory_order_relaxed) * 1e-9;
+  stats.inputWaitSeconds = inputWaitSeconds;
+  limiter.sleptSeconds = limiter.spunSeconds = 0.0;
+  inputWaitSeconds = 0.0;
+  return stats;
+}
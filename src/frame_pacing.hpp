@@ -0,0 +1,106 @@
+#ifndef FRAME_PACING_H
+#define FRAME_PACING_H
+
+#include <glad/gl.h>
+#include <GLFW/glfw3.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+
+enum class VsyncMode { Off, On, Adaptive };
+
+const char *vsyncModeName(VsyncMode mode);
+
+struct FramePacing {
+  VsyncMode vsync = VsyncMode::On;
+  // Frame rate limit, 0 for none
+  double maxFps = 0.0;
+  // Frames the GPU may be behind the GL thread, 0 for no limit
+  size_t maxFramesInFlight = 2;
+  // Sample input only once the frame from two frames back has finished on the GPU, so input is at most one GPU
+  // frame old when it is drawn. Caps frames in flight at 1.
+  bool lowLatency = false;
+};
+
+// Set the swap interval of the context current on the calling thread. Adaptive vsync tears late frames instead of
+// waiting for the next refresh, and falls back to On where the driver lacks swap tear control. Returns the mode set.
+VsyncMode setVsync(VsyncMode mode);
+
+// Holds frames to a maximum rate against glfwGetTime(). Sleeping alone overshoots by the scheduler's granularity, so
+// it sleeps until SPIN_SECONDS before the deadline and spins the rest.
+class FrameLimiter {
+public:
+  static constexpr double SPIN_SECONDS = 0.002;
+
+  explicit FrameLimiter(double maxFps);
+
+  // Block until the next frame may start
+  void wait();
+
+  double sleptSeconds = 0.0;
+  double spunSeconds = 0.0;
+
+private:
+  double period;
+  double deadline = 0.0;
+};
+
+struct FramePacingStats {
+  double limiterSleepSeconds = 0.0;
+  double limiterSpinSeconds = 0.0;
+  // GL thread blocked on the fence of an old frame to stay within the frames in flight
+  double fenceWaitSeconds = 0.0;
+  // Main thread held back by low latency mode
+  double inputWaitSeconds = 0.0;
+
+  void print() const;
+};
+
+// Paces the render loop. beginFrame() runs on the main thread before input is sampled and applies the frame limiter
+// and low latency mode. endFrame() runs on the GL thread after the frame's last command, fences the frame and waits
+// for old frames until no more than the allowed number are in flight. The two may be on different threads, they
+// only share a count of frames the GPU has finished.
+//
+// Create it with the context current, which is where setVsync() is called, and destroy it with the context current
+// again, since it deletes the fences still pending.
+//
+// Held back by low latency mode, the main thread spins for INPUT_SPIN_SECONDS and then sleeps until the GL thread
+// retires a frame.
+class FramePacer {
+public:
+  static constexpr double INPUT_SPIN_SECONDS = 0.001;
+
+  explicit FramePacer(const FramePacing &pacing);
+  ~FramePacer();
+
+  FramePacer(const FramePacer &) = delete;
+  FramePacer &operator=(const FramePacer &) = delete;
+
+  void beginFrame();
+  void endFrame();
+
+  const FramePacing &settings() const { return pacing; }
+  // Counts since the last call
+  FramePacingStats takeStats();
+
+private:
+  FramePacing pacing;
+  FrameLimiter limiter;
+  // Main thread
+  size_t framesBegun = 0;
+  double inputWaitSeconds = 0.0;
+  // GL thread
+  std::deque<GLsync> fences;
+  std::atomic<int64_t> fenceWaitNanoseconds{0};
+  std::atomic<size_t> framesCompleted{0};
+  std::mutex completedMutex;
+  std::condition_variable completed;
+
+  // Delete the oldest fence once it has signalled, waiting for it when wait is set. Returns false if it has not.
+  bool retireOldest(bool wait);
+};
+
+#endif
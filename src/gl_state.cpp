@@ -0,0 +1,378 @@
+#include "gl_state.hpp"
+#include "pipeline_state.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+
+static constexpr GLenum BUFFER_TARGET_TABLE[] = {
+    GL_ARRAY_BUFFER,
+    GL_DRAW_INDIRECT_BUFFER,
+    GL_DISPATCH_INDIRECT_BUFFER,
+    GL_PIXEL_PACK_BUFFER,
+    GL_PIXEL_UNPACK_BUFFER,
+    GL_COPY_READ_BUFFER,
+    GL_COPY_WRITE_BUFFER,
+    GL_SHADER_STORAGE_BUFFER,
+    GL_UNIFORM_BUFFER,
+    GL_ATOMIC_COUNTER_BUFFER,
+    GL_QUERY_BUFFER,
+    GL_PARAMETER_BUFFER,
+};
+// Transform feedback buffers belong to the bound transform feedback object, so they are not tracked
+static constexpr GLenum INDEXED_TARGET_TABLE[] = {
+    GL_SHADER_STORAGE_BUFFER,
+    GL_UNIFORM_BUFFER,
+    GL_ATOMIC_COUNTER_BUFFER,
+};
+static constexpr GLenum CAPABILITY_TABLE[] = {
+    GL_BLEND,
+    GL_DEPTH_TEST,
+    GL_CULL_FACE,
+    GL_SCISSOR_TEST,
+    GL_STENCIL_TEST,
+    GL_RASTERIZER_DISCARD,
+    GL_MULTISAMPLE,
+    GL_PRIMITIVE_RESTART_FIXED_INDEX,
+};
+
+bool GlStateCache::count(bool changed) {
+  if (changed) {
+    counts.issued++;
+  } else {
+    counts.elided++;
+  }
+  return changed;
+}
+
+int GlStateCache::bufferSlot(GLenum target) {
+  static_assert(std::size(BUFFER_TARGET_TABLE) == BUFFER_TARGETS);
+  const GLenum *slot = std::find(std::begin(BUFFER_TARGET_TABLE), std::end(BUFFER_TARGET_TABLE), target);
+  return slot == std::end(BUFFER_TARGET_TABLE) ? -1 : (int)(slot - std::begin(BUFFER_TARGET_TABLE));
+}
+
+int GlStateCache::indexedSlot(GLenum target) {
+  static_assert(std::size(INDEXED_TARGET_TABLE) == INDEXED_TARGETS);
+  const GLenum *slot = std::find(std::begin(INDEXED_TARGET_TABLE), std::end(INDEXED_TARGET_TABLE), target);
+  return slot == std::end(INDEXED_TARGET_TABLE) ? -1 : (int)(slot - std::begin(INDEXED_TARGET_TABLE));
+}
+
+int GlStateCache::capabilitySlot(GLenum capability) {
+  static_assert(std::size(CAPABILITY_TABLE) == CAPABILITIES);
+  const GLenum *slot = std::find(std::begin(CAPABILITY_TABLE), std::end(CAPABILITY_TABLE), capability);
+  return slot == std::end(CAPABILITY_TABLE) ? -1 : (int)(slot - std::begin(CAPABILITY_TABLE));
+}
+
+void GlStateCache::useProgram(GLuint program) {
+  if (count(this->program != program)) {
+    this->program = program;
+    pipeline = nullptr;
+    glUseProgram(program);
+  }
+}
+
+void GlStateCache::bindVertexArray(GLuint vertexArray) {
+  if (count(this->vertexArray != vertexArray)) {
+    this->vertexArray = vertexArray;
+    // Draws attach their own vertex arrays under pipelines that leave them out
+    if (pipeline && pipeline->desc().vertexArray != 0) {
+      pipeline = nullptr;
+    }
+    glBindVertexArray(vertexArray);
+  }
+}
+
+void GlStateCache::bindTextureUnit(GLuint unit, GLuint texture) {
+  if (unit >= TEXTURE_UNITS) {
+    count(true);
+    glBindTextureUnit(unit, texture);
+  } else if (count(textures[unit] != texture)) {
+    textures[unit] = texture;
+    glBindTextureUnit(unit, texture);
+  }
+}
+
+void GlStateCache::bindSampler(GLuint unit, GLuint sampler) {
+  if (unit >= TEXTURE_UNITS) {
+    count(true);
+    glBindSampler(unit, sampler);
+  } else if (count(samplers[unit] != sampler)) {
+    samplers[unit] = sampler;
+    glBindSampler(unit, sampler);
+  }
+}
+
+void GlStateCache::bindBuffer(GLenum target, GLuint buffer) {
+  int slot = bufferSlot(target);
+  if (slot < 0) {
+    count(true);
+    glBindBuffer(target, buffer);
+  } else if (count(buffers[slot] != buffer)) {
+    buffers[slot] = buffer;
+    glBindBuffer(target, buffer);
+  }
+}
+
+void GlStateCache::bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+  // A base binding is a range binding of the whole buffer, whatever its size
+  bindBufferRange(target, index, buffer, 0, 0);
+}
+
+GlStateCache::VertexArrayAttachments &GlStateCache::attachmentsOf(GLuint vertexArray) {
+  auto [it, inserted] = attachments.try_emplace(vertexArray);
+  if (inserted) {
+    it->second.elementBuffer = UNKNOWN;
+    std::fill(std::begin(it->second.bindings), std::end(it->second.bindings), VertexBinding{UNKNOWN, 0, 0});
+  }
+  return it->second;
+}
+
+void GlStateCache::vertexArrayVertexBuffer(
+    GLuint vertexArray, GLuint binding, GLuint buffer, GLintptr offset, GLsizei stride) {
+  if (binding < VERTEX_BINDINGS) {
+    VertexBinding &current = attachmentsOf(vertexArray).bindings[binding];
+    if (!count(current.buffer != buffer || current.offset != offset || current.stride != stride)) {
+      return;
+    }
+    current = {buffer, offset, stride};
+  } else {
+    count(true);
+  }
+  glVertexArrayVertexBuffer(vertexArray, binding, buffer, offset, stride);
+}
+
+void GlStateCache::vertexArrayElementBuffer(GLuint vertexArray, GLuint buffer) {
+  GLuint &current = attachmentsOf(vertexArray).elementBuffer;
+  if (count(current != buffer)) {
+    current = buffer;
+    glVertexArrayElementBuffer(vertexArray, buffer);
+  }
+}
+
+void GlStateCache::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+  int slot = indexedSlot(target);
+  IndexedBinding binding{buffer, offset, size};
+  if (slot >= 0 && index < INDEXED_BINDINGS) {
+    IndexedBinding &current = indexed[slot][index];
+    if (!count(current.buffer != buffer || current.offset != offset || current.size != size)) {
+      return;
+    }
+    current = binding;
+    buffers[bufferSlot(target)] = buffer;
+  } else {
+    count(true);
+    // Keep the generic binding right even when the indexed one is not tracked
+    int generic = bufferSlot(target);
+    if (generic >= 0) {
+      buffers[generic] = buffer;
+    }
+  }
+  if (size == 0) {
+    glBindBufferBase(target, index, buffer);
+  } else {
+    glBindBufferRange(target, index, buffer, offset, size);
+  }
+}
+
+void GlStateCache::bindTransformFeedback(GLuint feedback) {
+  if (count(transformFeedback != feedback)) {
+    transformFeedback = feedback;
+    glBindTransformFeedback(GL_TRANSFORM_FEEDBACK, feedback);
+  }
+}
+
+void GlStateCache::bindPipeline(const PipelineState *next) {
+  if (pipeline == next) {
+    count(false);
+    return;
+  }
+  // Without a current pipeline every group is issued, and the setters still drop what the shadow state already has
+  const PipelineDesc &to = next->desc();
+  const PipelineDesc *from = pipeline ? &pipeline->desc() : nullptr;
+  if (!from || from->program != to.program) {
+    useProgram(to.program);
+  }
+  if (to.vertexArray != 0 && (!from || from->vertexArray != to.vertexArray)) {
+    bindVertexArray(to.vertexArray);
+  }
+  if (!from || !(from->blend == to.blend)) {
+    setEnabled(GL_BLEND, to.blend.enabled);
+    if (to.blend.enabled) {
+      blendFunc(to.blend.source, to.blend.destination);
+    }
+  }
+  if (!from || !(from->depth == to.depth)) {
+    setEnabled(GL_DEPTH_TEST, to.depth.test);
+    depthMask(to.depth.write);
+    if (to.depth.test) {
+      depthFunc(to.depth.func);
+    }
+  }
+  if (!from || !(from->raster == to.raster)) {
+    setEnabled(GL_CULL_FACE, to.raster.cull);
+    if (to.raster.cull) {
+      cullFace(to.raster.cullFace);
+    }
+    setEnabled(GL_MULTISAMPLE, to.raster.multisample);
+    polygonMode(to.raster.polygonMode);
+  }
+  pipeline = next;
+}
+
+void GlStateCache::setEnabled(GLenum capability, bool enabled) {
+  int slot = capabilitySlot(capability);
+  if (slot >= 0 && !count(capabilities[slot] != (int8_t)enabled)) {
+    return;
+  }
+  // Not every capability belongs to pipelines, but checking costs more than the rare extra full bind
+  pipeline = nullptr;
+  if (slot >= 0) {
+    capabilities[slot] = (int8_t)enabled;
+  } else {
+    count(true);
+  }
+  if (enabled) {
+    glEnable(capability);
+  } else {
+    glDisable(capability);
+  }
+}
+
+void GlStateCache::blendFunc(GLenum source, GLenum destination) {
+  if (count(blend[0] != source || blend[1] != destination)) {
+    blend[0] = source;
+    blend[1] = destination;
+    pipeline = nullptr;
+    glBlendFunc(source, destination);
+  }
+}
+
+void GlStateCache::depthFunc(GLenum func) {
+  if (count(depthTest != func)) {
+    depthTest = func;
+    pipeline = nullptr;
+    glDepthFunc(func);
+  }
+}
+
+void GlStateCache::depthMask(bool write) {
+  if (count(depthWrite != (int8_t)write)) {
+    depthWrite = (int8_t)write;
+    pipeline = nullptr;
+    glDepthMask(write ? GL_TRUE : GL_FALSE);
+  }
+}
+
+void GlStateCache::cullFace(GLenum face) {
+  if (count(cullMode != face)) {
+    cullMode = face;
+    pipeline = nullptr;
+    glCullFace(face);
+  }
+}
+
+void GlStateCache::polygonMode(GLenum mode) {
+  if (count(polygonFill != mode)) {
+    polygonFill = mode;
+    pipeline = nullptr;
+    glPolygonMode(GL_FRONT_AND_BACK, mode);
+  }
+}
+
+void GlStateCache::viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+  GLint rect[4] = {x, y, width, height};
+  if (count(!viewportKnown || !std::equal(rect, rect + 4, viewportRect))) {
+    std::copy(rect, rect + 4, viewportRect);
+    viewportKnown = true;
+    glViewport(x, y, width, height);
+  }
+}
+
+void GlStateCache::clearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a) {
+  GLfloat colour[4] = {r, g, b, a};
+  if (count(!clearKnown || !std::equal(colour, colour + 4, clear))) {
+    std::copy(colour, colour + 4, clear);
+    clearKnown = true;
+    glClearColor(r, g, b, a);
+  }
+}
+
+void GlStateCache::forgetProgram(GLuint program) {
+  if (this->program == program) {
+    this->program = UNKNOWN;
+    pipeline = nullptr;
+  }
+}
+
+void GlStateCache::forgetVertexArray(GLuint vertexArray) {
+  if (this->vertexArray == vertexArray) {
+    this->vertexArray = UNKNOWN;
+    pipeline = nullptr;
+  }
+  attachments.erase(vertexArray);
+}
+
+void GlStateCache::forgetTexture(GLuint texture) { std::replace(textures, textures + TEXTURE_UNITS, texture, UNKNOWN); }
+
+void GlStateCache::forgetSampler(GLuint sampler) { std::replace(samplers, samplers + TEXTURE_UNITS, sampler, UNKNOWN); }
+
+void GlStateCache::forgetBuffer(GLuint buffer) {
+  std::replace(buffers, buffers + BUFFER_TARGETS, buffer, UNKNOWN);
+  for (IndexedBinding(&bindings)[INDEXED_BINDINGS] : indexed) {
+    for (IndexedBinding &binding : bindings) {
+      if (binding.buffer == buffer) {
+        binding.buffer = UNKNOWN;
+      }
+    }
+  }
+  for (auto &[vertexArray, attached] : attachments) {
+    if (attached.elementBuffer == buffer) {
+      attached.elementBuffer = UNKNOWN;
+    }
+    for (VertexBinding &binding : attached.bindings) {
+      if (binding.buffer == buffer) {
+        binding.buffer = UNKNOWN;
+      }
+    }
+  }
+}
+
+void GlStateCache::forgetTransformFeedback(GLuint feedback) {
+  if (transformFeedback == feedback) {
+    transformFeedback = UNKNOWN;
+  }
+}
+
+void GlStateCache::invalidate() {
+  program = vertexArray = transformFeedback = UNKNOWN;
+  std::fill(textures, textures + TEXTURE_UNITS, UNKNOWN);
+  std::fill(samplers, samplers + TEXTURE_UNITS, UNKNOWN);
+  std::fill(buffers, buffers + BUFFER_TARGETS, UNKNOWN);
+  for (IndexedBinding(&bindings)[INDEXED_BINDINGS] : indexed) {
+    std::fill(bindings, bindings + INDEXED_BINDINGS, IndexedBinding{UNKNOWN, 0, 0});
+  }
+  attachments.clear();
+  std::fill(capabilities, capabilities + CAPABILITIES, (int8_t)-1);
+  blend[0] = blend[1] = depthTest = cullMode = polygonFill = UNKNOWN;
+  pipeline = nullptr;
+  depthWrite = -1;
+  viewportKnown = clearKnown = false;
+}
+
+GlStateStats GlStateCache::takeStats() {
+  GlStateStats stats = counts;
+  counts = {};
+  return stats;
+}
+
+void GlStateStats::print(size_t frames) const {
+  frames = std::max<size_t>(frames, 1);
+  printf("GL state: %.1f calls issued, %.1f elided per frame (%.0f%% elided)\n",
+         (double)issued / frames,
+         (double)elided / frames,
+         elidedFraction() * 100.0);
+}
+
+GlStateCache &glState() {
+  static GlStateCache cache;
+  return cache;
+}
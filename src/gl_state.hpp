@@ -0,0 +1,135 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <glad/gl.h>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+
+class PipelineState;
+
+struct GlStateStats {
+  size_t issued = 0;
+  size_t elided = 0;
+
+  double elidedFraction() const { return issued + elided > 0 ? (double)elided / (issued + elided) : 0.0; }
+  // Counts are divided by frames, to report a whole interval per frame
+  void print(size_t frames = 1) const;
+};
+
+// Shadow copy of the GL state the renderer changes. Every setter compares against the value it last sent and skips
+// the GL call when it would change nothing. All of it starts out unknown, so the first call of each kind is always
+// issued. GL unbinds deleted objects behind our back and reuses their names, so owners report deletions through
+// forget*(). Code that changes state without going through the cache must call invalidate().
+//
+// bindPipeline() sets a whole PipelineState. While the state it covers is untouched, binding the same pipeline again
+// costs one pointer compare, and binding another one only issues the groups in which the two differ.
+class GlStateCache {
+public:
+  // Texture and sampler units tracked, higher units go straight to GL
+  static constexpr GLuint TEXTURE_UNITS = 32;
+  // Indexed binding points tracked per indexed buffer target
+  static constexpr GLuint INDEXED_BINDINGS = 16;
+  // Vertex buffer bindings tracked per vertex array, higher bindings go straight to GL
+  static constexpr GLuint VERTEX_BINDINGS = 8;
+
+  GlStateCache() { invalidate(); }
+
+  GlStateCache(const GlStateCache &) = delete;
+  GlStateCache &operator=(const GlStateCache &) = delete;
+
+  void useProgram(GLuint program);
+  void bindVertexArray(GLuint vertexArray);
+  void bindTextureUnit(GLuint unit, GLuint texture);
+  void bindSampler(GLuint unit, GLuint sampler);
+  // Non-indexed targets only, GL_ELEMENT_ARRAY_BUFFER belongs to the vertex array and is not tracked
+  void bindBuffer(GLenum target, GLuint buffer);
+  // Indexed targets, these also set the target's generic binding as GL does
+  void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+  void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+  void bindTransformFeedback(GLuint feedback);
+  // Buffers attached to a vertex array, which keeps them whether or not it is bound
+  void vertexArrayVertexBuffer(GLuint vertexArray, GLuint binding, GLuint buffer, GLintptr offset, GLsizei stride);
+  void vertexArrayElementBuffer(GLuint vertexArray, GLuint buffer);
+
+  // Make the pipeline's program, vertex array (unless 0), blend, depth and raster state current
+  void bindPipeline(const PipelineState *pipeline);
+
+  void setEnabled(GLenum capability, bool enabled);
+  void blendFunc(GLenum source, GLenum destination);
+  void depthFunc(GLenum func);
+  void depthMask(bool write);
+  void cullFace(GLenum face);
+  void polygonMode(GLenum mode);
+  void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+  void clearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a);
+
+  void forgetProgram(GLuint program);
+  void forgetVertexArray(GLuint vertexArray);
+  void forgetTexture(GLuint texture);
+  void forgetSampler(GLuint sampler);
+  void forgetBuffer(GLuint buffer);
+  void forgetTransformFeedback(GLuint feedback);
+  // Treat every piece of state as unknown again
+  void invalidate();
+
+  // Counts since the last call
+  GlStateStats takeStats();
+
+private:
+  static constexpr GLuint UNKNOWN = UINT32_MAX;
+  static constexpr size_t BUFFER_TARGETS = 12;
+  static constexpr size_t INDEXED_TARGETS = 3;
+  static constexpr size_t CAPABILITIES = 8;
+
+  struct IndexedBinding {
+    GLuint buffer;
+    GLintptr offset;
+    GLsizeiptr size;
+  };
+  struct VertexBinding {
+    GLuint buffer;
+    GLintptr offset;
+    GLsizei stride;
+  };
+  struct VertexArrayAttachments {
+    GLuint elementBuffer;
+    VertexBinding bindings[VERTEX_BINDINGS];
+  };
+
+  GLuint program;
+  GLuint vertexArray;
+  GLuint textures[TEXTURE_UNITS];
+  GLuint samplers[TEXTURE_UNITS];
+  GLuint buffers[BUFFER_TARGETS];
+  IndexedBinding indexed[INDEXED_TARGETS][INDEXED_BINDINGS];
+  GLuint transformFeedback;
+  // Only vertex arrays that had something attached through the cache
+  std::unordered_map<GLuint, VertexArrayAttachments> attachments;
+  // -1 unknown, 0 disabled, 1 enabled, in the order of the capability table
+  int8_t capabilities[CAPABILITIES];
+  GLenum blend[2];
+  GLenum depthTest;
+  int8_t depthWrite;
+  GLenum cullMode;
+  GLenum polygonFill;
+  // Bound through bindPipeline() and not changed since, otherwise nullptr
+  const PipelineState *pipeline;
+  GLint viewportRect[4];
+  bool viewportKnown;
+  GLfloat clear[4];
+  bool clearKnown;
+  GlStateStats counts;
+
+  // Record the call as issued when changed, otherwise as elided, and return changed
+  bool count(bool changed);
+  VertexArrayAttachments &attachmentsOf(GLuint vertexArray);
+  static int bufferSlot(GLenum target);
+  static int indexedSlot(GLenum target);
+  static int capabilitySlot(GLenum capability);
+};
+
+// The cache for the one GL context, only to be used from the thread that owns it
+GlStateCache &glState();
+
+#endif
@@ -0,0 +1,411 @@
+#include "glb_loader.hpp"
+#include "gl_state.hpp"
+#include "json.hpp"
+#include "mapped_file.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <limits>
+#include <string_view>
+
+static constexpr uint32_t GLB_MAGIC = 0x46546C67;      // "glTF"
+static constexpr uint32_t GLB_CHUNK_JSON = 0x4E4F534A; // "JSON"
+static constexpr uint32_t GLB_CHUNK_BIN = 0x004E4942;  // "BIN\0"
+
+static constexpr GLuint POSITION_LOCATION = 0;
+static constexpr GLuint COLOUR_LOCATION = 1;
+static constexpr GLuint TEXCOORD_LOCATION = 2;
+
+namespace {
+
+uint32_t readUint32(const char *data) {
+  uint32_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+// glTF component types are the GL type enums
+size_t componentSize(long long componentType) {
+  switch (componentType) {
+  case GL_BYTE:
+  case GL_UNSIGNED_BYTE:
+    return 1;
+  case GL_SHORT:
+  case GL_UNSIGNED_SHORT:
+    return 2;
+  case GL_UNSIGNED_INT:
+  case GL_FLOAT:
+    return 4;
+  default:
+    return 0;
+  }
+}
+
+int componentCount(const std::string &type) {
+  if (type == "SCALAR") {
+    return 1;
+  } else if (type == "VEC2") {
+    return 2;
+  } else if (type == "VEC3") {
+    return 3;
+  } else if (type == "VEC4" || type == "MAT2") {
+    return 4;
+  } else if (type == "MAT3") {
+    return 9;
+  } else if (type == "MAT4") {
+    return 16;
+  }
+  return 0;
+}
+
+// Accessor data resolved to a GL buffer range
+struct AccessorData {
+  std::shared_ptr<Buffer> buffer;
+  GLintptr offset = 0;
+  GLsizei stride = 0;
+  GLint components = 0;
+  GLenum type = 0;
+  GLboolean normalized = GL_FALSE;
+  size_t count = 0;
+};
+
+class GlbReader {
+public:
+  GlbReader(const JsonValue &root, const char *bin, size_t binSize, GlbModel &model, GlbLoadStats &stats)
+      : root(root), bin(bin), binSize(binSize), model(model), stats(stats), views(root["bufferViews"].size()) {}
+
+  // Bytes of a buffer view inside the BIN chunk, null if it lies elsewhere or out of range
+  const char *viewData(size_t view, size_t &size, size_t &stride) const {
+    const JsonValue &bufferView = root["bufferViews"][view];
+    if (!bufferView.isObject()) {
+      return nullptr;
+    }
+    const JsonValue &buffer = root["buffers"][(size_t)bufferView["buffer"].asInt(-1)];
+    if (!buffer.isObject() || buffer.contains("uri")) {
+      std::cout << "ERROR::GLB::EXTERNAL_BUFFER " << model.path << std::endl;
+      return nullptr;
+    }
+    size_t offset = (size_t)bufferView["byteOffset"].asInt(0);
+    size = (size_t)bufferView["byteLength"].asInt(0);
+    stride = (size_t)bufferView["byteStride"].asInt(0);
+    if (bin == nullptr || offset > binSize || size > binSize - offset) {
+      return nullptr;
+    }
+    return bin + offset;
+  }
+
+  // tightlyPacked forces a copy when the view has a stride, element buffers cannot express one
+  bool accessor(size_t index, AccessorData &data, bool tightlyPacked = false) {
+    const JsonValue &accessor = root["accessors"][index];
+    size_t elementComponents = (size_t)componentCount(accessor["type"].asString());
+    size_t component = componentSize(accessor["componentType"].asInt());
+    long long declaredCount = accessor["count"].asInt(0);
+    if (!accessor.isObject() || elementComponents == 0 || component == 0 || declaredCount < 1) {
+      return false;
+    }
+    size_t count = (size_t)declaredCount;
+    size_t elementSize = elementComponents * component;
+    data.components = (GLint)elementComponents;
+    data.type = (GLenum)accessor["componentType"].asInt();
+    data.normalized = accessor["normalized"].asBool() ? GL_TRUE : GL_FALSE;
+    data.count = count;
+
+    size_t byteOffset = (size_t)accessor["byteOffset"].asInt(0);
+    const char *source = nullptr;
+    size_t viewSize = 0, viewStride = 0;
+    if (accessor.contains("bufferView")) {
+      size_t view = (size_t)accessor["bufferView"].asInt(-1);
+      source = viewData(view, viewSize, viewStride);
+      size_t stride = viewStride != 0 ? viewStride : elementSize;
+      // Compare counts rather than byte sizes, a hostile count would wrap the multiplication
+      if (source == nullptr || byteOffset > viewSize || elementSize > viewSize - byteOffset ||
+          count > (viewSize - byteOffset - elementSize) / stride + 1) {
+        return false;
+      }
+      // The common case: the view is already laid out the way GL reads it, so hand it over as is
+      if (!accessor.contains("sparse") && (!tightlyPacked || stride == elementSize)) {
+        if (!views[view]) {
+          views[view] = std::make_shared<Buffer>(viewSize, source);
+          model.buffers.push_back(views[view]);
+          stats.uploadedBytes += viewSize;
+        }
+        data.buffer = views[view];
+        data.offset = (GLintptr)byteOffset;
+        data.stride = (GLsizei)stride;
+        return true;
+      }
+    }
+
+    // Sparse, view-less or restrided accessors are built densely on the CPU, starting from the view's values or zeros.
+    // Nothing bounds a view-less accessor's count, so it may not ask for more than the file holds.
+    if (source == nullptr && count > binSize / elementSize) {
+      return false;
+    }
+    std::vector<char> dense(count * elementSize, 0);
+    if (source != nullptr) {
+      size_t stride = viewStride != 0 ? viewStride : elementSize;
+      for (size_t i = 0; i < count; i++) {
+        std::memcpy(&dense[i * elementSize], source + byteOffset + i * stride, elementSize);
+      }
+    }
+    const JsonValue &sparse = accessor["sparse"];
+    if (sparse.isObject() && !applySparse(sparse, elementSize, dense)) {
+      return false;
+    }
+    data.buffer = std::make_shared<Buffer>(dense.size(), dense.data());
+    model.buffers.push_back(data.buffer);
+    data.offset = 0;
+    data.stride = (GLsizei)elementSize;
+    stats.copiedBytes += dense.size();
+    return true;
+  }
+
+  bool applySparse(const JsonValue &sparse, size_t elementSize, std::vector<char> &dense) const {
+    long long declaredCount = sparse["count"].asInt(0);
+    size_t elements = dense.size() / elementSize;
+    if (declaredCount < 1 || (size_t)declaredCount > elements) {
+      return false;
+    }
+    size_t count = (size_t)declaredCount;
+    const JsonValue &indices = sparse["indices"], &values = sparse["values"];
+    size_t indexSize = componentSize(indices["componentType"].asInt());
+    size_t indexViewSize, valueViewSize, unusedStride;
+    const char *indexView = viewData((size_t)indices["bufferView"].asInt(-1), indexViewSize, unusedStride);
+    const char *valueView = viewData((size_t)values["bufferView"].asInt(-1), valueViewSize, unusedStride);
+    size_t indexOffset = (size_t)indices["byteOffset"].asInt(0), valueOffset = (size_t)values["byteOffset"].asInt(0);
+    if (indexView == nullptr || valueView == nullptr || indexSize == 0 || indexOffset > indexViewSize ||
+        count > (indexViewSize - indexOffset) / indexSize || valueOffset > valueViewSize ||
+        count > (valueViewSize - valueOffset) / elementSize) {
+      return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+      uint32_t target = 0;
+      std::memcpy(&target, indexView + indexOffset + i * indexSize, indexSize);
+      if (target >= elements) {
+        return false;
+      }
+      std::memcpy(&dense[target * elementSize], valueView + valueOffset + i * elementSize, elementSize);
+    }
+    return true;
+  }
+
+  void attribute(GLuint vao, GLuint location, const AccessorData &data) {
+    glEnableVertexArrayAttrib(vao, location);
+    glVertexArrayAttribFormat(vao, location, data.components, data.type, data.normalized, 0);
+    glVertexArrayAttribBinding(vao, location, location);
+    glState().vertexArrayVertexBuffer(vao, location, data.buffer->id, data.offset, data.stride);
+  }
+
+  // Image bound to the base colour texture of a material, or -1
+  int materialImage(const JsonValue &material) const {
+    const JsonValue &textureInfo = material["pbrMetallicRoughness"]["baseColorTexture"];
+    const JsonValue &texture = root["textures"][(size_t)textureInfo["index"].asInt(-1)];
+    return (int)texture["source"].asInt(-1);
+  }
+
+  bool primitive(const JsonValue &source, GlbPrimitive &primitive) {
+    const JsonValue &attributes = source["attributes"];
+    AccessorData position;
+    if (!attributes.contains("POSITION") || !accessor((size_t)attributes["POSITION"].asInt(-1), position) ||
+        position.components != 3) {
+      return false;
+    }
+
+    glCreateVertexArrays(1, &primitive.vao);
+    attribute(primitive.vao, POSITION_LOCATION, position);
+    AccessorData colour, texCoord;
+    if (attributes.contains("COLOR_0") && accessor((size_t)attributes["COLOR_0"].asInt(-1), colour)) {
+      attribute(primitive.vao, COLOUR_LOCATION, colour);
+      primitive.hasColour = true;
+    }
+    if (attributes.contains("TEXCOORD_0") && accessor((size_t)attributes["TEXCOORD_0"].asInt(-1), texCoord)) {
+      attribute(primitive.vao, TEXCOORD_LOCATION, texCoord);
+      primitive.hasTexCoord = true;
+    }
+
+    // Draw counts are GLsizei
+    constexpr size_t MAX_DRAW_COUNT = (size_t)std::numeric_limits<GLsizei>::max();
+    primitive.mode = (GLenum)source["mode"].asInt(GL_TRIANGLES);
+    if (position.count > MAX_DRAW_COUNT) {
+      return false;
+    }
+    primitive.count = (GLsizei)position.count;
+    if (source.contains("indices")) {
+      AccessorData indices;
+      if (!accessor((size_t)source["indices"].asInt(-1), indices, true) || indices.components != 1 ||
+          indices.count > MAX_DRAW_COUNT) {
+        return false;
+      }
+      glState().vertexArrayElementBuffer(primitive.vao, indices.buffer->id);
+      primitive.indexType = indices.type;
+      primitive.indexOffset = indices.offset;
+      primitive.count = (GLsizei)indices.count;
+    }
+    primitive.image = materialImage(root["materials"][(size_t)source["material"].asInt(-1)]);
+
+    const JsonValue &positionAccessor = root["accessors"][(size_t)attributes["POSITION"].asInt(-1)];
+    if (positionAccessor["min"].size() == 3 && positionAccessor["max"].size() == 3) {
+      bool first = model.primitives.empty();
+      for (size_t k = 0; k < 3; k++) {
+        float low = (float)positionAccessor["min"][k].asNumber(), high = (float)positionAccessor["max"][k].asNumber();
+        model.boundsMin[k] = first ? low : std::min(model.boundsMin[k], low);
+        model.boundsMax[k] = first ? high : std::max(model.boundsMax[k], high);
+      }
+    }
+    return true;
+  }
+
+private:
+  const JsonValue &root;
+  const char *bin;
+  size_t binSize;
+  GlbModel &model;
+  GlbLoadStats &stats;
+  // GL buffer per buffer view, created the first time an accessor uses the view
+  std::vector<std::shared_ptr<Buffer>> views;
+};
+
+} // namespace
+
+GlbModel::~GlbModel() {
+  for (const GlbPrimitive &primitive : primitives) {
+    glState().forgetVertexArray(primitive.vao);
+    glDeleteVertexArrays(1, &primitive.vao);
+  }
+}
+
+void GlbModel::draw(const std::vector<std::shared_ptr<Texture>> &textures) const {
+  for (const GlbPrimitive &primitive : primitives) {
+    if (primitive.image >= 0 && (size_t)primitive.image < textures.size() && textures[primitive.image]) {
+      textures[primitive.image]->bind();
+    }
+    // Missing attributes read the current generic value instead
+    if (!primitive.hasColour) {
+      glVertexAttrib3f(COLOUR_LOCATION, 1.0f, 1.0f, 1.0f);
+    }
+    if (!primitive.hasTexCoord) {
+      glVertexAttrib2f(TEXCOORD_LOCATION, 0.0f, 0.0f);
+    }
+    glState().bindVertexArray(primitive.vao);
+    if (primitive.indexType != 0) {
+      glDrawElements(primitive.mode, primitive.count, primitive.indexType, (const void *)primitive.indexOffset);
+    } else {
+      glDrawArrays(primitive.mode, 0, primitive.count);
+    }
+  }
+}
+
+std::unique_ptr<GlbModel> loadGlb(const std::string &path, ThreadPool &pool, GlbLoadStats *stats) {
+  auto wallStart = std::chrono::steady_clock::now();
+  auto model = std::make_unique<GlbModel>();
+  model->path = path;
+  GlbLoadStats loadStats;
+
+  // Views are read wherever accessors point, so no sequential read ahead
+  MappedFile file(path, false);
+  if (file.data == nullptr || file.size < 20 || readUint32(file.data) != GLB_MAGIC ||
+      readUint32(file.data + 4) != 2) {
+    std::cout << "ERROR::GLB::NOT_GLB_2 " << path << std::endl;
+    return model;
+  }
+  loadStats.mappedBytes = file.size;
+
+  // Header, then a JSON chunk and an optional BIN chunk, each 4 byte aligned
+  size_t length = std::min((size_t)readUint32(file.data + 8), file.size);
+  std::string_view json;
+  const char *bin = nullptr;
+  size_t binSize = 0;
+  for (size_t offset = 12; offset + 8 <= length;) {
+    size_t chunkSize = readUint32(file.data + offset);
+    uint32_t chunkType = readUint32(file.data + offset + 4);
+    if (chunkSize > length - offset - 8) {
+      break;
+    }
+    if (chunkType == GLB_CHUNK_JSON && json.empty()) {
+      json = std::string_view(file.data + offset + 8, chunkSize);
+    } else if (chunkType == GLB_CHUNK_BIN && bin == nullptr) {
+      bin = file.data + offset + 8;
+      binSize = chunkSize;
+    }
+    offset += 8 + ((chunkSize + 3) & ~(size_t)3);
+  }
+
+  JsonValue root;
+  std::string error;
+  if (!parseJson(json, root, &error)) {
+    std::cout << "ERROR::GLB::JSON " << path << "\n" << error << std::endl;
+    return model;
+  }
+
+  // Start the image decodes first, so they overlap with the geometry upload below
+  GlbReader reader(root, bin, binSize, *model, loadStats);
+  const JsonValue &images = root["images"];
+  model->images.resize(images.size());
+  std::filesystem::path directory = std::filesystem::path(path).parent_path();
+  for (size_t i = 0; i < images.size(); i++) {
+    const JsonValue &image = images[i];
+    std::string name = path + "#image" + std::to_string(i);
+    if (image.contains("bufferView")) {
+      size_t size, stride;
+      const char *data = reader.viewData((size_t)image["bufferView"].asInt(-1), size, stride);
+      if (data == nullptr) {
+        continue;
+      }
+      loadStats.imageBytes += size;
+      pool.enqueue([&model, name, data, size, i]() {
+        model->images[i] = loadImageFromMemory(name, (const unsigned char *)data, size, 4, false);
+      });
+    } else if (image["uri"].asString().rfind("data:", 0) == 0) {
+      std::cout << "ERROR::GLB::DATA_URI_IMAGE " << name << std::endl;
+    } else if (!image["uri"].asString().empty()) {
+      std::string file = (directory / image["uri"].asString()).string();
+      pool.enqueue([&model, file, i]() { model->images[i] = loadImage(file, 4, false); });
+    }
+  }
+
+  const JsonValue &meshes = root["meshes"];
+  for (size_t m = 0; m < meshes.size(); m++) {
+    const JsonValue &sourcePrimitives = meshes[m]["primitives"];
+    for (size_t p = 0; p < sourcePrimitives.size(); p++) {
+      GlbPrimitive primitive;
+      if (reader.primitive(sourcePrimitives[p], primitive)) {
+        model->primitives.push_back(primitive);
+      } else {
+        glState().forgetVertexArray(primitive.vao);
+        glDeleteVertexArrays(1, &primitive.vao);
+        loadStats.skippedPrimitives++;
+      }
+    }
+  }
+  pool.waitIdle();
+
+  if (loadStats.skippedPrimitives > 0) {
+    std::cout << "ERROR::GLB::INVALID_PRIMITIVES " << path << " skipped " << loadStats.skippedPrimitives << std::endl;
+  }
+  loadStats.primitives = model->primitives.size();
+  loadStats.images = (size_t)std::count_if(
+      model->images.begin(), model->images.end(), [](const Image &image) { return image.loaded(); });
+  loadStats.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+  if (stats != nullptr) {
+    *stats = loadStats;
+  }
+  return model;
+}
+
+void GlbLoadStats::print() const {
+  printf("Loaded GLB of %.1f MiB in %.1f ms (%.1f MiB/s): %zu primitives (%zu skipped), %zu images\n",
+         mappedBytes / (1024.0 * 1024.0),
+         wallSeconds * 1000.0,
+         megabytesPerSecond(),
+         primitives,
+         skippedPrimitives,
+         images);
+  printf("  %.1f KiB uploaded straight from the mapping, %.1f KiB copied, %.1f KiB of images decoded in place\n",
+         uploadedBytes / 1024.0,
+         copiedBytes / 1024.0,
+         imageBytes / 1024.0);
+}
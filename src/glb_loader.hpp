@@ -0,0 +1,75 @@
+#ifndef GLB_LOADER_H
+#define GLB_LOADER_H
+
+#include "buffer.hpp"
+#include "image_loader.hpp"
+#include "texture.hpp"
+#include "thread_pool.hpp"
+#include <glad/gl.h>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct GlbLoadStats {
+  // Size of the mapped file
+  size_t mappedBytes = 0;
+  // Buffer view bytes handed to GL straight from the mapping
+  size_t uploadedBytes = 0;
+  // Bytes repacked on the CPU first, for sparse, view-less or strided index accessors
+  size_t copiedBytes = 0;
+  // Encoded image bytes decoded straight from the mapping
+  size_t imageBytes = 0;
+  size_t primitives = 0;
+  size_t skippedPrimitives = 0;
+  size_t images = 0;
+  double wallSeconds = 0.0;
+
+  double megabytesPerSecond() const {
+    return wallSeconds > 0.0 ? mappedBytes / (wallSeconds * 1024.0 * 1024.0) : 0.0;
+  }
+  void print() const;
+};
+
+// One glTF primitive, its vertex array points directly into the uploaded buffer views
+struct GlbPrimitive {
+  GLuint vao = 0;
+  GLenum mode = GL_TRIANGLES;
+  // Index count, or vertex count when indexType is 0
+  GLsizei count = 0;
+  GLenum indexType = 0;
+  GLintptr indexOffset = 0;
+  // Base colour image, -1 if the material has none
+  int image = -1;
+  bool hasColour = false;
+  bool hasTexCoord = false;
+};
+
+// Geometry and images of a GLB file. Attributes use the locations of the textured shaders: POSITION at 0, COLOR_0 at
+// 1 and TEXCOORD_0 at 2. Node transforms are not applied, every primitive is drawn in its mesh's own space.
+class GlbModel {
+public:
+  std::string path;
+  std::vector<std::shared_ptr<Buffer>> buffers;
+  std::vector<GlbPrimitive> primitives;
+  // Decoded with 4 channels and glTF's top-left origin, so they upload without flipping
+  std::vector<Image> images;
+  // Union of the POSITION accessor bounds
+  float boundsMin[3] = {0.0f, 0.0f, 0.0f};
+  float boundsMax[3] = {0.0f, 0.0f, 0.0f};
+
+  GlbModel() = default;
+  ~GlbModel();
+
+  GlbModel(const GlbModel &) = delete;
+  GlbModel &operator=(const GlbModel &) = delete;
+
+  bool loaded() const { return !primitives.empty(); }
+  // textures holds one texture per image (or null), primitives without one keep whatever is bound
+  void draw(const std::vector<std::shared_ptr<Texture>> &textures) const;
+};
+
+// Must run on the GL thread. Embedded images are decoded on the pool while the geometry uploads.
+std::unique_ptr<GlbModel> loadGlb(const std::string &path, ThreadPool &pool, GlbLoadStats *stats = nullptr);
+
+#endif
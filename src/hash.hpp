@@ -0,0 +1,15 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit XXH64 hash of a byte range, fast enough to fingerprint whole images and vertex buffers at load time
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed = 0);
+
+// Fold another value into an existing hash, e.g. image dimensions into a pixel hash
+inline uint64_t hashCombine(uint64_t hash, uint64_t value) {
+  return hash ^ (value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2));
+}
+
+#endif
@@ -0,0 +1,163 @@
+#include "image_loader.hpp"
+#include "stb_image.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <iostream>
+
+// Lower bound on the bytes grouped into one task, so that a folder of tiny tiles does not turn into one job per tile
+static constexpr size_t MIN_TASK_BYTES = 64 * 1024;
+// Aim for a few tasks per worker so one slow decode does not leave the others idle at the end
+static constexpr size_t TASKS_PER_THREAD = 4;
+
+Image loadImage(const std::string &path, int desiredChannels, bool flipVertically) {
+  Image image;
+  image.path = path;
+
+  // The flip flag is thread local, so workers do not race with stbi_set_flip_vertically_on_load() on the main thread
+  stbi_set_flip_vertically_on_load_thread(flipVertically);
+  int fileChannels;
+  unsigned char *data = stbi_load(path.c_str(), &image.width, &image.height, &fileChannels, desiredChannels);
+  if (data == nullptr) {
+    std::cout << "ERROR::IMAGE::LOAD_FAILED " << path << "\n" << stbi_failure_reason() << std::endl;
+    return image;
+  }
+  image.channels = desiredChannels != 0 ? desiredChannels : fileChannels;
+  image.pixels = {data, stbi_image_free};
+  return image;
+}
+
+Image loadImageFromMemory(
+    const std::string &name, const unsigned char *data, size_t size, int desiredChannels, bool flipVertically) {
+  Image image;
+  image.path = name;
+
+  stbi_set_flip_vertically_on_load_thread(flipVertically);
+  int fileChannels;
+  unsigned char *pixels =
+      stbi_load_from_memory(data, (int)size, &image.width, &image.height, &fileChannels, desiredChannels);
+  if (pixels == nullptr) {
+    std::cout << "ERROR::IMAGE::LOAD_FAILED " << name << "\n" << stbi_failure_reason() << std::endl;
+    return image;
+  }
+  image.channels = desiredChannels != 0 ? desiredChannels : fileChannels;
+  image.pixels = {pixels, stbi_image_free};
+  return image;
+}
+
+std::vector<Image> loadImages(const std::vector<std::string> &paths,
+                              int desiredChannels,
+                              bool flipVertically,
+                              ThreadPool &pool,
+                              ImageBatchStats *stats) {
+  auto wallStart = std::chrono::steady_clock::now();
+  std::clock_t cpuStart = std::clock();
+
+  std::vector<size_t> sizes(paths.size(), 0);
+  size_t totalBytes = 0;
+  for (size_t i = 0; i < paths.size(); i++) {
+    std::error_code error;
+    uintmax_t size = std::filesystem::file_size(paths[i], error);
+    sizes[i] = error ? 0 : (size_t)size;
+    totalBytes += sizes[i];
+  }
+
+  size_t targetBytes = std::max(MIN_TASK_BYTES, totalBytes / (pool.size() * TASKS_PER_THREAD));
+
+  // Split into contiguous [first, last) ranges. A file at least as big as the target closes the current group and gets
+  // a task of its own.
+  std::vector<std::pair<size_t, size_t>> groups;
+  size_t groupStart = 0, groupBytes = 0;
+  for (size_t i = 0; i < paths.size(); i++) {
+    if (sizes[i] >= targetBytes) {
+      if (groupStart < i) {
+        groups.emplace_back(groupStart, i);
+      }
+      groups.emplace_back(i, i + 1);
+      groupStart = i + 1;
+      groupBytes = 0;
+      continue;
+    }
+    groupBytes += sizes[i];
+    if (groupBytes >= targetBytes) {
+      groups.emplace_back(groupStart, i + 1);
+      groupStart = i + 1;
+      groupBytes = 0;
+    }
+  }
+  if (groupStart < paths.size()) {
+    groups.emplace_back(groupStart, paths.size());
+  }
+
+  // Biggest groups first so the long decodes start early and the small ones fill the gaps
+  std::vector<size_t> order(groups.size());
+  std::vector<size_t> groupSizes(groups.size(), 0);
+  for (size_t g = 0; g < groups.size(); g++) {
+    order[g] = g;
+    for (size_t i = groups[g].first; i < groups[g].second; i++) {
+      groupSizes[g] += sizes[i];
+    }
+  }
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return groupSizes[a] > groupSizes[b]; });
+
+  // Each task writes only its own slots, so no locking is needed on the results
+  std::vector<Image> images(paths.size());
+  for (size_t g : order) {
+    size_t first = groups[g].first, last = groups[g].second;
+    pool.enqueue([&, first, last]() {
+      for (size_t i = first; i < last; i++) {
+        images[i] = loadImage(paths[i], desiredChannels, flipVertically);
+      }
+    });
+  }
+  pool.waitIdle();
+
+  if (stats != nullptr) {
+    stats->images = paths.size();
+    stats->failed = (size_t)std::count_if(images.begin(), images.end(), [](const Image &i) { return !i.loaded(); });
+    stats->tasks = groups.size();
+    stats->fileBytes = totalBytes;
+    stats->threads = pool.size();
+    stats->wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    stats->cpuSeconds = (double)(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+  }
+  return images;
+}
+
+std::vector<std::string> listImages(const std::string &directory) {
+  std::vector<std::string> paths;
+  std::error_code error;
+  for (const auto &entry : std::filesystem::directory_iterator(directory, error)) {
+    if (!entry.is_regular_file()) {
+      continue;
+    }
+    std::string extension = entry.path().extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".bmp" ||
+        extension == ".tga") {
+      paths.push_back(entry.path().string());
+    }
+  }
+  if (error) {
+    std::cout << "ERROR::IMAGE::DIRECTORY_NOT_READ " << directory << "\n" << error.message() << std::endl;
+  }
+  std::sort(paths.begin(), paths.end());
+  return paths;
+}
+
+void ImageBatchStats::print() const {
+  printf("Decoded %zu images (%zu failed, %.1f KiB) in %zu tasks on %u threads\n",
+         images,
+         failed,
+         fileBytes / 1024.0,
+         tasks,
+         threads);
+  printf("  wall %.3f ms, cpu %.3f ms, parallel efficiency %.0f%%\n",
+         wallSeconds * 1000.0,
+         cpuSeconds * 1000.0,
+         parallelEfficiency() * 100.0);
+}
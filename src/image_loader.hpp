@@ -0,0 +1,56 @@
+#ifndef IMAGE_LOADER_H
+#define IMAGE_LOADER_H
+
+#include "thread_pool.hpp"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Decoded image with pixels owned by stb_image
+struct Image {
+  std::string path;
+  int width = 0;
+  int height = 0;
+  // Channels stored in pixels (the requested count, or the file's own count if 0 was requested)
+  int channels = 0;
+  std::unique_ptr<unsigned char, void (*)(void *)> pixels{nullptr, nullptr};
+
+  bool loaded() const { return pixels != nullptr; }
+  size_t byteSize() const { return (size_t)width * height * channels; }
+};
+
+struct ImageBatchStats {
+  size_t images = 0;
+  size_t failed = 0;
+  size_t tasks = 0;
+  size_t fileBytes = 0;
+  unsigned threads = 0;
+  double wallSeconds = 0.0;
+  // Process CPU time spent while the batch ran, summed over all threads
+  double cpuSeconds = 0.0;
+
+  // Fraction of the pool that was kept busy, 1.0 is perfect scaling
+  double parallelEfficiency() const {
+    return wallSeconds > 0.0 && threads > 0 ? cpuSeconds / (wallSeconds * threads) : 0.0;
+  }
+  void print() const;
+};
+
+Image loadImage(const std::string &path, int desiredChannels, bool flipVertically);
+// Decode an encoded image already in memory, such as one embedded in a model file. name is only used for messages.
+Image loadImageFromMemory(
+    const std::string &name, const unsigned char *data, size_t size, int desiredChannels, bool flipVertically);
+
+// Decode every path on the pool and return the images in submission order. Small files are grouped so that each task
+// holds roughly the same number of bytes, large files get a task to themselves.
+std::vector<Image> loadImages(const std::vector<std::string> &paths,
+                              int desiredChannels,
+                              bool flipVertically,
+                              ThreadPool &pool,
+                              ImageBatchStats *stats = nullptr);
+
+// Sorted list of .png/.jpg/.jpeg/.bmp/.tga files directly inside a directory
+std::vector<std::string> listImages(const std::string &directory);
+
+#endif
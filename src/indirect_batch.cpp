@@ -0,0 +1,92 @@
+#include "indirect_batch.hpp"
+#include "gl_state.hpp"
+#include <iostream>
+
+IndirectBatch::IndirectBatch(size_t vertexCapacity, size_t indexCapacity)
+    : vertexCapacity(vertexCapacity), indexCapacity(indexCapacity) {
+  vertexBuffer = std::make_unique<Buffer>(
+      vertexCapacity * sizeof(PackedTexturedVertex), nullptr, (GLbitfield)GL_DYNAMIC_STORAGE_BIT);
+  indexBuffer = std::make_unique<Buffer>(indexCapacity * sizeof(uint32_t), nullptr, (GLbitfield)GL_DYNAMIC_STORAGE_BIT);
+
+  glCreateVertexArrays(1, &vao);
+  PackedTexturedFormat::setup(vao);
+  glState().vertexArrayVertexBuffer(vao, 0, vertexBuffer->id, 0, PackedTexturedFormat::stride);
+  glState().vertexArrayElementBuffer(vao, indexBuffer->id);
+}
+
+IndirectBatch::~IndirectBatch() {
+  glState().forgetVertexArray(vao);
+  glDeleteVertexArrays(1, &vao);
+}
+
+const char *IndirectBatch::glslInputs() {
+  static constexpr auto INPUTS = PackedTexturedFormat::glslInputs({"aPos", "aColour", "aTexCoord"});
+  return INPUTS.c_str();
+}
+
+uint32_t IndirectBatch::addMesh(const PackedTexturedVertex *vertices,
+                                size_t vertexCount,
+                                const uint32_t *indices,
+                                size_t indexCount) {
+  if (verticesUsed + vertexCount > vertexCapacity || indicesUsed + indexCount > indexCapacity) {
+    std::cout << "ERROR::INDIRECT_BATCH::OUT_OF_SPACE" << std::endl;
+    return INVALID_MESH;
+  }
+
+  glNamedBufferSubData(vertexBuffer->id,
+                       (GLintptr)(verticesUsed * sizeof(PackedTexturedVertex)),
+                       (GLsizeiptr)(vertexCount * sizeof(PackedTexturedVertex)),
+                       vertices);
+  glNamedBufferSubData(indexBuffer->id,
+                       (GLintptr)(indicesUsed * sizeof(uint32_t)),
+                       (GLsizeiptr)(indexCount * sizeof(uint32_t)),
+                       indices);
+
+  meshes.push_back({(GLuint)indicesUsed, (GLuint)indexCount, (GLint)verticesUsed});
+  verticesUsed += vertexCount;
+  indicesUsed += indexCount;
+  return (uint32_t)(meshes.size() - 1);
+}
+
+void IndirectBatch::draw(uint32_t mesh, const DrawData &data) {
+  if (mesh >= meshes.size()) {
+    return;
+  }
+  GLuint dataIndex = (GLuint)drawData.size();
+  drawData.push_back(data);
+
+  // The same mesh again right after itself becomes one more instance of the previous command
+  if (!commands.empty() && commandMeshes.back() == mesh) {
+    commands.back().instanceCount++;
+    return;
+  }
+  const MeshRange &range = meshes[mesh];
+  commands.push_back({range.indexCount, 1, range.firstIndex, range.baseVertex, dataIndex});
+  commandMeshes.push_back(mesh);
+}
+
+void IndirectBatch::submit(StreamBuffer &stream) {
+  submittedCommands = commands.size();
+  if (commands.empty()) {
+    return;
+  }
+
+  StreamAllocation commandRange =
+      stream.upload(commands.data(), commands.size() * sizeof(DrawElementsIndirectCommand), sizeof(GLuint));
+  StreamAllocation dataRange =
+      stream.upload(drawData.data(), drawData.size() * sizeof(DrawData), stream.storageAlignment);
+  if (!commandRange.valid() || !dataRange.valid()) {
+    std::cout << "ERROR::INDIRECT_BATCH::STREAM_BUFFER_FULL" << std::endl;
+  } else {
+    glState().bindVertexArray(vao);
+    glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandRange.buffer);
+    glState().bindBufferRange(
+        GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, dataRange.buffer, dataRange.offset, (GLsizeiptr)dataRange.size);
+    glMultiDrawElementsIndirect(
+        GL_TRIANGLES, GL_UNSIGNED_INT, (const void *)commandRange.offset, (GLsizei)commands.size(), 0);
+  }
+
+  commands.clear();
+  commandMeshes.clear();
+  drawData.clear();
+}
@@ -0,0 +1,88 @@
+#ifndef INDIRECT_BATCH_H
+#define INDIRECT_BATCH_H
+
+#include "buffer.hpp"
+#include "stream_buffer.hpp"
+#include "vertex_format.hpp"
+#include <glad/gl.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Layout fixed by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+  GLuint count;
+  GLuint instanceCount;
+  GLuint firstIndex;
+  GLint baseVertex;
+  GLuint baseInstance;
+};
+
+// Per-draw data read by texture_indirect.vert from a storage buffer, std430 layout
+struct DrawData {
+  // x and y offset in clip space, uniform scale, rotation in radians
+  GLfloat transform[4];
+  GLfloat tint[4];
+  // Sub-rectangle of the texture as (u0, v0, u1, v1)
+  GLfloat uvRect[4];
+  // Texture array layer
+  GLuint layer;
+  GLuint padding[3];
+};
+static_assert(sizeof(DrawData) == 64);
+
+// Packs many meshes into one shared vertex and index buffer and draws any number of them with a single
+// glMultiDrawElementsIndirect. Each draw finds its DrawData through gl_BaseInstance + gl_InstanceID, so consecutive
+// draws of the same mesh collapse into one instanced command.
+class IndirectBatch {
+public:
+  static constexpr uint32_t INVALID_MESH = UINT32_MAX;
+  static constexpr GLuint DRAW_DATA_BINDING = 0;
+
+  IndirectBatch(size_t vertexCapacity, size_t indexCapacity);
+  ~IndirectBatch();
+
+  IndirectBatch(const IndirectBatch &) = delete;
+  IndirectBatch &operator=(const IndirectBatch &) = delete;
+
+  // Vertex input declarations for texture_indirect.vert
+  static const char *glslInputs();
+
+  // Copy a mesh into the shared buffers. Indices are relative to the mesh's own vertices. Returns INVALID_MESH when
+  // the buffers are full.
+  uint32_t addMesh(const PackedTexturedVertex *vertices,
+                   size_t vertexCount,
+                   const uint32_t *indices,
+                   size_t indexCount);
+
+  // Queue a draw of a mesh for the next submit()
+  void draw(uint32_t mesh, const DrawData &data);
+  // Stream the queued commands and draw data into this frame's region and draw them all in one call
+  void submit(StreamBuffer &stream);
+
+  size_t meshCount() const { return meshes.size(); }
+  // Commands issued by the last submit(), after merging repeated meshes
+  size_t lastCommandCount() const { return submittedCommands; }
+
+private:
+  struct MeshRange {
+    GLuint firstIndex;
+    GLuint indexCount;
+    GLint baseVertex;
+  };
+
+  GLuint vao = 0;
+  std::unique_ptr<Buffer> vertexBuffer;
+  std::unique_ptr<Buffer> indexBuffer;
+  size_t vertexCapacity, indexCapacity;
+  size_t verticesUsed = 0, indicesUsed = 0;
+  std::vector<MeshRange> meshes;
+
+  std::vector<uint32_t> commandMeshes;
+  std::vector<DrawElementsIndirectCommand> commands;
+  std::vector<DrawData> drawData;
+  size_t submittedCommands = 0;
+};
+
+#endif
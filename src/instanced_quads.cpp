@@ -0,0 +1,44 @@
+#include "instanced_quads.hpp"
+#include "gl_state.hpp"
+
+// Where Mesh::bindTo() attaches the quad
+static constexpr GLuint VERTEX_BINDING = 0;
+static constexpr GLuint INSTANCE_BINDING = 1;
+
+InstancedQuads::InstancedQuads(const Mesh &quad) : quad(quad) {
+  glCreateVertexArrays(1, &vao);
+  PackedTexturedFormat::setup(vao, VERTEX_BINDING);
+  QuadInstanceFormat::setup(vao, INSTANCE_BINDING, FIRST_INSTANCE_LOCATION);
+  // Advance the instance binding once per instance rather than once per vertex
+  glVertexArrayBindingDivisor(vao, INSTANCE_BINDING, 1);
+}
+
+InstancedQuads::~InstancedQuads() {
+  glState().forgetVertexArray(vao);
+  glDeleteVertexArrays(1, &vao);
+}
+
+const char *InstancedQuads::glslInputs() {
+  static constexpr auto INPUTS =
+      PackedTexturedFormat::glslInputs({"aPos", "aColour", "aTexCoord"}) +
+      QuadInstanceFormat::glslInputs({"aTransform", "aUvRect", "aTint", "aLayer"}, FIRST_INSTANCE_LOCATION);
+  return INPUTS.c_str();
+}
+
+void InstancedQuads::setInstances(const std::vector<QuadInstance> &instances) {
+  staticInstances = std::make_unique<Buffer>(instances.size() * sizeof(QuadInstance), instances.data());
+  staticCount = (GLsizei)instances.size();
+}
+
+void InstancedQuads::draw() const {
+  if (staticInstances) {
+    draw(staticInstances->id, 0, staticCount);
+  }
+}
+
+void InstancedQuads::draw(GLuint instanceBuffer, GLintptr offset, GLsizei count) const {
+  // Arena ranges can move during defragmentation, so the quad's buffers are attached at draw time
+  GLintptr indexOffset = quad.bindTo(vao);
+  glState().vertexArrayVertexBuffer(vao, INSTANCE_BINDING, instanceBuffer, offset, QuadInstanceFormat::stride);
+  glDrawElementsInstanced(GL_TRIANGLES, quad.indexCount, quad.indexType, (const void *)indexOffset, count);
+}
@@ -0,0 +1,56 @@
+#ifndef INSTANCED_QUADS_H
+#define INSTANCED_QUADS_H
+
+#include "buffer.hpp"
+#include "mesh.hpp"
+#include "vertex_format.hpp"
+#include <glad/gl.h>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Per-instance data read once per quad instead of once per vertex, 32 bytes each
+using QuadInstanceFormat = VertexFormat<Attrib<GLfloat, 4>, Attrib<Half, 4>, Attrib<Unorm8, 4>, Attrib<GLfloat, 1>>;
+struct QuadInstance {
+  // x and y offset in clip space, uniform scale, rotation in radians
+  GLfloat transform[4];
+  // Sub-rectangle of the texture as (u0, v0, u1, v1)
+  Half uvRect[4];
+  Unorm8 tint[4];
+  // Texture array layer
+  GLfloat layer;
+};
+static_assert(sizeof(QuadInstance) == QuadInstanceFormat::stride);
+
+// Draws many copies of one quad with a single glDrawElementsInstanced. The quad mesh must use PackedTexturedFormat,
+// instance attributes follow it at locations 3 to 6. The quad's buffers are shared, not copied, and stay alive as long
+// as this does.
+class InstancedQuads {
+public:
+  static constexpr GLuint FIRST_INSTANCE_LOCATION = (GLuint)PackedTexturedFormat::attributeCount;
+
+  explicit InstancedQuads(const Mesh &quad);
+  ~InstancedQuads();
+
+  InstancedQuads(const InstancedQuads &) = delete;
+  InstancedQuads &operator=(const InstancedQuads &) = delete;
+
+  // Vertex and instance input declarations for instanced_quad.vert
+  static const char *glslInputs();
+
+  // Replace the static instance buffer, for instances that rarely change
+  void setInstances(const std::vector<QuadInstance> &instances);
+  void draw() const;
+  // Draw instances from any buffer, e.g. a StreamBuffer allocation rewritten every frame
+  void draw(GLuint instanceBuffer, GLintptr offset, GLsizei count) const;
+
+  GLsizei instanceCount() const { return staticCount; }
+
+private:
+  GLuint vao = 0;
+  Mesh quad;
+  std::unique_ptr<Buffer> staticInstances;
+  GLsizei staticCount = 0;
+};
+
+#endif
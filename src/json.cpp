@@ -0,0 +1,278 @@
+#include "json.hpp"
+#include <charconv>
+#include <cstdint>
+
+// Deep enough for any real glTF, shallow enough that hostile nesting cannot overflow the stack
+static constexpr int MAX_DEPTH = 256;
+
+static const JsonValue NULL_VALUE;
+static const std::string EMPTY_STRING;
+
+bool JsonValue::contains(std::string_view key) const { return &(*this)[key] != &NULL_VALUE; }
+
+const JsonValue &JsonValue::operator[](std::string_view key) const {
+  if (type == Type::Object) {
+    for (const auto &member : object) {
+      if (member.first == key) {
+        return member.second;
+      }
+    }
+  }
+  return NULL_VALUE;
+}
+
+const JsonValue &JsonValue::operator[](size_t index) const {
+  return type == Type::Array && index < array.size() ? array[index] : NULL_VALUE;
+}
+
+const std::string &JsonValue::asString() const { return type == Type::String ? string : EMPTY_STRING; }
+
+namespace {
+
+class JsonParser {
+public:
+  explicit JsonParser(std::string_view text) : text(text) {}
+
+  bool parseDocument(JsonValue &root) {
+    skipWhitespace();
+    if (!parseValue(root, 0)) {
+      return false;
+    }
+    skipWhitespace();
+    return position == text.size() || fail("trailing characters");
+  }
+
+  std::string error;
+
+private:
+  std::string_view text;
+  size_t position = 0;
+
+  bool fail(const char *message) {
+    if (error.empty()) {
+      error = std::string(message) + " at offset " + std::to_string(position);
+    }
+    return false;
+  }
+
+  void skipWhitespace() {
+    while (position < text.size() &&
+           (text[position] == ' ' || text[position] == '\t' || text[position] == '\n' || text[position] == '\r')) {
+      position++;
+    }
+  }
+
+  bool consume(char expected) {
+    skipWhitespace();
+    if (position < text.size() && text[position] == expected) {
+      position++;
+      return true;
+    }
+    return false;
+  }
+
+  bool literal(std::string_view word) {
+    if (text.substr(position, word.size()) != word) {
+      return fail("invalid literal");
+    }
+    position += word.size();
+    return true;
+  }
+
+  bool parseValue(JsonValue &value, int depth) {
+    if (depth > MAX_DEPTH) {
+      return fail("nesting too deep");
+    }
+    skipWhitespace();
+    if (position >= text.size()) {
+      return fail("unexpected end");
+    }
+    switch (text[position]) {
+    case '{':
+      return parseObject(value, depth);
+    case '[':
+      return parseArray(value, depth);
+    case '"':
+      value.type = JsonValue::Type::String;
+      return parseString(value.string);
+    case 't':
+      value.type = JsonValue::Type::Bool;
+      value.boolean = true;
+      return literal("true");
+    case 'f':
+      value.type = JsonValue::Type::Bool;
+      value.boolean = false;
+      return literal("false");
+    case 'n':
+      value.type = JsonValue::Type::Null;
+      return literal("null");
+    default:
+      return parseNumber(value);
+    }
+  }
+
+  bool parseObject(JsonValue &value, int depth) {
+    value.type = JsonValue::Type::Object;
+    position++;
+    if (consume('}')) {
+      return true;
+    }
+    do {
+      skipWhitespace();
+      if (position >= text.size() || text[position] != '"') {
+        return fail("expected member name");
+      }
+      value.object.emplace_back();
+      if (!parseString(value.object.back().first)) {
+        return false;
+      }
+      if (!consume(':')) {
+        return fail("expected ':'");
+      }
+      if (!parseValue(value.object.back().second, depth + 1)) {
+        return false;
+      }
+    } while (consume(','));
+    return consume('}') || fail("expected ',' or '}'");
+  }
+
+  bool parseArray(JsonValue &value, int depth) {
+    value.type = JsonValue::Type::Array;
+    position++;
+    if (consume(']')) {
+      return true;
+    }
+    do {
+      value.array.emplace_back();
+      if (!parseValue(value.array.back(), depth + 1)) {
+        return false;
+      }
+    } while (consume(','));
+    return consume(']') || fail("expected ',' or ']'");
+  }
+
+  bool parseNumber(JsonValue &value) {
+    value.type = JsonValue::Type::Number;
+    // from_chars takes no leading '+', which JSON does not allow either
+    auto result = std::from_chars(text.data() + position, text.data() + text.size(), value.number);
+    if (result.ec != std::errc()) {
+      return fail("invalid number");
+    }
+    position = result.ptr - text.data();
+    return true;
+  }
+
+  bool parseHex4(uint32_t &code) {
+    if (position + 4 > text.size()) {
+      return fail("truncated escape");
+    }
+    code = 0;
+    for (int k = 0; k < 4; k++) {
+      char c = text[position++];
+      code <<= 4;
+      if (c >= '0' && c <= '9') {
+        code |= c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        code |= c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        code |= c - 'A' + 10;
+      } else {
+        return fail("invalid escape");
+      }
+    }
+    return true;
+  }
+
+  static void appendUtf8(std::string &out, uint32_t code) {
+    if (code < 0x80) {
+      out += (char)code;
+    } else if (code < 0x800) {
+      out += (char)(0xC0 | (code >> 6));
+      out += (char)(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+      out += (char)(0xE0 | (code >> 12));
+      out += (char)(0x80 | ((code >> 6) & 0x3F));
+      out += (char)(0x80 | (code & 0x3F));
+    } else {
+      out += (char)(0xF0 | (code >> 18));
+      out += (char)(0x80 | ((code >> 12) & 0x3F));
+      out += (char)(0x80 | ((code >> 6) & 0x3F));
+      out += (char)(0x80 | (code & 0x3F));
+    }
+  }
+
+  bool parseString(std::string &out) {
+    position++;
+    while (position < text.size()) {
+      char c = text[position++];
+      if (c == '"') {
+        return true;
+      }
+      if (c != '\\') {
+        out += c;
+        continue;
+      }
+      if (position >= text.size()) {
+        break;
+      }
+      switch (text[position++]) {
+      case '"':
+        out += '"';
+        break;
+      case '\\':
+        out += '\\';
+        break;
+      case '/':
+        out += '/';
+        break;
+      case 'b':
+        out += '\b';
+        break;
+      case 'f':
+        out += '\f';
+        break;
+      case 'n':
+        out += '\n';
+        break;
+      case 'r':
+        out += '\r';
+        break;
+      case 't':
+        out += '\t';
+        break;
+      case 'u': {
+        uint32_t code;
+        if (!parseHex4(code)) {
+          return false;
+        }
+        // Characters outside the basic plane arrive as a surrogate pair
+        if (code >= 0xD800 && code < 0xDC00 && text.substr(position, 2) == "\\u") {
+          position += 2;
+          uint32_t low;
+          if (!parseHex4(low)) {
+            return false;
+          }
+          code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+        }
+        appendUtf8(out, code);
+        break;
+      }
+      default:
+        return fail("invalid escape");
+      }
+    }
+    return fail("unterminated string");
+  }
+};
+
+} // namespace
+
+bool parseJson(std::string_view text, JsonValue &root, std::string *error) {
+  JsonParser parser(text);
+  root = JsonValue();
+  bool parsed = parser.parseDocument(root);
+  if (!parsed && error != nullptr) {
+    *error = parser.error;
+  }
+  return parsed;
+}
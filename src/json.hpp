@@ -0,0 +1,43 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Parsed JSON document node. Lookups that miss return a shared null value, so optional fields can be chained without
+// checks, e.g. root["materials"][0]["name"].asString().
+class JsonValue {
+public:
+  enum class Type { Null, Bool, Number, String, Array, Object };
+
+  Type type = Type::Null;
+  bool boolean = false;
+  double number = 0.0;
+  std::string string;
+  std::vector<JsonValue> array;
+  // Members in document order, objects in the files this reads are small enough for a linear search
+  std::vector<std::pair<std::string, JsonValue>> object;
+
+  bool isNull() const { return type == Type::Null; }
+  bool isNumber() const { return type == Type::Number; }
+  bool isArray() const { return type == Type::Array; }
+  bool isObject() const { return type == Type::Object; }
+
+  size_t size() const { return type == Type::Array ? array.size() : type == Type::Object ? object.size() : 0; }
+  bool contains(std::string_view key) const;
+  const JsonValue &operator[](std::string_view key) const;
+  const JsonValue &operator[](size_t index) const;
+
+  double asNumber(double fallback = 0.0) const { return type == Type::Number ? number : fallback; }
+  long long asInt(long long fallback = 0) const { return type == Type::Number ? (long long)number : fallback; }
+  bool asBool(bool fallback = false) const { return type == Type::Bool ? boolean : fallback; }
+  const std::string &asString() const;
+};
+
+// Parse a complete document, on failure returns false and describes the first error with its byte offset
+bool parseJson(std::string_view text, JsonValue &root, std::string *error = nullptr);
+
+#endif
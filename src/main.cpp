@@ -1,22 +1,145 @@
+#include "buffer_arena.hpp"
+#include "command_buffer.hpp"
+#include "deform_cache.hpp"
+#include "draw_queue.hpp"
+#include "fixed_timestep.hpp"
+#include "frame_pacing.hpp"
+#include "gl_state.hpp"
+#include "glb_loader.hpp"
+#include "image_loader.hpp"
+#include "indirect_batch.hpp"
+#include "instanced_quads.hpp"
+#include "mesh.hpp"
+#include "mesh_codec.hpp"
+#include "mesh_optimizer.hpp"
+#include "meshlet.hpp"
+#include "obj_loader.hpp"
+#include "pipeline_state.hpp"
+#include "redraw_scheduler.hpp"
+#include "render_thread.hpp"
+#include "resource_cache.hpp"
 #include "shader.hpp"
-#include "stb_image.h"
+#include "sprite_batch.hpp"
+#include "stream_buffer.hpp"
+#include "texture_watcher.hpp"
+#include "thread_pool.hpp"
+#include "vertex_format.hpp"
+#include "vertex_pulling.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <glad/gl.h>
 #include <GLFW/glfw3.h>
 
+#include <filesystem>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
 
 #define WIDTH 800
 #define HEIGHT 600
 #define TITLE "OpenGL Test"
 
-void framebuffer_size_callback(GLFWwindow *, int width, int height);
+struct SceneOptions {
+  // Number of tiled quads drawn through the instanced path, 0 draws the single textured quad
+  size_t stressQuads = 0;
+  // Number of distinct meshes drawn through one multi-draw indirect call
+  size_t indirectMeshes = 0;
+  // Number of random sprites drawn through the sorting sprite batcher
+  size_t sprites = 0;
+  // Number of separately drawn meshes sub-allocated from one buffer arena
+  size_t arenaMeshes = 0;
+  // Number of meshes of mixed layouts drawn one call each, alternating between attribute fetch and vertex pulling
+  size_t pulledMeshes = 0;
+  // Number of meshes of mixed programs, textures and translucency drawn through the sorting draw queue
+  size_t sortedDraws = 0;
+  // Passes drawing the x offset animation of the OBJ (or the quad), as shadow, depth prepass and main passes would
+  size_t deformPasses = 0;
+  // Deform once per frame through transform feedback and let every pass reuse the result
+  bool captureDeform = false;
+  // Frames the main thread may record ahead of a separate render thread, 0 renders on the main thread
+  size_t framesAhead = 0;
+  // Animate the triangle (or OBJ) colour and x offset, the default scene draws still otherwise
+  bool animate = false;
+  // Simulation steps per second, independent of the frame rate
+  double tickRate = 60.0;
+  // Draw every iteration even when nothing changes, instead of sleeping until something does. Benchmarks always do.
+  bool continuous = false;
+  // Vsync, frame limit and frames in flight. Benchmarks run with vsync off unless --vsync says otherwise.
+  FramePacing pacing;
+  // Wavefront OBJ drawn in place of the textured quad
+  std::string objPath;
+  // Binary glTF drawn in place of the textured quad
+  std::string glbPath;
+  // Split the OBJ into meshlets and draw only those the CPU finds visible and front facing
+  bool meshlets = false;
+  // Draw the OBJ as triangle strips when they are shorter than its triangle list, not with --meshlets
+  bool strips = false;
+  // Round trip the packed OBJ through the mesh codec and draw the decoded copy
+  bool codec = false;
+  // Draw every pipeline's polygons as outlines
+  bool wireframe = false;
+
+  bool benchmark() const {
+    return stressQuads > 0 || indirectMeshes > 0 || sprites > 0 || arenaMeshes > 0 || pulledMeshes > 0 ||
+           sortedDraws > 0 || deformPasses > 0 || (meshlets && !objPath.empty());
+  }
+};
+
+// Everything the animations derive from. It only advances in fixed steps, so after N steps it is the same at any
+// frame rate, and frames draw the last two states blended.
+struct SceneAnimation {
+  uint64_t steps = 0;
+  // Simulated seconds, a whole number of steps
+  double time = 0.0;
+  // The triangle moves left and right by 20% and pulses in brightness
+  float xOffset = 0.2f;
+  float brightness = 0.5f;
+};
+
+void framebuffer_size_callback(GLFWwindow *window, int width, int height);
+void apply_framebuffer_size();
 void process_input(GLFWwindow *window);
+SceneOptions parse_options(int argc, char **argv);
+std::vector<QuadInstance> tiled_quads(size_t count);
+void codec_round_trip(std::vector<PackedTexturedVertex> &vertices, std::vector<uint32_t> &indices, ThreadPool &pool);
+void fit_to_view(std::vector<TexturedVertex> &vertices);
+float next_random(uint32_t &seed);
+void step_animation(SceneAnimation &animation, double step);
+SceneAnimation interpolate_animation(const SceneAnimation &previous, const SceneAnimation &current, float alpha);
+template <typename Vertex>
+void polygon_geometry(int sides,
+                      float x,
+                      float y,
+                      float scale,
+                      uint32_t &seed,
+                      std::vector<Vertex> &vertices,
+                      std::vector<uint32_t> &indices);
+std::vector<DrawData> polygon_meshes(IndirectBatch &batch, size_t count);
+Mesh arena_polygon(const VertexArray<PackedTexturedFormat> &vertexArray,
+                   BufferArena &arena,
+                   size_t i,
+                   size_t count,
+                   uint32_t &seed);
+void pulled_polygons(PulledMeshes &pulled,
+                     std::vector<Mesh> &attributeMeshes,
+                     BufferArena &arena,
+                     const VertexArray<TexturedFormat> &floatArray,
+                     const VertexArray<PackedTexturedFormat> &packedArray,
+                     size_t count);
+void run_scene(GLFWwindow *window, const SceneOptions &options);
 
-int main() {
+int main(int argc, char **argv) {
   std::cout << "Starting OpenGL Test" << std::endl;
+  SceneOptions options = parse_options(argc, argv);
 
   glfwInit();
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
@@ -41,10 +164,365 @@ int main() {
     std::cout << "Failed to initialise OpenGL context!" << std::endl;
     return -1;
   }
-  glEnable(GL_MULTISAMPLE);
-
   printf("Loaded OpenGL version %i.%i\n", GLAD_VERSION_MAJOR(version), GLAD_VERSION_MINOR(version));
 
+  // Scene objects own GL resources, so they live inside run_scene and are destroyed before the context
+  run_scene(window, options);
+
+  glfwTerminate();
+  std::cout << "Closed OpenGL Test application" << std::endl;
+  return 0;
+}
+
+// Latest framebuffer size as width << 32 | height, 0 until the first resize. Events arrive on the main thread while
+// the context may be current on the render thread, so the size is only stored here and applied by the GL thread.
+std::atomic<uint64_t> framebufferSize{0};
+
+void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
+  framebufferSize.store((uint64_t)(uint32_t)width << 32 | (uint32_t)height, std::memory_order_relaxed);
+  RedrawScheduler::requestRedraw(window);
+}
+
+// Call on the GL thread, the state cache drops it when the size has not changed
+void apply_framebuffer_size() {
+  uint64_t size = framebufferSize.load(std::memory_order_relaxed);
+  if (size != 0) {
+    glState().viewport(0, 0, (GLsizei)(size >> 32), (GLsizei)(size & UINT32_MAX));
+  }
+}
+
+void process_input(GLFWwindow *window) {
+  if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
+    glfwSetWindowShouldClose(window, true);
+  }
+}
+
+SceneOptions parse_options(int argc, char **argv) {
+  SceneOptions options;
+  bool vsyncChosen = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--stress") {
+      // Optional quad count, defaults to a million
+      options.stressQuads = 1000000;
+      if (i + 1 < argc && std::isdigit((unsigned char)argv[i + 1][0])) {
+        options.stressQuads = std::stoul(argv[++i]);
+      }
+    } else if (arg == "--indirect") {
+      options.indirectMeshes = 4096;
+      if (i + 1 < argc && std::isdigit((unsigned char)argv[i + 1][0])) {
+        options.indirectMeshes = std::stoul(argv[++i]);
+      }
+    } else if (arg == "--sprites") {
+      options.sprites = 20000;
+      if (i + 1 < argc && std::isdigit((unsigned char)argv[i + 1][0])) {
+        options.sprites = std::stoul(argv[++i]);
+      }
+    } else if (arg == "--meshes") {
+      options.arenaMeshes = 2000;
+      if (i + 1 < argc && std::isdigit((unsigned char)argv[i + 1][0])) {
+        options.arenaMeshes = std::stoul(argv[++i]);
+      }
+    } else if (arg == "--pulling") {
+      options.pulledMeshes = 10000;
+      if (i + 1 < argc && std::isdigit((unsigned char)argv[i + 1][0])) {
+        options.pulledMeshes = std::stoul(argv[++i]);
+      }
+    } else if (arg == "--sorted") {
+      options.sortedDraws = 5000;
+      if (i + 1 < argc && std::isdigit((unsigned char)argv[i + 1][0])) {
+        options.sortedDraws = std::stoul(argv[++i]);
+      }
+    } else if (arg == "--passes") {
+      options.deformPasses = 3;
+      if (i + 1 < argc && std::isdigit((unsigned char)argv[i + 1][0])) {
+        options.deformPasses = std::stoul(argv[++i]);
+      }
+    } else if (arg == "--capture") {
+      options.captureDeform = true;
+    } else if (arg == "--render-thread") {
+      options.framesAhead = 1;
+      if (i + 1 < argc && std::isdigit((unsigned char)argv[i + 1][0])) {
+        options.framesAhead = std::stoul(argv[++i]);
+      }
+    } else if (arg == "--vsync" && i + 1 < argc) {
+      std::string mode = argv[++i];
+      vsyncChosen = true;
+      if (mode == "off") {
+        options.pacing.vsync = VsyncMode::Off;
+      } else if (mode == "on") {
+        options.pacing.vsync = VsyncMode::On;
+      } else if (mode == "adaptive") {
+        options.pacing.vsync = VsyncMode::Adaptive;
+      } else {
+        std::cout << "Unknown vsync mode " << mode << std::endl;
+      }
+    } else if (arg == "--fps" && i + 1 < argc) {
+      options.pacing.maxFps = std::stod(argv[++i]);
+    } else if (arg == "--frames-in-flight" && i + 1 < argc) {
+      options.pacing.maxFramesInFlight = std::stoul(argv[++i]);
+    } else if (arg == "--animate") {
+      options.animate = true;
+    } else if (arg == "--tick-rate" && i + 1 < argc) {
+      options.tickRate = std::stod(argv[++i]);
+    } else if (arg == "--continuous") {
+      options.continuous = true;
+    } else if (arg == "--low-latency") {
+      options.pacing.lowLatency = true;
+    } else if (arg == "--obj" && i + 1 < argc) {
+      options.objPath = argv[++i];
+    } else if (arg == "--meshlets") {
+      options.meshlets = true;
+    } else if (arg == "--strips") {
+      options.strips = true;
+    } else if (arg == "--codec") {
+      options.codec = true;
+    } else if (arg == "--wireframe") {
+      options.wireframe = true;
+    } else if (arg == "--glb" && i + 1 < argc) {
+      options.glbPath = argv[++i];
+    } else {
+      std::cout << "Unknown option " << arg << std::endl;
+    }
+  }
+  if (!vsyncChosen && options.benchmark()) {
+    options.pacing.vsync = VsyncMode::Off;
+  }
+  return options;
+}
+
+// Cover the window with a square grid of count quads, mostly layer 0 (grass) with layer 1 (rocks) scattered through
+std::vector<QuadInstance> tiled_quads(size_t count) {
+  size_t side = (size_t)std::ceil(std::sqrt((double)count));
+  float cell = 2.0f / side;
+  std::vector<QuadInstance> instances;
+  instances.reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    size_t x = i % side, y = i / side;
+    QuadInstance instance{};
+    instance.transform[0] = -1.0f + (x + 0.5f) * cell;
+    instance.transform[1] = -1.0f + (y + 0.5f) * cell;
+    instance.transform[2] = cell;
+    instance.transform[3] = 0.0f;
+    instance.uvRect[0] = Half::fromFloat(0.0f);
+    instance.uvRect[1] = Half::fromFloat(0.0f);
+    instance.uvRect[2] = Half::fromFloat(1.0f);
+    instance.uvRect[3] = Half::fromFloat(1.0f);
+    instance.tint[0] = instance.tint[1] = instance.tint[2] = instance.tint[3] = {255};
+    instance.layer = (float)((x * 7 + y * 13) % 5 == 0);
+    instances.push_back(instance);
+  }
+  return instances;
+}
+
+// Encode both streams, then replace them with what decodes back after checking it matches. A single thread decodes
+// at about 1-1.4 GB/s. Blocks are independent and the pool-parallel decode is what reaches several GB/s, so the
+// combined rate is the one to watch.
+void codec_round_trip(std::vector<PackedTexturedVertex> &vertices, std::vector<uint32_t> &indices, ThreadPool &pool) {
+  std::vector<uint8_t> encodedVertices =
+      encodeVertices(vertices.data(), vertices.size(), codecLayout<PackedTexturedFormat>());
+  std::vector<uint8_t> encodedIndices = encodeIndices(indices.data(), indices.size());
+
+  std::vector<PackedTexturedVertex> decodedVertices(vertices.size());
+  std::vector<uint32_t> decodedIndices(indices.size());
+  auto start = std::chrono::steady_clock::now();
+  bool decoded = decodeVertices(encodedVertices.data(), encodedVertices.size(), decodedVertices.data(), &pool);
+  auto middle = std::chrono::steady_clock::now();
+  decoded = decodeIndices(encodedIndices.data(), encodedIndices.size(), decodedIndices.data(), &pool) && decoded;
+  auto end = std::chrono::steady_clock::now();
+  if (!decoded) {
+    std::cout << "ERROR::MESH_CODEC::DECODE_FAILED" << std::endl;
+    return;
+  }
+  // The codec promises a lossless round trip, keep the originals if it did not deliver
+  if (std::memcmp(decodedVertices.data(), vertices.data(), vertices.size() * sizeof(PackedTexturedVertex)) != 0 ||
+      std::memcmp(decodedIndices.data(), indices.data(), indices.size() * sizeof(uint32_t)) != 0) {
+    std::cout << "ERROR::MESH_CODEC::ROUND_TRIP_MISMATCH" << std::endl;
+    return;
+  }
+
+  MeshCodecStats vertexStats{vertices.size() * sizeof(PackedTexturedVertex),
+                             encodedVertices.size(),
+                             std::chrono::duration<double>(middle - start).count()};
+  MeshCodecStats indexStats{
+      indices.size() * sizeof(uint32_t), encodedIndices.size(), std::chrono::duration<double>(end - middle).count()};
+  MeshCodecStats totalStats{vertexStats.rawBytes + indexStats.rawBytes,
+                            vertexStats.encodedBytes + indexStats.encodedBytes,
+                            vertexStats.decodeSeconds + indexStats.decodeSeconds};
+  vertexStats.print("vertices");
+  indexStats.print("indices");
+  printf("Mesh codec: %.2f GB/s combined on %u workers\n", totalStats.gigabytesPerSecond(), pool.size());
+  vertices = std::move(decodedVertices);
+  indices = std::move(decodedIndices);
+}
+
+// Scale and centre positions uniformly into [-0.9, 0.9], which the packed layout's normalised positions can hold
+void fit_to_view(std::vector<TexturedVertex> &vertices) {
+  if (vertices.empty()) {
+    return;
+  }
+  float low[3], high[3];
+  std::copy(vertices[0].position, vertices[0].position + 3, low);
+  std::copy(vertices[0].position, vertices[0].position + 3, high);
+  for (const TexturedVertex &vertex : vertices) {
+    for (int k = 0; k < 3; k++) {
+      low[k] = std::min(low[k], vertex.position[k]);
+      high[k] = std::max(high[k], vertex.position[k]);
+    }
+  }
+  float extent = std::max({high[0] - low[0], high[1] - low[1], high[2] - low[2]});
+  float scale = extent > 0.0f ? 1.8f / extent : 1.0f;
+  for (TexturedVertex &vertex : vertices) {
+    for (int k = 0; k < 3; k++) {
+      vertex.position[k] = (vertex.position[k] - (low[k] + high[k]) * 0.5f) * scale;
+    }
+  }
+}
+
+// Time is a multiple of the step rather than a running sum, so it does not drift however many steps are taken
+void step_animation(SceneAnimation &animation, double step) {
+  animation.steps++;
+  animation.time = animation.steps * step;
+  animation.xOffset = 0.2f * (float)std::cos(animation.time * 2.0);
+  animation.brightness = (float)std::sin(animation.time * 2.0) + 0.5f;
+}
+
+SceneAnimation interpolate_animation(const SceneAnimation &previous, const SceneAnimation &current, float alpha) {
+  SceneAnimation blended = current;
+  blended.time = previous.time + (current.time - previous.time) * alpha;
+  blended.xOffset = previous.xOffset + (current.xOffset - previous.xOffset) * alpha;
+  blended.brightness = previous.brightness + (current.brightness - previous.brightness) * alpha;
+  return blended;
+}
+
+// Small deterministic generator for benchmark content, returns values in [0, 1)
+float next_random(uint32_t &seed) {
+  seed = seed * 1664525u + 1013904223u;
+  return (seed >> 8) / 16777216.0f;
+}
+
+// Triangle fan polygon with jittered radii centred on (x, y). Radii stay below scale / 2 so neighbouring grid cells do
+// not overlap.
+template <typename Vertex>
+void polygon_geometry(int sides,
+                      float x,
+                      float y,
+                      float scale,
+                      uint32_t &seed,
+                      std::vector<Vertex> &vertices,
+                      std::vector<uint32_t> &indices) {
+  auto emit = [&](const TexturedVertex &vertex) {
+    if constexpr (std::is_same_v<Vertex, TexturedVertex>) {
+      vertices.push_back(vertex);
+    } else {
+      vertices.push_back(Vertex::pack(vertex));
+    }
+  };
+  vertices.clear();
+  indices.clear();
+  emit({{x, y, 0.0f}, {1.0f, 1.0f, 1.0f}, {0.5f, 0.5f}});
+  for (int k = 0; k < sides; k++) {
+    float angle = 2.0f * (float)M_PI * k / sides;
+    float radius = 0.35f + 0.15f * next_random(seed);
+    float localX = radius * std::cos(angle), localY = radius * std::sin(angle);
+    TexturedVertex vertex = {{x + localX * scale, y + localY * scale, 0.0f},
+                             {0.8f + 0.2f * next_random(seed), 0.9f, 1.0f},
+                             {localX + 0.5f, localY + 0.5f}};
+    emit(vertex);
+    indices.insert(indices.end(), {0u, (uint32_t)(1 + k), (uint32_t)(1 + (k + 1) % sides)});
+  }
+}
+
+// Add count distinct polygons of 3 to 12 sides to the batch, and one draw for each laid out in a grid
+std::vector<DrawData> polygon_meshes(IndirectBatch &batch, size_t count) {
+  size_t side = (size_t)std::ceil(std::sqrt((double)count));
+  float cell = 2.0f / side;
+  std::vector<DrawData> draws;
+  std::vector<PackedTexturedVertex> vertices;
+  std::vector<uint32_t> indices;
+  uint32_t seed = 12345;
+
+  for (size_t i = 0; i < count; i++) {
+    polygon_geometry(3 + (int)(i % 10), 0.0f, 0.0f, 1.0f, seed, vertices, indices);
+    uint32_t mesh = batch.addMesh(vertices.data(), vertices.size(), indices.data(), indices.size());
+    if (mesh == IndirectBatch::INVALID_MESH) {
+      break;
+    }
+
+    size_t x = i % side, y = i / side;
+    DrawData draw{};
+    draw.transform[0] = -1.0f + (x + 0.5f) * cell;
+    draw.transform[1] = -1.0f + (y + 0.5f) * cell;
+    draw.transform[2] = cell;
+    draw.tint[0] = draw.tint[1] = draw.tint[2] = draw.tint[3] = 1.0f;
+    draw.uvRect[2] = draw.uvRect[3] = 1.0f;
+    draw.layer = (GLuint)(i % 2);
+    draws.push_back(draw);
+  }
+  return draws;
+}
+
+// Build the mesh for grid cell i of a count-cell grid with its vertices and indices in the arena
+Mesh arena_polygon(const VertexArray<PackedTexturedFormat> &vertexArray,
+                   BufferArena &arena,
+                   size_t i,
+                   size_t count,
+                   uint32_t &seed) {
+  size_t side = (size_t)std::ceil(std::sqrt((double)count));
+  float cell = 2.0f / side;
+  std::vector<PackedTexturedVertex> vertices;
+  std::vector<uint32_t> indices;
+  int sides = 3 + (int)(next_random(seed) * 10);
+  polygon_geometry(
+      sides, -1.0f + (i % side + 0.5f) * cell, -1.0f + (i / side + 0.5f) * cell, cell, seed, vertices, indices);
+  return Mesh(vertexArray, arena, vertices.data(), vertices.size(), indices.data(), indices.size());
+}
+
+// Build count polygons in a grid, alternating the float and packed layouts. Each goes both into the pulled meshes and
+// into an arena mesh on its layout's vertex array, so the two vertex paths draw the same geometry.
+void pulled_polygons(PulledMeshes &pulled,
+                     std::vector<Mesh> &attributeMeshes,
+                     BufferArena &arena,
+                     const VertexArray<TexturedFormat> &floatArray,
+                     const VertexArray<PackedTexturedFormat> &packedArray,
+                     size_t count) {
+  size_t side = (size_t)std::ceil(std::sqrt((double)count));
+  float cell = 2.0f / side;
+  std::vector<TexturedVertex> floatVertices;
+  std::vector<PackedTexturedVertex> packedVertices;
+  std::vector<uint32_t> indices;
+  uint32_t seed = 13579;
+
+  for (size_t i = 0; i < count; i++) {
+    float x = -1.0f + (i % side + 0.5f) * cell, y = -1.0f + (i / side + 0.5f) * cell;
+    int sides = 3 + (int)(i % 10);
+    uint32_t mesh;
+    if (i % 2 == 0) {
+      polygon_geometry(sides, x, y, cell, seed, floatVertices, indices);
+      mesh = pulled.addMesh<TexturedFormat>(floatVertices.data(), floatVertices.size(), indices.data(), indices.size());
+      attributeMeshes.emplace_back(
+          floatArray, arena, floatVertices.data(), floatVertices.size(), indices.data(), indices.size());
+    } else {
+      polygon_geometry(sides, x, y, cell, seed, packedVertices, indices);
+      mesh = pulled.addMesh<PackedTexturedFormat>(
+          packedVertices.data(), packedVertices.size(), indices.data(), indices.size());
+      attributeMeshes.emplace_back(
+          packedArray, arena, packedVertices.data(), packedVertices.size(), indices.data(), indices.size());
+    }
+    if (mesh == PulledMeshes::INVALID_MESH) {
+      attributeMeshes.pop_back();
+      break;
+    }
+  }
+}
+
+void run_scene(GLFWwindow *window, const SceneOptions &options) {
+  // Benchmarks redraw continuously, everything else only when input, a resize or an asset update changes the frame.
+  // Declared first, background threads below may request redraws until they are destroyed.
+  RedrawScheduler redraw(!options.continuous && !options.benchmark());
+  redraw.watchInput(window);
+  redraw.setAnimating(options.animate);
+
   // Initialise shaders
   // ------------------
   Shader shader1("data/shader/shader1.vert", "data/shader/shader1.frag");
@@ -53,21 +531,50 @@ int main() {
   Shader xOffsetShader("data/shader/xoffset_shader.vert", "data/shader/shader1.frag");
   Shader cVerticesShader("data/shader/cvertices.vert", "data/shader/rainbow_v.frag");
   Shader textureShader("data/shader/texture.vert", "data/shader/texture.frag");
+  static constexpr auto packedInputs = PackedTexturedFormat::glslInputs({"aPos", "aColour", "aTexCoord"});
+  Shader packedTextureShader("data/shader/texture_packed.vert", "data/shader/texture.frag", packedInputs.c_str());
+  Shader pulledShader("data/shader/texture_pulled.vert", "data/shader/texture.frag");
+  Shader xOffsetCapture = Shader::capture("data/shader/xoffset_shader.vert", {"gl_Position"});
+  Shader capturedShader("data/shader/captured.vert", "data/shader/shader1.frag");
 
   // Set current shader
-  Shader currentShader = textureShader;
+  Shader currentShader = packedTextureShader;
+
+  // Every draw binds a pipeline, its program together with the fixed-function state the scene shares
+  PipelineCache pipelines;
+  PipelineDesc sceneState;
+  sceneState.raster.polygonMode = options.wireframe ? GL_LINE : GL_FILL;
+  auto pipelineFor = [&](const Shader &shader, GLuint vertexArray = 0, bool blend = false) {
+    PipelineDesc desc = sceneState;
+    desc.program = shader.id;
+    desc.vertexArray = vertexArray;
+    if (blend) {
+      desc.blend = BlendState{true, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA};
+    }
+    return pipelines.get(desc);
+  };
+  const PipelineState *currentPipeline = pipelineFor(currentShader);
+  const PipelineState *texturePipeline = pipelineFor(textureShader);
+  const PipelineState *pulledPipeline = pipelineFor(pulledShader);
+  const PipelineState *xOffsetPipeline = pipelineFor(xOffsetShader);
+  const PipelineState *capturedPipeline = pipelineFor(capturedShader);
+  // The meshlet culler drops clusters that face away, which leaves the image unchanged only when back faces are culled
+  PipelineDesc meshletDesc = currentPipeline->desc();
+  meshletDesc.raster.cull = true;
+  meshletDesc.raster.cullFace = GL_BACK;
+  const PipelineState *meshletPipeline = pipelines.get(meshletDesc);
 
   // Setup vertex data and buffers, and configure vertex attributes
   // --------------------------------------------------------------
   // clang-format off
-  GLfloat vertices[] = {
-    // positions         // colours           // texture coords
-     0.5f,  0.5f, 0.0f,  1.0f, 0.65f, 0.95f,    1.0f, 1.0f,         // top right
-     0.5f, -0.5f, 0.0f,  0.9f, 0.9f, 0.9f,  1.0f, 0.0f,         // bottom right
-    -0.5f, -0.5f, 0.0f,  0.9f, 0.8f, 1.0f,    0.0f, 0.0f,         // bottom left
-    -0.5f,  0.5f, 0.0f,  1.0f, 1.0f, 0.8f,   0.0f, 1.0f,         // top left   
+  TexturedVertex vertices[] = {
+    // positions            // colours               // texture coords
+    {{ 0.5f,  0.5f, 0.0f}, {1.0f, 0.65f, 0.95f},  {1.0f, 1.0f}},         // top right
+    {{ 0.5f, -0.5f, 0.0f}, {0.9f, 0.9f, 0.9f},    {1.0f, 0.0f}},         // bottom right
+    {{-0.5f, -0.5f, 0.0f}, {0.9f, 0.8f, 1.0f},    {0.0f, 0.0f}},         // bottom left
+    {{-0.5f,  0.5f, 0.0f}, {1.0f, 1.0f, 0.8f},    {0.0f, 1.0f}},         // top left
   };
-  GLuint indices[] = {
+  uint32_t indices[] = {
     0, 1, 3, // first triangle
     1, 2, 3, // second triangle
   };
@@ -79,104 +586,572 @@ int main() {
   // };  
   // clang-format on 
 
-  GLuint VBO, VAO, EBO;
-  glGenBuffers(1, &VBO);
-  glGenBuffers(1, &EBO);
-  glGenVertexArrays(1, &VAO);
-
-  // Bind vertex array first
-  glBindVertexArray(VAO);
-  // Bind and set vertex buffer
-  glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-  // // Bind and set element buffer
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-  // Set vertex attributes
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (void*)0);
-  glEnableVertexAttribArray(0);
-  // Set colour of each vertex using rainbow_v shaders
-  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (void*)(3 * sizeof(GLfloat)));
-  glEnableVertexAttribArray(1);
-  // Set texture coords of each vertex using texture shaders
-  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (void*)(6 * sizeof(GLfloat)));
-  glEnableVertexAttribArray(2);
-
-  // Unbind vertex objects (not necessary) *unbind VAO and VBO first before unbinding EBO 
-  // glBindVertexArray(0);
-  // glBindBuffer(GL_ARRAY_BUFFER, 0);
-  // glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-  
+  // Quantize to the packed layout, which halves the vertex size
+  std::vector<PackedTexturedVertex> packedVertices;
+  for (const TexturedVertex &vertex : vertices) {
+    packedVertices.push_back(PackedTexturedVertex::pack(vertex));
+  }
+
+  // Buffers come from the content addressed cache, so identical geometry shares one GL buffer. Every mesh in the
+  // packed layout shares one vertex array.
+  ResourceCache resources;
+  VertexArray<PackedTexturedFormat> packedVertexArray;
+  Mesh quad = Mesh::withSmallestIndices(
+      packedVertexArray, packedVertices.data(), packedVertices.size(), indices, std::size(indices), &resources);
+
   // Setup textures
   // --------------
-  GLuint texture;
-  glGenTextures(1, &texture);
-  glBindTexture(GL_TEXTURE_2D, texture);
-
-  // Set texture wrapping and filtering methods
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-  // Load and generate texture
-  int texWidth, texHeight, nChannels;
-  stbi_set_flip_vertically_on_load(true);
-  unsigned char *data = stbi_load("assets/grass.png", &texWidth, &texHeight, &nChannels, 3);
-  if (data) {
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, texWidth, texHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
-  } else {
+  // Decode every image in the assets directory on the worker pool
+  ThreadPool workers;
+  ImageBatchStats decodeStats;
+  std::vector<Image> images = loadImages(listImages("assets"), 3, true, workers, &decodeStats);
+  decodeStats.print();
+
+  // Every asset is hot reloaded in place, so each gets a texture of its own rather than one shared through the cache,
+  // where an edit would also change byte-identical images from other files
+  TextureWatcher textureWatcher(3, true);
+  textureWatcher.onPending([&redraw]() { redraw.requestRedraw(); });
+  std::vector<std::shared_ptr<Texture>> textures;
+  std::shared_ptr<Texture> texture;
+  for (const Image &image : images) {
+    if (!image.loaded()) {
+      continue;
+    }
+    textures.push_back(std::make_shared<Texture>(image));
+    textureWatcher.watch(image.path, image, textures.back());
+    if (std::filesystem::path(image.path).filename() == "grass.png") {
+      texture = textures.back();
+    }
+  }
+  if (!texture) {
     std::cout << "Failed to load texture!" << std::endl;
   }
-  stbi_image_free(data);
+  // Images added to the directory later become textures too, on the GL thread
+  textureWatcher.onAdded([&](const Image &image) {
+    textures.push_back(std::make_shared<Texture>(image));
+    textureWatcher.watch(image.path, image, textures.back());
+    printf("Loaded new texture %s\n", image.path.c_str());
+  });
+
+  // Load an OBJ on the same pool, then reorder it for the vertex cache before packing it
+  std::unique_ptr<Mesh> objMesh;
+  std::unique_ptr<MeshletCuller> meshletCuller;
+  if (!options.objPath.empty()) {
+    ObjLoadStats objStats;
+    ObjMesh obj = loadObj(options.objPath, workers, &objStats);
+    objStats.print();
+    if (obj.loaded()) {
+      // Meshlets are ranges of the triangle list
+      MeshOptimizationReport optimized = optimizeMesh(obj.vertices, obj.indices, options.strips && !options.meshlets);
+      optimized.print(options.objPath.c_str());
+      fit_to_view(obj.vertices);
+      if (options.meshlets) {
+        std::vector<Meshlet> meshlets =
+            buildMeshlets(obj.indices, obj.vertices[0].position, sizeof(TexturedVertex), obj.vertices.size());
+        meshletCuller = std::make_unique<MeshletCuller>(meshlets);
+        printf("Split %s into %zu meshlets\n", options.objPath.c_str(), meshlets.size());
+      }
+      std::vector<PackedTexturedVertex> packed;
+      packed.reserve(obj.vertices.size());
+      for (const TexturedVertex &vertex : obj.vertices) {
+        packed.push_back(PackedTexturedVertex::pack(vertex));
+      }
+      if (options.codec) {
+        codec_round_trip(packed, obj.indices, workers);
+      }
+      objMesh = std::make_unique<Mesh>(Mesh::withSmallestIndices(
+          packedVertexArray, packed.data(), packed.size(), obj.indices.data(), obj.indices.size(), &resources));
+      if (optimized.strips) {
+        objMesh->mode = GL_TRIANGLE_STRIP;
+      }
+    }
+  }
+
+  // Load a GLB with its vertex data uploaded straight from the file, and its images through the texture cache
+  std::unique_ptr<GlbModel> glbModel;
+  std::vector<std::shared_ptr<Texture>> glbTextures;
+  if (!options.glbPath.empty()) {
+    GlbLoadStats glbStats;
+    glbModel = loadGlb(options.glbPath, workers, &glbStats);
+    glbStats.print();
+    for (const Image &image : glbModel->images) {
+      glbTextures.push_back(image.loaded() ? resources.texture(image) : nullptr);
+    }
+    float extent = 0.0f;
+    for (int k = 0; k < 3; k++) {
+      extent = std::max(extent, glbModel->boundsMax[k] - glbModel->boundsMin[k]);
+    }
+    textureShader.use();
+    textureShader.setUniform1f("texCoordScale", 1.0f);
+    textureShader.setUniform4f("modelFit",
+                               (glbModel->boundsMin[0] + glbModel->boundsMax[0]) * 0.5f,
+                               (glbModel->boundsMin[1] + glbModel->boundsMax[1]) * 0.5f,
+                               (glbModel->boundsMin[2] + glbModel->boundsMax[2]) * 0.5f,
+                               extent > 0.0f ? 1.8f / extent : 1.0f);
+  }
+  resources.stats().print();
+
+  // Benchmarks: grass and rocks tiles as layers of one texture array
+  // ----------------------------------------------------------------
+  std::shared_ptr<TextureArray> tileTextures;
+  if (options.benchmark()) {
+    std::vector<const Image *> tiles;
+    for (const char *name : {"grass.png", "rocks.png"}) {
+      auto tile = std::find_if(images.begin(), images.end(), [&](const Image &image) {
+        return image.loaded() && std::filesystem::path(image.path).filename() == name;
+      });
+      if (tile != images.end()) {
+        tiles.push_back(&*tile);
+      }
+    }
+    tileTextures = std::make_shared<TextureArray>(tiles);
+    for (size_t layer = 0; layer < tiles.size(); layer++) {
+      textureWatcher.watch(tiles[layer]->path, *tiles[layer], tileTextures, (GLsizei)layer);
+    }
+  }
+  textureWatcher.watchDirectory("assets");
+
+  // Stress test: draw a grid of tiles with one instanced draw
+  Shader instancedShader(
+      "data/shader/instanced_quad.vert", "data/shader/instanced_quad.frag", InstancedQuads::glslInputs());
+  std::unique_ptr<InstancedQuads> instancedQuads;
+  const PipelineState *instancedPipeline = pipelineFor(instancedShader);
+  if (options.stressQuads > 0) {
+    instancedQuads = std::make_unique<InstancedQuads>(quad);
+    instancedQuads->setInstances(tiled_quads(options.stressQuads));
+    printf("Stress test drawing %zu instanced quads\n", options.stressQuads);
+  }
+
+  // Indirect test: draw thousands of distinct meshes with one multi-draw call
+  Shader indirectShader(
+      "data/shader/texture_indirect.vert", "data/shader/instanced_quad.frag", IndirectBatch::glslInputs());
+  const PipelineState *indirectPipeline = pipelineFor(indirectShader);
+  std::unique_ptr<IndirectBatch> indirectBatch;
+  std::vector<DrawData> indirectDraws;
+  if (options.indirectMeshes > 0) {
+    indirectBatch = std::make_unique<IndirectBatch>(options.indirectMeshes * 13, options.indirectMeshes * 36);
+    indirectDraws = polygon_meshes(*indirectBatch, options.indirectMeshes);
+    printf("Indirect test drawing %zu meshes\n", indirectBatch->meshCount());
+  }
+
+  // Sprite test: random sprites over every loaded texture, sorted into as few draws as possible
+  std::unique_ptr<SpriteBatch> spriteBatch;
+  std::vector<Sprite> sprites;
+  if (options.sprites > 0 && !textures.empty()) {
+    spriteBatch = std::make_unique<SpriteBatch>();
+    textureShader.use();
+    textureShader.setUniform1f("texCoordScale", 1.0f);
+    uint32_t seed = 67890;
+    for (size_t i = 0; i < options.sprites; i++) {
+      Sprite sprite;
+      sprite.shader = &textureShader;
+      sprite.texture = textures[i % textures.size()].get();
+      sprite.position[0] = next_random(seed) * 2.0f - 1.0f;
+      sprite.position[1] = next_random(seed) * 2.0f - 1.0f;
+      sprite.size[0] = sprite.size[1] = 0.02f + 0.06f * next_random(seed);
+      sprite.colour[1] = 0.7f + 0.3f * next_random(seed);
+      sprite.layer = (uint8_t)(next_random(seed) * 4);
+      sprite.depth = next_random(seed);
+      sprites.push_back(sprite);
+    }
+    printf("Sprite test drawing %zu sprites\n", sprites.size());
+  }
+
+  // Arena test: many meshes with one draw each, all sharing a few large buffers. A few meshes are rebuilt every frame
+  // to fragment the arena, and a small defragmentation budget keeps it compact.
+  std::unique_ptr<BufferArena> meshArena;
+  std::vector<Mesh> arenaMeshes;
+  const PipelineState *arenaPipeline = pipelineFor(packedTextureShader, packedVertexArray.id);
+  uint32_t arenaSeed = 24680;
+  if (options.arenaMeshes > 0) {
+    meshArena = std::make_unique<BufferArena>(256 * 1024);
+    for (size_t i = 0; i < options.arenaMeshes; i++) {
+      arenaMeshes.push_back(arena_polygon(packedVertexArray, *meshArena, i, options.arenaMeshes, arenaSeed));
+    }
+    printf("Arena test drawing %zu meshes\n", arenaMeshes.size());
+    meshArena->stats().print();
+  }
+
+  // Vertex pulling test: the same mixed-layout meshes drawn one call each through their vertex arrays, through the
+  // pulling shader, and through the pulling shader with one indirect call. The path changes with every report.
+  std::unique_ptr<PulledMeshes> pulledMeshes;
+  std::unique_ptr<BufferArena> attributeArena;
+  std::unique_ptr<VertexArray<TexturedFormat>> floatVertexArray;
+  std::vector<Mesh> attributeMeshes;
+  // Both layouts read the same vec3, vec3, vec2 inputs, so one program serves either vertex array
+  const PipelineState *attributePipeline = pipelineFor(packedTextureShader);
+  const char *const vertexPaths[] = {"attributes", "pulling", "pulling, one indirect draw"};
+  size_t vertexPath = 0;
+  if (options.pulledMeshes > 0) {
+    pulledMeshes = std::make_unique<PulledMeshes>(
+        options.pulledMeshes * 13 * sizeof(TexturedVertex), options.pulledMeshes * 36, options.pulledMeshes);
+    attributeArena = std::make_unique<BufferArena>(256 * 1024);
+    floatVertexArray = std::make_unique<VertexArray<TexturedFormat>>();
+    pulled_polygons(
+        *pulledMeshes, attributeMeshes, *attributeArena, *floatVertexArray, packedVertexArray, options.pulledMeshes);
+    printf("Vertex pulling test drawing %zu meshes\n", pulledMeshes->meshCount());
+  }
+
+  // Draw sorting test: meshes with scattered materials, recorded in key order and in submission order on alternate
+  // reports. Depths drift every frame, so the order has to be sorted again every frame.
+  std::unique_ptr<BufferArena> sortedArena;
+  std::vector<Mesh> sortedMeshes;
+  std::vector<DrawItem> sortedItems;
+  DrawQueue drawQueue;
+  bool sortDraws = true;
+  if (options.sortedDraws > 0) {
+    const PipelineState *materials[] = {
+        pipelineFor(packedTextureShader, packedVertexArray.id),
+        pipelineFor(textureShader, packedVertexArray.id),
+        pipelineFor(packedTextureShader, packedVertexArray.id, true),
+        pipelineFor(textureShader, packedVertexArray.id, true),
+    };
+    sortedArena = std::make_unique<BufferArena>(256 * 1024);
+    uint32_t seed = 13579;
+    for (size_t i = 0; i < options.sortedDraws; i++) {
+      sortedMeshes.push_back(arena_polygon(packedVertexArray, *sortedArena, i, options.sortedDraws, seed));
+    }
+    for (const Mesh &mesh : sortedMeshes) {
+      DrawItem item;
+      item.mesh = &mesh;
+      size_t program = next_random(seed) < 0.5f;
+      // One in five translucent
+      size_t blend = next_random(seed) < 0.2f;
+      item.pipeline = materials[program + 2 * blend];
+      if (!textures.empty()) {
+        item.texture = textures[std::min((size_t)(next_random(seed) * textures.size()), textures.size() - 1)].get();
+      }
+      item.depth = next_random(seed);
+      sortedItems.push_back(item);
+    }
+    printf("Draw sorting test drawing %zu meshes\n", sortedItems.size());
+  }
 
-  // Enable/disable wireframe mode
-  glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+  // Multi-pass test: every pass draws the same deformed mesh, either deforming it again or from the deform cache
+  const Mesh &deformedMesh = objMesh ? *objMesh : quad;
+  std::unique_ptr<DeformCache> deformCache;
+  if (options.deformPasses > 0 && options.captureDeform) {
+    deformCache = std::make_unique<DeformCache>(deformedMesh.vertexCount);
+  }
+
+  // Per-frame vertices and draw data for the benchmarks that stream
+  std::unique_ptr<StreamBuffer> frameStream;
+  if (indirectBatch || spriteBatch || meshletCuller) {
+    size_t meshletBytes = meshletCuller ? meshletCuller->size() * sizeof(DrawElementsIndirectCommand) : 0;
+    frameStream = std::make_unique<StreamBuffer>(indirectDraws.size() * (sizeof(DrawData) + 32) +
+                                                 sprites.size() * 4 * sizeof(TexturedVertex) + meshletBytes + 4096);
+  }
+  // The scene draws positions as clip space, so the view is the clip cube looking down -z
+  const float viewMin[3] = {-1.0f, -1.0f, -1.0f}, viewMax[3] = {1.0f, 1.0f, 1.0f};
+  CullView meshletView = CullView::orthographicBox(viewMin, viewMax);
+  MeshletCullStats meshletStats;
+  // Recording side on this thread, replay side on the GL thread
+  CommandStats commandStats, replayStats;
+  std::chrono::steady_clock::time_point replayStart;
+  double statsStart = glfwGetTime();
+  size_t statsFrames = 0;
+  // Count state changes from the first frame on, not the loading before it
+  glState().takeStats();
+
+  // Frames are recorded here and executed on the GL thread, which is this one unless --render-thread moves the
+  // context to a thread of its own. Declared last so it finishes its queued frames before the scene is destroyed.
+  FrameCommands serialFrame;
+  // Declared before the render thread, its fences are deleted once the context is back on this thread
+  FramePacer pacer(options.pacing);
+  printf("Vsync %s", vsyncModeName(pacer.settings().vsync));
+  if (options.pacing.maxFps > 0.0) {
+    printf(", limited to %.1f fps", options.pacing.maxFps);
+  }
+  if (options.pacing.lowLatency) {
+    printf(", low latency");
+  } else if (options.pacing.maxFramesInFlight > 0) {
+    printf(", up to %zu frames in flight", options.pacing.maxFramesInFlight);
+  }
+  printf("\n");
+  std::unique_ptr<RenderThread> renderThread;
+  if (options.framesAhead > 0) {
+    renderThread = std::make_unique<RenderThread>(window, options.framesAhead);
+    printf("Rendering on a separate thread, up to %zu frames behind input\n", options.framesAhead);
+  }
+
+  if (redraw.isOnDemand()) {
+    printf("Drawing on demand, --continuous draws every frame\n");
+  }
+  FixedTimestep timestep(1.0 / std::max(options.tickRate, 1.0));
+  SceneAnimation animation, previousAnimation;
 
   // Render loop
   while (!glfwWindowShouldClose(window)) {
-    // Input
+    // Sleep until there is something to draw, then sample input as late as pacing allows
+    redraw.waitForFrame(window);
+    if (glfwWindowShouldClose(window)) {
+      break;
+    }
+    pacer.beginFrame();
+    glfwPollEvents();
     process_input(window);
 
-    // Render logic
-    // ------------
-    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+    // Simulate in fixed steps, then draw the last two states blended by how far real time is into the next step
+    for (size_t steps = timestep.advance(glfwGetTime()); steps > 0; steps--) {
+      previousAnimation = animation;
+      step_animation(animation, timestep.step());
+    }
+    SceneAnimation shown = interpolate_animation(previousAnimation, animation, timestep.alpha());
+    float time = (float)shown.time;
 
-    // Bind texture to texture shader 
-    // ------------
-    glBindTexture(GL_TEXTURE_2D, texture);
+    FrameCommands &frame = renderThread ? renderThread->beginFrame() : serialFrame;
 
-    currentShader.use();
+    frame.record([&]() {
+      // Pick up edited textures and window resizes
+      textureWatcher.applyPending();
+      apply_framebuffer_size();
 
-    // Animate triangle colour
-    // float time = glfwGetTime();
-    // float triangleRGBA = std::sin(time * 2.0f) + 0.5f;
-    // currentShader.setUniform4f("vertexColour", 0.0f, triangleRGBA * 0.2f, triangleRGBA, 1.0f);
+      // Render logic
+      // ------------
+      glState().clearColor(0.2f, 0.3f, 0.3f, 1.0f);
+      glClear(GL_COLOR_BUFFER_BIT);
+    });
 
-    // // X offset Shader: Move vertices to the left then to the right by 20%
-    // float xOffset = 0.2f * std::cos(time * 2.0f);
-    // currentShader.setUniform1f("xOffset", xOffset);
+    if (options.stressQuads > 0) {
+      // Every tile in one instanced draw
+      frame.record([&]() {
+        tileTextures->bind();
+        glState().bindPipeline(instancedPipeline);
+        instancedQuads->draw();
+      });
+    } else if (indirectBatch) {
+      // Spin each mesh at its own speed, so the per-draw data really changes every frame
+      std::vector<DrawData> draws = indirectDraws;
+      for (size_t i = 0; i < draws.size(); i++) {
+        draws[i].transform[3] = time * (0.5f + 0.1f * (i % 7));
+      }
+      frame.record([&, draws = std::move(draws)]() {
+        frameStream->beginFrame();
+        for (size_t i = 0; i < draws.size(); i++) {
+          indirectBatch->draw((uint32_t)i, draws[i]);
+        }
+        tileTextures->bind();
+        glState().bindPipeline(indirectPipeline);
+        indirectBatch->submit(*frameStream);
+        frameStream->endFrame();
+      });
+    } else if (spriteBatch) {
+      std::vector<Sprite> frameSprites = sprites;
+      for (Sprite &sprite : frameSprites) {
+        sprite.rotation = time * (sprite.depth - 0.5f);
+      }
+      frame.record([&, frameSprites = std::move(frameSprites)]() {
+        frameStream->beginFrame();
+        for (const Sprite &sprite : frameSprites) {
+          spriteBatch->submit(sprite);
+        }
+        spriteBatch->flush(*frameStream);
+        frameStream->endFrame();
+      });
+    } else if (pulledMeshes) {
+      frame.record([&]() {
+        if (texture) {
+          texture->bind();
+        }
+      });
+      if (vertexPath == 2) {
+        frame.record([&]() {
+          glState().bindPipeline(pulledPipeline);
+          pulledMeshes->drawAll();
+        });
+      } else {
+        // One draw per mesh, recorded by the workers, each into its own slice, and replayed in slice order
+        frame.record([&]() { replayStart = std::chrono::steady_clock::now(); });
+        auto recordStart = std::chrono::steady_clock::now();
+        std::vector<CommandBuffer> &buffers = frame.recordBuffers(workers.size());
+        size_t meshCount = vertexPath == 0 ? attributeMeshes.size() : pulledMeshes->meshCount();
+        recordParallel(workers, buffers, [&, path = vertexPath](size_t job, CommandBuffer &commands) {
+          size_t first = meshCount * job / buffers.size(), last = meshCount * (job + 1) / buffers.size();
+          if (path == 0) {
+            commands.bindPipeline(attributePipeline);
+            for (size_t i = first; i < last; i++) {
+              attributeMeshes[i].record(commands);
+            }
+          } else {
+            commands.bindPipeline(pulledPipeline);
+            pulledMeshes->recordBind(commands);
+            for (size_t i = first; i < last; i++) {
+              pulledMeshes->record(commands, (uint32_t)i);
+            }
+          }
+        });
+        commandStats.recordSeconds +=
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - recordStart).count();
+        size_t recorded = 0;
+        for (const CommandBuffer &commands : buffers) {
+          recorded += commands.commandCount();
+          commandStats.bytes += commands.bytes();
+        }
+        commandStats.commands += recorded;
+        frame.record([&, recorded]() {
+          replayStats.replaySeconds +=
+              std::chrono::duration<double>(std::chrono::steady_clock::now() - replayStart).count();
+          replayStats.replayed += recorded;
+        });
+      }
+    } else if (!sortedItems.empty()) {
+      for (const DrawItem &item : sortedItems) {
+        DrawItem drifting = item;
+        drifting.depth = std::fmod(item.depth + time * 0.05f, 1.0f);
+        drawQueue.submit(drifting);
+      }
+      drawQueue.flush(frame.recordBuffers(1)[0], sortDraws);
+    } else if (options.deformPasses > 0) {
+      float xOffset = shown.xOffset;
+      frame.record([&, xOffset]() {
+        Shader &passShader = deformCache ? capturedShader : xOffsetShader;
+        const PipelineState *passPipeline = deformCache ? capturedPipeline : xOffsetPipeline;
+        if (deformCache) {
+          xOffsetCapture.use();
+          xOffsetCapture.setUniform1f("xOffset", xOffset);
+          deformCache->capture(xOffsetCapture, {&deformedMesh});
+        } else {
+          glState().bindPipeline(xOffsetPipeline);
+          xOffsetShader.setUniform1f("xOffset", xOffset);
+        }
+        glState().bindPipeline(passPipeline);
+        for (size_t pass = 0; pass < options.deformPasses; pass++) {
+          float shade = (pass + 1.0f) / options.deformPasses;
+          passShader.setUniform4f("vertexColour", 0.2f * shade, 0.6f * shade, shade, 1.0f);
+          if (deformCache) {
+            deformCache->draw(0);
+          } else {
+            deformedMesh.draw();
+          }
+        }
+      });
+    } else if (meshArena) {
+      // The arena and its seed are only touched by the GL thread
+      frame.record([&]() {
+        for (int k = 0; k < 16; k++) {
+          size_t i = (size_t)(next_random(arenaSeed) * arenaMeshes.size());
+          arenaMeshes[i] = arena_polygon(packedVertexArray, *meshArena, i, arenaMeshes.size(), arenaSeed);
+        }
+        meshArena->defragment(64 * 1024);
 
-    // Render triangle
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-    // glDrawArrays(GL_TRIANGLES, 0, 3);
+        if (texture) {
+          texture->bind();
+        }
+        glState().bindPipeline(arenaPipeline);
+        for (const Mesh &mesh : arenaMeshes) {
+          mesh.draw();
+        }
+      });
+    } else {
+      // Culling only reads the meshlet bounds, so it runs here while the GL thread draws the previous frame
+      std::vector<DrawElementsIndirectCommand> commands;
+      if (meshletCuller && !(glbModel && glbModel->loaded())) {
+        meshletCuller->cull(meshletView, commands, objMesh->firstIndex(), &meshletStats);
+      }
+      frame.record([&, meshletCommands = std::move(commands), shown]() {
+        // Bind texture to texture shader
+        // ------------
+        if (texture) {
+          texture->bind();
+        }
 
-    glfwSwapBuffers(window); // Enable double buffering (front and back buffers)
-    glfwPollEvents();
-  }
+        glState().bindPipeline(currentPipeline);
+        if (options.animate && !(glbModel && glbModel->loaded()) && !meshletCuller) {
+          // Animate triangle colour, and move vertices to the left then to the right by 20%
+          glState().bindPipeline(xOffsetPipeline);
+          xOffsetShader.setUniform4f("vertexColour", 0.0f, shown.brightness * 0.2f, shown.brightness, 1.0f);
+          xOffsetShader.setUniform1f("xOffset", shown.xOffset);
+        }
 
-  glfwTerminate();
-  std::cout << "Closed OpenGL Test application" << std::endl;
-  return 0;
-}
+        // Render triangle, or the loaded model
+        if (glbModel && glbModel->loaded()) {
+          glState().bindPipeline(texturePipeline);
+          glbModel->draw(glbTextures);
+        } else if (meshletCuller) {
+          glState().bindPipeline(meshletPipeline);
+          frameStream->beginFrame();
+          StreamAllocation commandRange = frameStream->upload(
+              meshletCommands.data(), meshletCommands.size() * sizeof(DrawElementsIndirectCommand), sizeof(GLuint));
+          if (commandRange.valid()) {
+            glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandRange.buffer);
+            objMesh->drawIndirect(commandRange.offset, (GLsizei)meshletCommands.size());
+          }
+          frameStream->endFrame();
+        } else if (objMesh) {
+          objMesh->draw();
+        } else {
+          quad.draw();
+        }
+        // glDrawArrays(GL_TRIANGLES, 0, 3);
+      });
+    }
 
-void framebuffer_size_callback(GLFWwindow *, int width, int height) { glViewport(0, 0, width, height); }
+    // Report the frame rate of benchmarks once a second
+    if (options.benchmark()) {
+      statsFrames++;
+      double now = glfwGetTime();
+      if (now - statsStart >= 1.0) {
+        double seconds = now - statsStart;
+        if (pulledMeshes) {
+          printf("Vertex path %s: ", vertexPaths[vertexPath]);
+          vertexPath = (vertexPath + 1) % std::size(vertexPaths);
+        }
+        if (!sortedItems.empty()) {
+          printf("Draw order %s: ", sortDraws ? "sorted" : "submitted");
+        }
+        printf("%.1f fps, %.2f ms/frame\n", statsFrames / seconds, seconds * 1000.0 / statsFrames);
+        if (meshletCuller) {
+          meshletStats.print();
+        }
+        if (!sortedItems.empty()) {
+          // The last frame's, every frame submits the same draws
+          drawQueue.stats().print();
+          sortDraws = !sortDraws;
+        }
+        if (renderThread) {
+          renderThread->takeStats().print();
+        }
+        pacer.takeStats().print();
+        timestep.takeStats().print();
+        // The rest belongs to the GL thread
+        frame.record([&, frames = statsFrames, recorded = commandStats]() {
+          if (pulledMeshes && recorded.commands > 0) {
+            CommandStats stats = recorded;
+            stats.replayed = replayStats.replayed;
+            stats.replaySeconds = replayStats.replaySeconds;
+            stats.print();
+            replayStats = CommandStats();
+          }
+          if (spriteBatch) {
+            spriteBatch->stats().print();
+          }
+          if (frameStream) {
+            frameStream->stats().print();
+          }
+          if (meshArena) {
+            meshArena->stats().print();
+          }
+          if (deformCache) {
+            deformCache->takeStats().print();
+          }
+          glState().takeStats().print(frames);
+        });
+        statsStart = now;
+        statsFrames = 0;
+        commandStats = CommandStats();
+      }
+    }
 
-void process_input(GLFWwindow *window) {
-  if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
-    glfwSetWindowShouldClose(window, true);
+    frame.record([&]() { pacer.endFrame(); });
+    if (renderThread) {
+      renderThread->endFrame();
+    } else {
+      serialFrame.execute();
+      serialFrame.clear();
+      glfwSwapBuffers(window); // Enable double buffering (front and back buffers)
+    }
+  }
+  if (redraw.isOnDemand()) {
+    redraw.takeStats().print();
   }
 }
@@ -0,0 +1,22 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+// Read only mapping of a whole file, unmapped on destruction. data is null if the file could not be opened or is
+// empty.
+class MappedFile {
+public:
+  const char *data = nullptr;
+  size_t size = 0;
+
+  // sequential hints the kernel to read ahead, for files parsed front to back
+  explicit MappedFile(const std::string &path, bool sequential = true);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+};
+
+#endif
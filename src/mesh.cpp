@@ -0,0 +1,79 @@
+#include "mesh.hpp"
+
+MeshAttachment Mesh::attachment(bool baseVertex) const {
+  MeshAttachment attachment;
+  attachment.vertexBuffer = vertexBuffer ? vertexBuffer->id : 0;
+  attachment.indexBuffer = indexBuffer ? indexBuffer->id : 0;
+  if (vertexBlock) {
+    ArenaRange range = vertexBlock->range();
+    attachment.vertexBuffer = range.buffer;
+    attachment.vertexOffset = range.offset;
+    if (baseVertex && stride > 0 && range.offset % stride == 0) {
+      attachment.vertexOffset = 0;
+      attachment.baseVertex = (GLint)(range.offset / stride);
+    }
+  }
+  if (indexBlock) {
+    ArenaRange range = indexBlock->range();
+    attachment.indexBuffer = range.buffer;
+    attachment.indexOffset = range.offset;
+  }
+  return attachment;
+}
+
+GLintptr Mesh::bindTo(GLuint vertexArray) const {
+  MeshAttachment attached = attachment(false);
+  return bind(vertexArray, attached.vertexBuffer, attached.vertexOffset, stride);
+}
+
+GLintptr Mesh::bind(GLuint vertexArray, GLuint vertexBuffer, GLintptr vertexOffset, GLsizei vertexStride) const {
+  MeshAttachment attached = attachment(false);
+  glState().bindVertexArray(vertexArray);
+  glState().vertexArrayVertexBuffer(vertexArray, 0, vertexBuffer, vertexOffset, vertexStride);
+  glState().vertexArrayElementBuffer(vertexArray, attached.indexBuffer);
+  return attached.indexOffset;
+}
+
+void Mesh::draw() const {
+  MeshAttachment attached = attachment();
+  glState().bindVertexArray(vao);
+  glState().vertexArrayVertexBuffer(vao, 0, attached.vertexBuffer, attached.vertexOffset, stride);
+  glState().vertexArrayElementBuffer(vao, attached.indexBuffer);
+  glState().setEnabled(GL_PRIMITIVE_RESTART_FIXED_INDEX, mode == GL_TRIANGLE_STRIP);
+  glDrawElementsBaseVertex(mode, indexCount, indexType, (const void *)attached.indexOffset, attached.baseVertex);
+}
+
+void Mesh::record(CommandBuffer &commands) const {
+  // Replay goes through the state cache, which drops attachments that match the previous draw's
+  MeshAttachment attached = attachment();
+  commands.bindVertexArray(vao);
+  commands.vertexBuffer(vao, 0, attached.vertexBuffer, attached.vertexOffset, stride);
+  commands.elementBuffer(vao, attached.indexBuffer);
+  commands.setEnabled(GL_PRIMITIVE_RESTART_FIXED_INDEX, mode == GL_TRIANGLE_STRIP);
+  commands.drawElements(mode, indexCount, indexType, attached.indexOffset, 1, attached.baseVertex);
+}
+
+void Mesh::drawVertices() const {
+  bind();
+  glDrawArrays(GL_POINTS, 0, vertexCount);
+}
+
+void Mesh::drawWith(GLuint vertexArray, GLuint vertexBuffer, GLintptr vertexOffset, GLsizei vertexStride) const {
+  GLintptr indexOffset = bind(vertexArray, vertexBuffer, vertexOffset, vertexStride);
+  glState().setEnabled(GL_PRIMITIVE_RESTART_FIXED_INDEX, mode == GL_TRIANGLE_STRIP);
+  glDrawElements(mode, indexCount, indexType, (const void *)indexOffset);
+}
+
+void Mesh::drawIndirect(GLintptr commandOffset, GLsizei drawCount) const {
+  bind();
+  glState().setEnabled(GL_PRIMITIVE_RESTART_FIXED_INDEX, mode == GL_TRIANGLE_STRIP);
+  glMultiDrawElementsIndirect(mode, indexType, (const void *)commandOffset, drawCount, 0);
+}
+
+GLuint Mesh::firstIndex() const {
+  if (!indexBlock) {
+    return 0;
+  }
+  GLuint indexSize = indexType == GL_UNSIGNED_BYTE ? 1 : indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+  return (GLuint)(indexBlock->range().offset / indexSize);
+}
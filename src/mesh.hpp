@@ -0,0 +1,140 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include "buffer.hpp"
+#include "buffer_arena.hpp"
+#include "command_buffer.hpp"
+#include "gl_state.hpp"
+#include "resource_cache.hpp"
+#include <glad/gl.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Vertex array holding only the attribute formats of one vertex layout. Meshes with the same layout share it and
+// just attach their own buffers before drawing.
+template <typename Format> class VertexArray {
+public:
+  GLuint id = 0;
+
+  VertexArray() {
+    glCreateVertexArrays(1, &id);
+    Format::setup(id);
+  }
+  ~VertexArray() {
+    glState().forgetVertexArray(id);
+    glDeleteVertexArrays(1, &id);
+  }
+
+  VertexArray(const VertexArray &) = delete;
+  VertexArray &operator=(const VertexArray &) = delete;
+};
+
+// Where a draw of a mesh reads its vertices and indices from
+struct MeshAttachment {
+  GLuint vertexBuffer = 0;
+  GLintptr vertexOffset = 0;
+  GLuint indexBuffer = 0;
+  GLintptr indexOffset = 0;
+  // Added to every index. Lets arena meshes attach their page from its start, so draws from one page share it.
+  GLint baseVertex = 0;
+};
+
+// Indexed triangle mesh, either in buffers of its own or in ranges of a shared BufferArena
+class Mesh {
+public:
+  std::shared_ptr<Buffer> vertexBuffer;
+  std::shared_ptr<Buffer> indexBuffer;
+  std::shared_ptr<ArenaBlock> vertexBlock;
+  std::shared_ptr<ArenaBlock> indexBlock;
+  GLuint vao = 0;
+  GLsizei stride = 0;
+  GLsizei vertexCount = 0;
+  GLsizei indexCount = 0;
+  GLenum indexType = GL_UNSIGNED_INT;
+  // GL_TRIANGLE_STRIP for indices from stripify, whose strips are joined by the largest value of the index type
+  GLenum mode = GL_TRIANGLES;
+
+  // Passing a cache shares the buffers with any mesh that has identical contents
+  template <typename Format, typename Vertex, typename Index>
+  Mesh(const VertexArray<Format> &vertexArray,
+       const Vertex *vertices,
+       size_t vertexCount,
+       const Index *indices,
+       size_t indexCount,
+       ResourceCache *cache = nullptr)
+      : vao(vertexArray.id), stride(Format::stride), vertexCount((GLsizei)vertexCount), indexCount((GLsizei)indexCount),
+        indexType(indexTypeOf<Index>()) {
+    static_assert(sizeof(Vertex) == Format::stride, "vertex struct does not match its format");
+    size_t vertexBytes = vertexCount * sizeof(Vertex), indexBytes = indexCount * sizeof(Index);
+    vertexBuffer = cache ? cache->buffer(vertices, vertexBytes) : std::make_shared<Buffer>(vertexBytes, vertices);
+    indexBuffer = cache ? cache->buffer(indices, indexBytes) : std::make_shared<Buffer>(indexBytes, indices);
+  }
+
+  // Sub-allocate the vertices and indices from an arena instead of creating two buffer objects per mesh
+  template <typename Format, typename Vertex, typename Index>
+  Mesh(const VertexArray<Format> &vertexArray,
+       BufferArena &arena,
+       const Vertex *vertices,
+       size_t vertexCount,
+       const Index *indices,
+       size_t indexCount)
+      : vao(vertexArray.id), stride(Format::stride), vertexCount((GLsizei)vertexCount), indexCount((GLsizei)indexCount),
+        indexType(indexTypeOf<Index>()) {
+    static_assert(sizeof(Vertex) == Format::stride, "vertex struct does not match its format");
+    vertexBlock = std::make_shared<ArenaBlock>(arena, vertexCount * sizeof(Vertex), vertices);
+    indexBlock = std::make_shared<ArenaBlock>(arena, indexCount * sizeof(Index), indices);
+  }
+
+  // Build a mesh with the narrowest index type that can address every vertex, 16 bit indices halve index fetch for
+  // all but very large meshes. The largest 16 bit value is left free, it restarts strips.
+  template <typename Format, typename Vertex>
+  static Mesh withSmallestIndices(const VertexArray<Format> &vertexArray,
+                                  const Vertex *vertices,
+                                  size_t vertexCount,
+                                  const uint32_t *indices,
+                                  size_t indexCount,
+                                  ResourceCache *cache = nullptr) {
+    if (vertexCount <= UINT16_MAX) {
+      std::vector<uint16_t> narrow(indices, indices + indexCount);
+      return Mesh(vertexArray, vertices, vertexCount, narrow.data(), narrow.size(), cache);
+    }
+    return Mesh(vertexArray, vertices, vertexCount, indices, indexCount, cache);
+  }
+
+  // Point the shared vertex array at this mesh's buffers and draw it
+  void draw() const;
+  // Draw with commands from the bound GL_DRAW_INDIRECT_BUFFER. Their firstIndex must include firstIndex(), since
+  // arena meshes do not start at the beginning of their index buffer.
+  void drawIndirect(GLintptr commandOffset, GLsizei drawCount) const;
+  GLuint firstIndex() const;
+  // Record draw() into a command buffer. Arena ranges are resolved now, so the arena must not be defragmented before
+  // the commands are replayed.
+  void record(CommandBuffer &commands) const;
+  // Run the vertex stage once per vertex as points, without indices, e.g. to capture it with transform feedback
+  void drawVertices() const;
+  // Draw this mesh's indices over other per-vertex data, one element per vertex of this mesh from vertexBuffer on
+  // binding 0 of vertexArray
+  void drawWith(GLuint vertexArray, GLuint vertexBuffer, GLintptr vertexOffset, GLsizei vertexStride) const;
+  // Attach this mesh's buffers to binding 0 of another vertex array with a compatible layout and bind it, e.g. one
+  // that adds instance attributes. Returns the byte offset of the first index.
+  GLintptr bindTo(GLuint vertexArray) const;
+  // Resolved now, arena ranges move during defragmentation. Without baseVertex the vertex offset points at the
+  // mesh itself, for draws that cannot pass a base vertex.
+  MeshAttachment attachment(bool baseVertex = true) const;
+
+private:
+  // Attach the buffers to the vertex array and bind it, returns the byte offset of the first index
+  GLintptr bind() const { return bindTo(vao); }
+  GLintptr bind(GLuint vertexArray, GLuint vertexBuffer, GLintptr vertexOffset, GLsizei vertexStride) const;
+
+  template <typename Index> static constexpr GLenum indexTypeOf() {
+    static_assert(std::is_same_v<Index, uint8_t> || std::is_same_v<Index, uint16_t> || std::is_same_v<Index, uint32_t>,
+                  "index type must be an 8, 16 or 32 bit unsigned integer");
+    return sizeof(Index) == 1 ? GL_UNSIGNED_BYTE : sizeof(Index) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+  }
+};
+
+#endif
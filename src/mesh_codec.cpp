@@ -0,0 +1,464 @@
+#include "mesh_codec.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static constexpr uint32_t CODEC_MAGIC = 0x3143534D; // "MSC1"
+static constexpr size_t HEADER_BYTES = 12;
+// Elements decoded per block, small enough that a block's planes stay in L1
+static constexpr size_t BLOCK_ELEMENTS = 256;
+// Fewer blocks than this per task and the pool costs more than it saves
+static constexpr size_t MIN_BLOCKS_PER_TASK = 16;
+static constexpr size_t GROUP_BYTES = 16;
+// Packed group sizes for the four per-group widths of 0, 2, 4 and 8 bits
+static constexpr size_t GROUP_SIZES[4] = {0, 4, 8, 16};
+
+namespace {
+
+struct Column {
+  uint32_t offset;
+  uint32_t width;
+};
+
+std::vector<Column> columnsOf(const uint8_t *wordSizes, size_t count) {
+  std::vector<Column> columns;
+  uint32_t offset = 0;
+  for (size_t i = 0; i < count; i++) {
+    columns.push_back({offset, wordSizes[i]});
+    offset += wordSizes[i];
+  }
+  return columns;
+}
+
+uint32_t readWord(const uint8_t *source, uint32_t width) {
+  uint32_t value = 0;
+  std::memcpy(&value, source, width);
+  return value;
+}
+
+void packPlane(const uint8_t *bytes, size_t count, std::vector<uint8_t> &out) {
+  size_t groups = (count + GROUP_BYTES - 1) / GROUP_BYTES;
+  size_t headerStart = out.size();
+  out.resize(out.size() + (groups + 3) / 4, 0);
+  for (size_t g = 0; g < groups; g++) {
+    uint8_t group[GROUP_BYTES] = {};
+    size_t n = std::min(GROUP_BYTES, count - g * GROUP_BYTES);
+    std::memcpy(group, bytes + g * GROUP_BYTES, n);
+    uint8_t largest = 0;
+    for (uint8_t value : group) {
+      largest |= value;
+    }
+    int code = largest == 0 ? 0 : largest < 4 ? 1 : largest < 16 ? 2 : 3;
+    out[headerStart + g / 4] |= (uint8_t)(code << ((g % 4) * 2));
+    // 2 bit values k, k + 4, k + 8, k + 12 share byte k and 4 bit values k, k + 8 share byte k, which unpacks
+    // with shifts and masks alone
+    if (code == 1) {
+      for (size_t k = 0; k < 4; k++) {
+        out.push_back((uint8_t)(group[k] | group[k + 4] << 2 | group[k + 8] << 4 | group[k + 12] << 6));
+      }
+    } else if (code == 2) {
+      for (size_t k = 0; k < 8; k++) {
+        out.push_back((uint8_t)(group[k] | group[k + 8] << 4));
+      }
+    } else if (code == 3) {
+      out.insert(out.end(), group, group + GROUP_BYTES);
+    }
+  }
+}
+
+void unpackGroup(int code, const uint8_t *data, uint8_t *out) {
+  for (size_t k = 0; k < GROUP_BYTES; k++) {
+    if (code == 0) {
+      out[k] = 0;
+    } else if (code == 1) {
+      out[k] = (data[k % 4] >> ((k / 4) * 2)) & 3;
+    } else if (code == 2) {
+      out[k] = (data[k % 8] >> ((k / 8) * 4)) & 15;
+    } else {
+      out[k] = data[k];
+    }
+  }
+}
+
+#if defined(__SSE2__)
+// Branch free unpack for groups with 16 readable bytes behind them: every width is unpacked and the right one kept,
+// which is cheaper than mispredicting on the per group width
+inline __m128i unpackGroupSse(int code, const uint8_t *data) {
+  __m128i x = _mm_loadu_si128((const __m128i *)data);
+  __m128i two = _mm_set1_epi8(3), four = _mm_set1_epi8(15);
+  __m128i a = _mm_and_si128(x, two), b = _mm_and_si128(_mm_srli_epi16(x, 2), two);
+  __m128i c = _mm_and_si128(_mm_srli_epi16(x, 4), two), d = _mm_and_si128(_mm_srli_epi16(x, 6), two);
+  __m128i bits2 = _mm_unpacklo_epi64(_mm_unpacklo_epi32(a, b), _mm_unpacklo_epi32(c, d));
+  __m128i bits4 = _mm_unpacklo_epi64(_mm_and_si128(x, four), _mm_and_si128(_mm_srli_epi16(x, 4), four));
+  __m128i is2 = _mm_set1_epi8(code == 1 ? -1 : 0), is4 = _mm_set1_epi8(code == 2 ? -1 : 0);
+  __m128i is8 = _mm_set1_epi8(code == 3 ? -1 : 0);
+  return _mm_or_si128(_mm_or_si128(_mm_and_si128(bits2, is2), _mm_and_si128(bits4, is4)), _mm_and_si128(x, is8));
+}
+#endif
+
+// Unpack one plane of count bytes into out, rounded up to whole groups. Advances cursor, false if it overruns end.
+bool unpackPlane(const uint8_t *&cursor, const uint8_t *end, size_t count, uint8_t *out) {
+  size_t groups = (count + GROUP_BYTES - 1) / GROUP_BYTES;
+  const uint8_t *header = cursor;
+  const uint8_t *data = cursor + (groups + 3) / 4;
+  if (data > end) {
+    return false;
+  }
+  size_t g = 0;
+#if defined(__SSE2__)
+  for (; g < groups && data + GROUP_BYTES <= end; g++) {
+    int code = (header[g / 4] >> ((g % 4) * 2)) & 3;
+    _mm_storeu_si128((__m128i *)(out + g * GROUP_BYTES), unpackGroupSse(code, data));
+    data += GROUP_SIZES[code];
+  }
+#endif
+  // The last groups of a stream, where a full 16 byte load could read past the end
+  for (; g < groups; g++) {
+    int code = (header[g / 4] >> ((g % 4) * 2)) & 3;
+    if (data + GROUP_SIZES[code] > end) {
+      return false;
+    }
+    unpackGroup(code, data, out + g * GROUP_BYTES);
+    data += GROUP_SIZES[code];
+  }
+  cursor = data;
+  return true;
+}
+
+// Turn the zigzag planes of one column back into the planes of its values, in place: join the bytes, undo zigzag and
+// prefix sum. Every block starts from zero, so blocks decode independently.
+template <uint32_t W> void decodeColumn(uint8_t *const *planes, size_t count) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  if constexpr (W == 1) {
+    __m128i carry = _mm_setzero_si128();
+    for (; i < count; i += 16) {
+      __m128i z = _mm_loadu_si128((const __m128i *)&planes[0][i]);
+      __m128i d = _mm_xor_si128(_mm_and_si128(_mm_srli_epi16(z, 1), _mm_set1_epi8(0x7F)),
+                                _mm_sub_epi8(_mm_setzero_si128(), _mm_and_si128(z, _mm_set1_epi8(1))));
+      d = _mm_add_epi8(d, _mm_slli_si128(d, 1));
+      d = _mm_add_epi8(d, _mm_slli_si128(d, 2));
+      d = _mm_add_epi8(d, _mm_slli_si128(d, 4));
+      d = _mm_add_epi8(d, _mm_slli_si128(d, 8));
+      d = _mm_add_epi8(d, carry);
+      // Broadcast the last byte without leaving the register, it is on the loop's critical path
+      carry = _mm_unpackhi_epi8(d, d);
+      carry = _mm_shuffle_epi32(_mm_unpackhi_epi16(carry, carry), 0xFF);
+      _mm_storeu_si128((__m128i *)&planes[0][i], d);
+    }
+  } else if constexpr (W == 2) {
+    __m128i carry = _mm_setzero_si128(), low = _mm_set1_epi16(0xFF);
+    for (; i < count; i += 16) {
+      __m128i p0 = _mm_loadu_si128((const __m128i *)&planes[0][i]);
+      __m128i p1 = _mm_loadu_si128((const __m128i *)&planes[1][i]);
+      __m128i z[2] = {_mm_unpacklo_epi8(p0, p1), _mm_unpackhi_epi8(p0, p1)};
+      for (__m128i &d : z) {
+        d = _mm_xor_si128(_mm_srli_epi16(d, 1),
+                          _mm_sub_epi16(_mm_setzero_si128(), _mm_and_si128(d, _mm_set1_epi16(1))));
+        d = _mm_add_epi16(d, _mm_slli_si128(d, 2));
+        d = _mm_add_epi16(d, _mm_slli_si128(d, 4));
+        d = _mm_add_epi16(d, _mm_slli_si128(d, 8));
+        d = _mm_add_epi16(d, carry);
+        carry = _mm_shuffle_epi32(_mm_shufflehi_epi16(d, 0xFF), 0xFF);
+      }
+      _mm_storeu_si128((__m128i *)&planes[0][i],
+                       _mm_packus_epi16(_mm_and_si128(z[0], low), _mm_and_si128(z[1], low)));
+      _mm_storeu_si128((__m128i *)&planes[1][i], _mm_packus_epi16(_mm_srli_epi16(z[0], 8), _mm_srli_epi16(z[1], 8)));
+    }
+  } else if constexpr (W == 4) {
+    __m128i carry = _mm_setzero_si128(), low = _mm_set1_epi32(0xFF);
+    for (; i < count; i += 16) {
+      __m128i p[4];
+      for (int b = 0; b < 4; b++) {
+        p[b] = _mm_loadu_si128((const __m128i *)&planes[b][i]);
+      }
+      __m128i a = _mm_unpacklo_epi8(p[0], p[1]), b = _mm_unpackhi_epi8(p[0], p[1]);
+      __m128i c = _mm_unpacklo_epi8(p[2], p[3]), e = _mm_unpackhi_epi8(p[2], p[3]);
+      __m128i z[4] = {_mm_unpacklo_epi16(a, c), _mm_unpackhi_epi16(a, c), _mm_unpacklo_epi16(b, e),
+                      _mm_unpackhi_epi16(b, e)};
+      for (__m128i &d : z) {
+        d = _mm_xor_si128(_mm_srli_epi32(d, 1),
+                          _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(d, _mm_set1_epi32(1))));
+        d = _mm_add_epi32(d, _mm_slli_si128(d, 4));
+        d = _mm_add_epi32(d, _mm_slli_si128(d, 8));
+        d = _mm_add_epi32(d, carry);
+        carry = _mm_shuffle_epi32(d, 0xFF);
+      }
+      // Split back into byte planes, each byte is masked first so the saturating packs keep it unchanged
+      for (int k = 0; k < 4; k++) {
+        __m128i v[4];
+        for (int j = 0; j < 4; j++) {
+          v[j] = _mm_and_si128(_mm_srli_epi32(z[j], 8 * k), low);
+        }
+        _mm_storeu_si128((__m128i *)&planes[k][i],
+                         _mm_packus_epi16(_mm_packs_epi32(v[0], v[1]), _mm_packs_epi32(v[2], v[3])));
+      }
+    }
+  }
+#else
+  uint32_t previous = 0;
+  for (; i < count; i++) {
+    uint32_t z = 0;
+    for (uint32_t b = 0; b < W; b++) {
+      z |= (uint32_t)planes[b][i] << (8 * b);
+    }
+    previous += (z >> 1) ^ (0u - (z & 1));
+    for (uint32_t b = 0; b < W; b++) {
+      planes[b][i] = (uint8_t)(previous >> (8 * b));
+    }
+  }
+#endif
+}
+
+// Interleave the byte planes of a block (plane p is byte p of every element) into elements of stride bytes
+void interleave(const uint8_t *planes, size_t count, size_t stride, uint8_t *out) {
+  size_t p = 0;
+#if defined(__SSE2__)
+  alignas(16) uint8_t rows[16][16];
+  // Sixteen planes at a time: a 16 x 16 byte transpose is four rounds of interleaving row k with row k + 8
+  for (; p + 16 <= stride; p += 16) {
+    for (size_t i = 0; i < count; i += 16) {
+      __m128i a[16], b[16];
+      for (int k = 0; k < 16; k++) {
+        a[k] = _mm_loadu_si128((const __m128i *)&planes[(p + k) * BLOCK_ELEMENTS + i]);
+      }
+      for (int round = 0; round < 4; round++) {
+        for (int k = 0; k < 8; k++) {
+          b[k * 2] = _mm_unpacklo_epi8(a[k], a[k + 8]);
+          b[k * 2 + 1] = _mm_unpackhi_epi8(a[k], a[k + 8]);
+        }
+        std::copy(b, b + 16, a);
+      }
+      size_t n = std::min<size_t>(16, count - i);
+      for (size_t v = 0; v < n; v++) {
+        _mm_storeu_si128((__m128i *)(out + (i + v) * stride + p), a[v]);
+      }
+    }
+  }
+  // Then four planes at a time, which covers the rest of any layout padded to 4 bytes
+  for (; p + 4 <= stride; p += 4) {
+    for (size_t i = 0; i < count; i += 16) {
+      __m128i q[4];
+      for (int k = 0; k < 4; k++) {
+        q[k] = _mm_loadu_si128((const __m128i *)&planes[(p + k) * BLOCK_ELEMENTS + i]);
+      }
+      __m128i a = _mm_unpacklo_epi8(q[0], q[1]), b = _mm_unpackhi_epi8(q[0], q[1]);
+      __m128i c = _mm_unpacklo_epi8(q[2], q[3]), d = _mm_unpackhi_epi8(q[2], q[3]);
+      _mm_store_si128((__m128i *)rows[0], _mm_unpacklo_epi16(a, c));
+      _mm_store_si128((__m128i *)rows[1], _mm_unpackhi_epi16(a, c));
+      _mm_store_si128((__m128i *)rows[2], _mm_unpacklo_epi16(b, d));
+      _mm_store_si128((__m128i *)rows[3], _mm_unpackhi_epi16(b, d));
+      size_t n = std::min<size_t>(16, count - i);
+      for (size_t v = 0; v < n; v++) {
+        std::memcpy(out + (i + v) * stride + p, &rows[v / 4][(v % 4) * 4], 4);
+      }
+    }
+  }
+#endif
+  for (; p < stride; p++) {
+    for (size_t i = 0; i < count; i++) {
+      out[i * stride + p] = planes[p * BLOCK_ELEMENTS + i];
+    }
+  }
+}
+
+// Header, word sizes, then one uint32 offset per block measured from the end of the offset table
+size_t blockCountOf(size_t count) { return (count + BLOCK_ELEMENTS - 1) / BLOCK_ELEMENTS; }
+
+std::vector<uint8_t>
+encodeStream(const uint8_t *elements, size_t count, uint32_t stride, const std::vector<uint8_t> &wordSizes) {
+  size_t blockCount = blockCountOf(count);
+  size_t payloadStart = HEADER_BYTES + wordSizes.size() + blockCount * sizeof(uint32_t);
+  std::vector<uint8_t> out(payloadStart);
+  uint32_t header[2] = {CODEC_MAGIC, (uint32_t)count};
+  uint16_t shape[2] = {(uint16_t)stride, (uint16_t)wordSizes.size()};
+  std::memcpy(out.data(), header, sizeof(header));
+  std::memcpy(out.data() + sizeof(header), shape, sizeof(shape));
+  std::copy(wordSizes.begin(), wordSizes.end(), out.begin() + HEADER_BYTES);
+
+  std::vector<Column> columns = columnsOf(wordSizes.data(), wordSizes.size());
+  uint8_t planes[4][BLOCK_ELEMENTS];
+  for (size_t block = 0; block < blockCount; block++) {
+    uint32_t blockOffset = (uint32_t)(out.size() - payloadStart);
+    uint8_t *offsetSlot = out.data() + HEADER_BYTES + wordSizes.size() + block * sizeof(uint32_t);
+    std::memcpy(offsetSlot, &blockOffset, sizeof(uint32_t));
+    size_t start = block * BLOCK_ELEMENTS;
+    size_t n = std::min(BLOCK_ELEMENTS, count - start);
+    for (const Column &column : columns) {
+      uint32_t bits = column.width * 8;
+      uint32_t mask = bits == 32 ? UINT32_MAX : (1u << bits) - 1;
+      // Deltas restart at every block so blocks decode on their own
+      uint32_t before = 0;
+      for (size_t i = 0; i < n; i++) {
+        uint32_t value = readWord(elements + (start + i) * stride + column.offset, column.width);
+        uint32_t delta = (value - before) & mask;
+        before = value;
+        // Sign of the delta at this width, spread over every bit
+        uint32_t sign = (delta >> (bits - 1)) & 1 ? UINT32_MAX : 0;
+        uint32_t zigzag = ((delta << 1) ^ sign) & mask;
+        for (uint32_t b = 0; b < column.width; b++) {
+          planes[b][i] = (uint8_t)(zigzag >> (8 * b));
+        }
+      }
+      for (uint32_t b = 0; b < column.width; b++) {
+        packPlane(planes[b], n, out);
+      }
+    }
+  }
+  return out;
+}
+
+// Decode blocks [first, last) of a stream whose header has already been checked
+bool decodeBlocks(const uint8_t *data,
+                  size_t size,
+                  size_t count,
+                  size_t stride,
+                  size_t first,
+                  size_t last,
+                  uint8_t *out) {
+  size_t columnCount = data[10] | data[11] << 8;
+  std::vector<Column> columns = columnsOf(data + HEADER_BYTES, columnCount);
+  const uint8_t *offsets = data + HEADER_BYTES + columnCount;
+  const uint8_t *payload = offsets + blockCountOf(count) * sizeof(uint32_t), *end = data + size;
+
+  // One plane per byte of the element, rebuilt column by column and then interleaved
+  std::vector<uint8_t> planes(stride * BLOCK_ELEMENTS);
+  for (size_t block = first; block < last; block++) {
+    uint32_t blockOffset;
+    std::memcpy(&blockOffset, offsets + block * sizeof(uint32_t), sizeof(uint32_t));
+    if (blockOffset > (size_t)(end - payload)) {
+      return false;
+    }
+    const uint8_t *cursor = payload + blockOffset;
+    size_t start = block * BLOCK_ELEMENTS;
+    size_t n = std::min(BLOCK_ELEMENTS, count - start);
+    for (const Column &column : columns) {
+      uint8_t *columnPlanes[4];
+      for (uint32_t b = 0; b < column.width; b++) {
+        columnPlanes[b] = &planes[(column.offset + b) * BLOCK_ELEMENTS];
+        if (!unpackPlane(cursor, end, n, columnPlanes[b])) {
+          return false;
+        }
+      }
+      if (column.width == 1) {
+        decodeColumn<1>(columnPlanes, n);
+      } else if (column.width == 2) {
+        decodeColumn<2>(columnPlanes, n);
+      } else {
+        decodeColumn<4>(columnPlanes, n);
+      }
+    }
+    interleave(planes.data(), n, stride, out + start * stride);
+  }
+  return true;
+}
+
+} // namespace
+
+VertexCodecLayout codecLayoutFrom(const VertexAttribute *attributes, size_t attributeCount, size_t stride) {
+  VertexCodecLayout layout;
+  layout.stride = (uint32_t)stride;
+  std::vector<uint8_t> bytes(stride, 1);
+  for (size_t a = 0; a < attributeCount; a++) {
+    uint8_t width = 4;
+    switch (attributes[a].type) {
+    case GL_BYTE:
+    case GL_UNSIGNED_BYTE:
+      width = 1;
+      break;
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+    case GL_HALF_FLOAT:
+      width = 2;
+      break;
+    default:
+      break;
+    }
+    for (GLint c = 0; c < attributes[a].size; c++) {
+      bytes[attributes[a].offset + c * width] = width;
+    }
+  }
+  // Walk the stride, a component start swallows its remaining bytes and anything else is a 1 byte word
+  for (size_t offset = 0; offset < stride; offset += bytes[offset]) {
+    layout.wordSizes.push_back(bytes[offset]);
+  }
+  return layout;
+}
+
+std::vector<uint8_t> encodeVertices(const void *vertices, size_t vertexCount, const VertexCodecLayout &layout) {
+  return encodeStream(static_cast<const uint8_t *>(vertices), vertexCount, layout.stride, layout.wordSizes);
+}
+
+std::vector<uint8_t> encodeIndices(const uint32_t *indices, size_t indexCount) {
+  return encodeStream(reinterpret_cast<const uint8_t *>(indices), indexCount, sizeof(uint32_t), {4});
+}
+
+bool encodedStreamInfo(const uint8_t *data, size_t size, size_t &count, size_t &stride) {
+  if (size < HEADER_BYTES) {
+    return false;
+  }
+  uint32_t header[2];
+  uint16_t shape[2];
+  std::memcpy(header, data, sizeof(header));
+  std::memcpy(shape, data + sizeof(header), sizeof(shape));
+  if (header[0] != CODEC_MAGIC || size < HEADER_BYTES + shape[1]) {
+    return false;
+  }
+  size_t total = 0;
+  for (size_t i = 0; i < shape[1]; i++) {
+    uint8_t width = data[HEADER_BYTES + i];
+    if (width != 1 && width != 2 && width != 4) {
+      return false;
+    }
+    total += width;
+  }
+  if (total != shape[0] || size < HEADER_BYTES + shape[1] + blockCountOf(header[1]) * sizeof(uint32_t)) {
+    return false;
+  }
+  count = header[1];
+  stride = shape[0];
+  return true;
+}
+
+bool decodeVertices(const uint8_t *data, size_t size, void *output, ThreadPool *pool) {
+  size_t count, stride;
+  if (!encodedStreamInfo(data, size, count, stride)) {
+    return false;
+  }
+  uint8_t *out = static_cast<uint8_t *>(output);
+  size_t blockCount = blockCountOf(count);
+  size_t taskCount = pool ? std::min<size_t>(pool->size(), blockCount / MIN_BLOCKS_PER_TASK) : 0;
+  if (taskCount < 2) {
+    return decodeBlocks(data, size, count, stride, 0, blockCount, out);
+  }
+
+  std::vector<std::future<bool>> results;
+  for (size_t t = 0; t < taskCount; t++) {
+    size_t first = blockCount * t / taskCount, last = blockCount * (t + 1) / taskCount;
+    results.push_back(pool->submit([=]() { return decodeBlocks(data, size, count, stride, first, last, out); }));
+  }
+  bool ok = true;
+  for (std::future<bool> &result : results) {
+    ok = result.get() && ok;
+  }
+  return ok;
+}
+
+bool decodeIndices(const uint8_t *data, size_t size, uint32_t *output, ThreadPool *pool) {
+  size_t count, stride;
+  return encodedStreamInfo(data, size, count, stride) && stride == sizeof(uint32_t) &&
+         decodeVertices(data, size, output, pool);
+}
+
+void MeshCodecStats::print(const char *name) const {
+  printf("Encoded %s: %.1f KiB -> %.1f KiB (%.2fx), decoded at %.2f GB/s\n",
+         name,
+         rawBytes / 1024.0,
+         encodedBytes / 1024.0,
+         ratio(),
+         gigabytesPerSecond());
+}
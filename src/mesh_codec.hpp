@@ -0,0 +1,52 @@
+#ifndef MESH_CODEC_H
+#define MESH_CODEC_H
+
+#include "thread_pool.hpp"
+#include "vertex_format.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Lossless codec for vertex and index streams. Every component is delta coded against the same component of the
+// previous vertex in its block of 256 at its own width, zigzag folded so small changes either way become small
+// numbers, then split into byte planes (all low bytes, then all next bytes, ...). Each plane is packed in groups of 16
+// bytes at 0, 2, 4 or 8 bits per byte, which drops the near-empty high planes. The output stays byte oriented, so a
+// general purpose compressor on top of it still finds the remaining redundancy.
+
+// Width in bytes of every component in a vertex, in order, covering the whole stride
+struct VertexCodecLayout {
+  uint32_t stride = 0;
+  std::vector<uint8_t> wordSizes;
+};
+
+// Components come from the attributes, bytes between them (padding) are coded as single bytes
+VertexCodecLayout codecLayoutFrom(const VertexAttribute *attributes, size_t attributeCount, size_t stride);
+
+template <typename Format> VertexCodecLayout codecLayout() {
+  auto attributes = Format::attributes();
+  return codecLayoutFrom(attributes.data(), attributes.size(), Format::stride);
+}
+
+std::vector<uint8_t> encodeVertices(const void *vertices, size_t vertexCount, const VertexCodecLayout &layout);
+std::vector<uint8_t> encodeIndices(const uint32_t *indices, size_t indexCount);
+
+// Element count and stride recorded in an encoded stream, false if the header is malformed
+bool encodedStreamInfo(const uint8_t *data, size_t size, size_t &count, size_t &stride);
+
+// Decode into output, which must hold count * stride bytes. Returns false on malformed or truncated input. Decoding
+// runs in blocks that stay in cache and uses SSE2 where available, so output can go straight into mapped memory.
+// Blocks are independent, so with a pool large streams are split across the workers.
+bool decodeVertices(const uint8_t *data, size_t size, void *output, ThreadPool *pool = nullptr);
+bool decodeIndices(const uint8_t *data, size_t size, uint32_t *output, ThreadPool *pool = nullptr);
+
+struct MeshCodecStats {
+  size_t rawBytes = 0;
+  size_t encodedBytes = 0;
+  double decodeSeconds = 0.0;
+
+  double ratio() const { return encodedBytes > 0 ? (double)rawBytes / encodedBytes : 0.0; }
+  double gigabytesPerSecond() const { return decodeSeconds > 0.0 ? rawBytes / (decodeSeconds * 1e9) : 0.0; }
+  void print(const char *name) const;
+};
+
+#endif
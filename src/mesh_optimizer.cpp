@@ -0,0 +1,382 @@
+#include "mesh_optimizer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount, size_t cacheSize) {
+  VertexCacheStats stats;
+  if (indices.empty()) {
+    return stats;
+  }
+
+  // Cache entries are stamped with the miss counter at insertion, an entry is still cached while fewer than
+  // cacheSize misses have happened since
+  std::vector<size_t> insertedAt(vertexCount, 0);
+  std::vector<bool> seen(vertexCount, false);
+  size_t misses = 0, referenced = 0;
+  for (uint32_t index : indices) {
+    if (!seen[index]) {
+      seen[index] = true;
+      referenced++;
+    } else if (misses - insertedAt[index] < cacheSize) {
+      continue;
+    }
+    insertedAt[index] = ++misses;
+  }
+
+  stats.acmr = (double)misses / (indices.size() / 3);
+  stats.atvr = referenced > 0 ? (double)misses / referenced : 0.0;
+  return stats;
+}
+
+// Forsyth's tuning constants, see "Linear-Speed Vertex Cache Optimisation"
+static constexpr int FORSYTH_CACHE_SIZE = 32;
+static constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+static constexpr float CACHE_DECAY_POWER = 1.5f;
+static constexpr float VALENCE_BOOST_SCALE = 2.0f;
+static constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+static float vertexScore(int cachePosition, uint32_t remainingTriangles) {
+  if (remainingTriangles == 0) {
+    return -1.0f;
+  }
+  float score = 0.0f;
+  if (cachePosition >= 0) {
+    // The last triangle's vertices get a fixed score so the next triangle does not just reuse its edge
+    if (cachePosition < 3) {
+      score = LAST_TRIANGLE_SCORE;
+    } else {
+      float scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+      score = std::pow(1.0f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+    }
+  }
+  // Prefer vertices with few triangles left, so they are finished instead of left as stragglers
+  score += VALENCE_BOOST_SCALE * std::pow((float)remainingTriangles, -VALENCE_BOOST_POWER);
+  return score;
+}
+
+void optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount) {
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0) {
+    return;
+  }
+
+  // Triangles using each vertex, as offsets into one flat array
+  std::vector<uint32_t> remaining(vertexCount, 0);
+  for (uint32_t index : indices) {
+    remaining[index]++;
+  }
+  std::vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+  for (size_t v = 0; v < vertexCount; v++) {
+    firstTriangle[v + 1] = firstTriangle[v] + remaining[v];
+  }
+  std::vector<uint32_t> vertexTriangles(indices.size());
+  std::vector<uint32_t> filled(vertexCount, 0);
+  for (size_t t = 0; t < triangleCount; t++) {
+    for (int k = 0; k < 3; k++) {
+      uint32_t v = indices[t * 3 + k];
+      vertexTriangles[firstTriangle[v] + filled[v]++] = (uint32_t)t;
+    }
+  }
+
+  std::vector<int> cachePosition(vertexCount, -1);
+  std::vector<float> score(vertexCount);
+  for (size_t v = 0; v < vertexCount; v++) {
+    score[v] = vertexScore(-1, remaining[v]);
+  }
+  std::vector<float> triangleScore(triangleCount);
+  for (size_t t = 0; t < triangleCount; t++) {
+    triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+  }
+
+  std::vector<bool> emitted(triangleCount, false);
+  std::vector<uint32_t> output;
+  output.reserve(indices.size());
+  std::vector<uint32_t> cache, nextCache;
+  // Vertices of recently emitted triangles, as in Tipsify. Each vertex is pushed once per triangle, so draining the
+  // stack costs as much in total as the index count.
+  std::vector<uint32_t> deadEnd;
+  size_t scanCursor = 0;
+
+  auto restart = [&]() {
+    // When the cache has nothing useful, continue next to where the mesh was last worked on: the best triangle of
+    // the most recent vertex that still has some left
+    while (!deadEnd.empty()) {
+      uint32_t v = deadEnd.back();
+      deadEnd.pop_back();
+      int best = -1;
+      float bestScore = -1.0f;
+      for (uint32_t i = 0; i < remaining[v]; i++) {
+        uint32_t t = vertexTriangles[firstTriangle[v] + i];
+        if (triangleScore[t] > bestScore) {
+          bestScore = triangleScore[t];
+          best = (int)t;
+        }
+      }
+      if (best >= 0) {
+        return best;
+      }
+    }
+    // Only disconnected parts get here, take the next unemitted triangle. The cursor only moves forward, so the
+    // scans add up to one pass over the triangles.
+    while (scanCursor < triangleCount && emitted[scanCursor]) {
+      scanCursor++;
+    }
+    return scanCursor < triangleCount ? (int)scanCursor : -1;
+  };
+
+  int best = restart();
+  while (best >= 0) {
+    emitted[best] = true;
+    const uint32_t *triangle = &indices[best * 3];
+    output.insert(output.end(), triangle, triangle + 3);
+    deadEnd.insert(deadEnd.end(), triangle, triangle + 3);
+
+    // Move the triangle's vertices to the front of the LRU cache and drop the emitted triangle from their lists
+    nextCache.assign(triangle, triangle + 3);
+    for (int k = 0; k < 3; k++) {
+      uint32_t v = triangle[k];
+      uint32_t *begin = &vertexTriangles[firstTriangle[v]];
+      uint32_t *end = begin + remaining[v];
+      *std::find(begin, end, (uint32_t)best) = *(end - 1);
+      remaining[v]--;
+    }
+    for (uint32_t v : cache) {
+      if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+        nextCache.push_back(v);
+      }
+    }
+    for (size_t i = FORSYTH_CACHE_SIZE; i < nextCache.size(); i++) {
+      cachePosition[nextCache[i]] = -1;
+      score[nextCache[i]] = vertexScore(-1, remaining[nextCache[i]]);
+    }
+    if (nextCache.size() > (size_t)FORSYTH_CACHE_SIZE) {
+      nextCache.resize(FORSYTH_CACHE_SIZE);
+    }
+    cache.swap(nextCache);
+
+    // Rescore everything in the cache and pick the best triangle touching it
+    for (size_t i = 0; i < cache.size(); i++) {
+      cachePosition[cache[i]] = (int)i;
+      score[cache[i]] = vertexScore((int)i, remaining[cache[i]]);
+    }
+    best = -1;
+    float bestScore = -1.0f;
+    for (uint32_t v : cache) {
+      for (uint32_t i = 0; i < remaining[v]; i++) {
+        uint32_t t = vertexTriangles[firstTriangle[v] + i];
+        float s = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+        triangleScore[t] = s;
+        if (s > bestScore) {
+          bestScore = s;
+          best = (int)t;
+        }
+      }
+    }
+    if (best < 0) {
+      best = restart();
+    }
+  }
+
+  indices.swap(output);
+}
+
+void optimizeOverdraw(std::vector<uint32_t> &indices,
+                      const float *positions,
+                      size_t positionStride,
+                      size_t vertexCount,
+                      size_t clusterTriangles) {
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount <= clusterTriangles || vertexCount == 0) {
+    return;
+  }
+  auto position = [&](uint32_t index) {
+    return reinterpret_cast<const float *>(reinterpret_cast<const unsigned char *>(positions) + index * positionStride);
+  };
+
+  // Mesh centroid, the reference point for "outward"
+  double centre[3] = {0.0, 0.0, 0.0};
+  for (uint32_t index : indices) {
+    const float *p = position(index);
+    for (int k = 0; k < 3; k++) {
+      centre[k] += p[k];
+    }
+  }
+  for (double &c : centre) {
+    c /= indices.size();
+  }
+
+  struct Cluster {
+    size_t firstTriangle;
+    size_t triangleCount;
+    float sortKey;
+  };
+  std::vector<Cluster> clusters;
+  for (size_t first = 0; first < triangleCount; first += clusterTriangles) {
+    size_t count = std::min(clusterTriangles, triangleCount - first);
+    // Area weighted normal and centroid of the cluster
+    double normal[3] = {0.0, 0.0, 0.0}, centroid[3] = {0.0, 0.0, 0.0}, area = 0.0;
+    for (size_t t = first; t < first + count; t++) {
+      const float *a = position(indices[t * 3]), *b = position(indices[t * 3 + 1]), *c = position(indices[t * 3 + 2]);
+      double e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+      double e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+      double n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+      double triangleArea = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      for (int k = 0; k < 3; k++) {
+        normal[k] += n[k];
+        centroid[k] += (a[k] + b[k] + c[k]) / 3.0 * triangleArea;
+      }
+      area += triangleArea;
+    }
+    double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+    float key = 0.0f;
+    if (length > 0.0 && area > 0.0) {
+      for (int k = 0; k < 3; k++) {
+        key += (float)((centroid[k] / area - centre[k]) * normal[k] / length);
+      }
+    }
+    clusters.push_back({first, count, key});
+  }
+
+  // Most outward facing first, those are the likeliest occluders of the rest
+  std::stable_sort(
+      clusters.begin(), clusters.end(), [](const Cluster &a, const Cluster &b) { return a.sortKey > b.sortKey; });
+
+  std::vector<uint32_t> output;
+  output.reserve(indices.size());
+  for (const Cluster &cluster : clusters) {
+    output.insert(output.end(),
+                  indices.begin() + cluster.firstTriangle * 3,
+                  indices.begin() + (cluster.firstTriangle + cluster.triangleCount) * 3);
+  }
+  indices.swap(output);
+}
+
+size_t optimizeVertexFetch(void *vertices, size_t vertexCount, size_t vertexSize, std::vector<uint32_t> &indices) {
+  std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+  uint32_t next = 0;
+  for (uint32_t &index : indices) {
+    if (remap[index] == UINT32_MAX) {
+      remap[index] = next++;
+    }
+    index = remap[index];
+  }
+
+  std::vector<unsigned char> reordered((size_t)next * vertexSize);
+  unsigned char *bytes = static_cast<unsigned char *>(vertices);
+  for (size_t v = 0; v < vertexCount; v++) {
+    if (remap[v] != UINT32_MAX) {
+      std::memcpy(&reordered[remap[v] * vertexSize], bytes + v * vertexSize, vertexSize);
+    }
+  }
+  std::memcpy(vertices, reordered.data(), reordered.size());
+  return next;
+}
+
+bool stripify(std::vector<uint32_t> &indices, size_t vertexCount, uint32_t restartIndex) {
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0) {
+    return false;
+  }
+
+  // Triangles using each vertex, as offsets into one flat array
+  std::vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+  for (size_t i = 0; i < triangleCount * 3; i++) {
+    firstTriangle[indices[i] + 1]++;
+  }
+  for (size_t v = 0; v < vertexCount; v++) {
+    firstTriangle[v + 1] += firstTriangle[v];
+  }
+  std::vector<uint32_t> vertexTriangles(triangleCount * 3);
+  std::vector<uint32_t> filled(vertexCount, 0);
+  for (size_t t = 0; t < triangleCount; t++) {
+    for (int k = 0; k < 3; k++) {
+      uint32_t v = indices[t * 3 + k];
+      vertexTriangles[firstTriangle[v] + filled[v]++] = (uint32_t)t;
+    }
+  }
+
+  std::vector<bool> used(triangleCount, false);
+  // An unused triangle wound through the edge from a to b, -1 if there is none. third is its remaining vertex.
+  auto findTriangle = [&](uint32_t a, uint32_t b, uint32_t &third) {
+    for (uint32_t i = firstTriangle[a]; i < firstTriangle[a + 1]; i++) {
+      uint32_t t = vertexTriangles[i];
+      if (used[t]) {
+        continue;
+      }
+      const uint32_t *triangle = &indices[t * 3];
+      for (int rotation = 0; rotation < 3; rotation++) {
+        if (triangle[rotation] == a && triangle[(rotation + 1) % 3] == b) {
+          third = triangle[(rotation + 2) % 3];
+          return (int64_t)t;
+        }
+      }
+    }
+    return (int64_t)-1;
+  };
+
+  std::vector<uint32_t> strip;
+  strip.reserve(indices.size());
+  // Strips start at the first unused triangle in list order, which keeps them near the vertex cache order
+  size_t start = 0;
+  while (true) {
+    while (start < triangleCount && used[start]) {
+      start++;
+    }
+    if (start == triangleCount) {
+      break;
+    }
+    used[start] = true;
+    const uint32_t *triangle = &indices[start * 3];
+    // Enter through the rotation whose far edge leads on to another triangle. The second strip triangle is wound
+    // (c, b, next) for a strip starting (a, b, c).
+    int entry = 0;
+    uint32_t third;
+    for (int rotation = 0; rotation < 3; rotation++) {
+      if (findTriangle(triangle[(rotation + 2) % 3], triangle[(rotation + 1) % 3], third) >= 0) {
+        entry = rotation;
+        break;
+      }
+    }
+    if (!strip.empty()) {
+      strip.push_back(restartIndex);
+    }
+    for (int k = 0; k < 3; k++) {
+      strip.push_back(triangle[(entry + k) % 3]);
+    }
+
+    // Even strip triangles are (p, q, next), odd ones are wound (q, p, next)
+    for (size_t stripTriangles = 1;; stripTriangles++) {
+      uint32_t p = strip[strip.size() - 2], q = strip[strip.size() - 1];
+      int64_t next = stripTriangles % 2 == 0 ? findTriangle(p, q, third) : findTriangle(q, p, third);
+      if (next < 0) {
+        break;
+      }
+      used[(size_t)next] = true;
+      strip.push_back(third);
+    }
+  }
+
+  // Every strip costs a restart index, so meshes that break into short strips are smaller as a list
+  if (strip.size() >= indices.size()) {
+    return false;
+  }
+  indices.swap(strip);
+  return true;
+}
+
+void MeshOptimizationReport::print(const char *name) const {
+  printf("Optimized %s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, %zu -> %zu vertices, %zu -> %zu indices%s\n",
+         name,
+         before.acmr,
+         after.acmr,
+         before.atvr,
+         after.atvr,
+         verticesBefore,
+         verticesAfter,
+         indicesBefore,
+         indicesAfter,
+         strips ? " as strips" : "");
+}
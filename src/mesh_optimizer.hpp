@@ -0,0 +1,73 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct VertexCacheStats {
+  // Average cache miss ratio: transformed vertices per triangle, 0.5 is ideal for a regular grid, 3 is worst
+  double acmr = 0.0;
+  // Average transform to vertex ratio: transformed vertices per referenced vertex, 1 is ideal
+  double atvr = 0.0;
+};
+
+// Simulate a FIFO post-transform cache of cacheSize entries over a triangle list
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t> &indices, size_t vertexCount, size_t cacheSize = 16);
+
+// Reorder triangles for post-transform cache hits with Forsyth's linear-speed algorithm. Triangles keep their
+// winding, only their order changes.
+void optimizeVertexCache(std::vector<uint32_t> &indices, size_t vertexCount);
+
+// Reorder clusters of triangles so outward facing ones come first, which lets early depth testing reject more of the
+// rest. Run after optimizeVertexCache, clusters are runs of clusterTriangles in cache order so cache efficiency is
+// mostly kept. positions points at the first position, positionStride is the distance between vertices in bytes.
+void optimizeOverdraw(std::vector<uint32_t> &indices,
+                      const float *positions,
+                      size_t positionStride,
+                      size_t vertexCount,
+                      size_t clusterTriangles = 64);
+
+// Reorder vertices in the order the index buffer first uses them and drop unreferenced ones, so vertex fetch walks
+// memory forwards. vertices holds vertexCount elements of vertexSize bytes, returns the new vertex count.
+size_t optimizeVertexFetch(void *vertices, size_t vertexCount, size_t vertexSize, std::vector<uint32_t> &indices);
+
+// Replace a triangle list with triangle strips, each grown greedily through unused neighbours that share an edge with
+// matching winding, joined by restartIndex. Draw with GL_TRIANGLE_STRIP and GL_PRIMITIVE_RESTART_FIXED_INDEX, which
+// UINT32_MAX becomes when the indices are narrowed. Returns false and leaves the list alone when the strips would not
+// be shorter. Run last, the other passes expect a list.
+bool stripify(std::vector<uint32_t> &indices, size_t vertexCount, uint32_t restartIndex = UINT32_MAX);
+
+struct MeshOptimizationReport {
+  VertexCacheStats before;
+  VertexCacheStats after;
+  size_t verticesBefore = 0;
+  size_t verticesAfter = 0;
+  size_t indicesBefore = 0;
+  size_t indicesAfter = 0;
+  // The indices are triangle strips joined by restarts rather than a list
+  bool strips = false;
+
+  void print(const char *name) const;
+};
+
+// Full pass for a freshly loaded mesh: vertex cache, overdraw, then vertex fetch order, and with strips a conversion
+// to triangle strips when they come out shorter. The position is read as three floats at the start of each vertex.
+template <typename Vertex>
+MeshOptimizationReport
+optimizeMesh(std::vector<Vertex> &vertices, std::vector<uint32_t> &indices, bool strips = false) {
+  MeshOptimizationReport report;
+  report.verticesBefore = vertices.size();
+  report.indicesBefore = indices.size();
+  report.before = analyzeVertexCache(indices, vertices.size());
+  optimizeVertexCache(indices, vertices.size());
+  optimizeOverdraw(indices, reinterpret_cast<const float *>(vertices.data()), sizeof(Vertex), vertices.size());
+  vertices.resize(optimizeVertexFetch(vertices.data(), vertices.size(), sizeof(Vertex), indices));
+  report.after = analyzeVertexCache(indices, vertices.size());
+  report.verticesAfter = vertices.size();
+  report.strips = strips && stripify(indices, vertices.size());
+  report.indicesAfter = indices.size();
+  return report;
+}
+
+#endif
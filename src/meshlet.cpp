@@ -0,0 +1,354 @@
+#include "meshlet.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+static constexpr uint32_t NO_TRIANGLE = UINT32_MAX;
+
+namespace {
+
+void computeBounds(Meshlet &meshlet,
+                   const std::vector<uint32_t> &indices,
+                   const float *positions,
+                   size_t positionStride,
+                   const std::vector<float> &normals,
+                   std::vector<uint32_t> &stamp,
+                   uint32_t id) {
+  auto position = [&](uint32_t index) {
+    return reinterpret_cast<const float *>(reinterpret_cast<const unsigned char *>(positions) + index * positionStride);
+  };
+  uint32_t first = meshlet.firstIndex, last = meshlet.firstIndex + meshlet.indexCount;
+
+  // Sphere around the centroid of the distinct vertices
+  std::vector<uint32_t> vertices;
+  for (uint32_t i = first; i < last; i++) {
+    if (stamp[indices[i]] != id) {
+      stamp[indices[i]] = id;
+      vertices.push_back(indices[i]);
+    }
+  }
+  double centre[3] = {0.0, 0.0, 0.0};
+  for (uint32_t v : vertices) {
+    for (int k = 0; k < 3; k++) {
+      centre[k] += position(v)[k];
+    }
+  }
+  float radiusSquared = 0.0f;
+  for (int k = 0; k < 3; k++) {
+    meshlet.centre[k] = (float)(centre[k] / vertices.size());
+  }
+  for (uint32_t v : vertices) {
+    const float *p = position(v);
+    float dx = p[0] - meshlet.centre[0], dy = p[1] - meshlet.centre[1], dz = p[2] - meshlet.centre[2];
+    radiusSquared = std::max(radiusSquared, dx * dx + dy * dy + dz * dz);
+  }
+  meshlet.radius = std::sqrt(radiusSquared);
+
+  // Cone around the average triangle normal, wide enough to hold every one of them
+  float axis[3] = {0.0f, 0.0f, 0.0f};
+  for (uint32_t t = first / 3; t < last / 3; t++) {
+    for (int k = 0; k < 3; k++) {
+      axis[k] += normals[t * 3 + k];
+    }
+  }
+  float length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+  meshlet.coneCutoff = 1.0f;
+  if (length < 1e-6f) {
+    return;
+  }
+  float minDot = 1.0f;
+  for (int k = 0; k < 3; k++) {
+    meshlet.coneAxis[k] = axis[k] / length;
+  }
+  for (uint32_t t = first / 3; t < last / 3; t++) {
+    const float *n = &normals[t * 3];
+    if (n[0] == 0.0f && n[1] == 0.0f && n[2] == 0.0f) {
+      continue;
+    }
+    minDot = std::min(minDot, n[0] * meshlet.coneAxis[0] + n[1] * meshlet.coneAxis[1] + n[2] * meshlet.coneAxis[2]);
+  }
+  if (minDot > 0.0f) {
+    meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+  }
+}
+
+} // namespace
+
+std::vector<Meshlet> buildMeshlets(std::vector<uint32_t> &indices,
+                                   const float *positions,
+                                   size_t positionStride,
+                                   size_t vertexCount,
+                                   size_t maxVertices,
+                                   size_t maxTriangles) {
+  std::vector<Meshlet> meshlets;
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0 || maxVertices < 3 || maxTriangles == 0) {
+    return meshlets;
+  }
+
+  // Triangles using each vertex, as offsets into one flat array
+  std::vector<uint32_t> firstTriangle(vertexCount + 1, 0);
+  for (size_t i = 0; i < triangleCount * 3; i++) {
+    firstTriangle[indices[i] + 1]++;
+  }
+  for (size_t v = 0; v < vertexCount; v++) {
+    firstTriangle[v + 1] += firstTriangle[v];
+  }
+  std::vector<uint32_t> vertexTriangles(triangleCount * 3);
+  std::vector<uint32_t> filled(firstTriangle.begin(), firstTriangle.end() - 1);
+  for (size_t t = 0; t < triangleCount; t++) {
+    for (int k = 0; k < 3; k++) {
+      vertexTriangles[filled[indices[t * 3 + k]]++] = (uint32_t)t;
+    }
+  }
+
+  // Unit face normals, zero for degenerate triangles
+  std::vector<float> normals(triangleCount * 3, 0.0f);
+  for (size_t t = 0; t < triangleCount; t++) {
+    const float *p[3];
+    for (int k = 0; k < 3; k++) {
+      p[k] = reinterpret_cast<const float *>(reinterpret_cast<const unsigned char *>(positions) +
+                                             indices[t * 3 + k] * positionStride);
+    }
+    float e1[3] = {p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2]};
+    float e2[3] = {p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2]};
+    float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+    float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (length > 0.0f) {
+      for (int k = 0; k < 3; k++) {
+        normals[t * 3 + k] = n[k] / length;
+      }
+    }
+  }
+
+  std::vector<bool> emitted(triangleCount, false);
+  // Id of the meshlet a vertex was last added to, so membership is a compare instead of a set lookup
+  std::vector<uint32_t> stamp(vertexCount, UINT32_MAX);
+  std::vector<uint32_t> output, candidates, order;
+  output.reserve(indices.size());
+  order.reserve(triangleCount);
+  size_t cursor = 0;
+
+  while (true) {
+    while (cursor < triangleCount && emitted[cursor]) {
+      cursor++;
+    }
+    if (cursor == triangleCount) {
+      break;
+    }
+
+    uint32_t id = (uint32_t)meshlets.size();
+    Meshlet meshlet;
+    meshlet.firstIndex = (uint32_t)output.size();
+    size_t triangles = 0;
+    float axis[3] = {0.0f, 0.0f, 0.0f};
+    candidates.clear();
+
+    for (uint32_t next = (uint32_t)cursor; next != NO_TRIANGLE;) {
+      emitted[next] = true;
+      order.push_back(next);
+      triangles++;
+      for (int k = 0; k < 3; k++) {
+        uint32_t v = indices[next * 3 + k];
+        output.push_back(v);
+        axis[k] += normals[next * 3 + k];
+        if (stamp[v] != id) {
+          stamp[v] = id;
+          meshlet.vertexCount++;
+          for (uint32_t i = firstTriangle[v]; i < firstTriangle[v + 1]; i++) {
+            if (!emitted[vertexTriangles[i]]) {
+              candidates.push_back(vertexTriangles[i]);
+            }
+          }
+        }
+      }
+      if (triangles == maxTriangles) {
+        break;
+      }
+
+      // Neighbour adding the fewest new vertices, ties go to the one facing closest to the meshlet so far
+      next = NO_TRIANGLE;
+      uint32_t bestNew = 4;
+      float bestDot = -2.0f;
+      size_t kept = 0;
+      for (uint32_t t : candidates) {
+        if (emitted[t]) {
+          continue;
+        }
+        candidates[kept++] = t;
+        uint32_t added = (stamp[indices[t * 3]] != id) + (stamp[indices[t * 3 + 1]] != id) +
+                         (stamp[indices[t * 3 + 2]] != id);
+        if (meshlet.vertexCount + added > maxVertices || added > bestNew) {
+          continue;
+        }
+        float dot = normals[t * 3] * axis[0] + normals[t * 3 + 1] * axis[1] + normals[t * 3 + 2] * axis[2];
+        if (added < bestNew || dot > bestDot) {
+          next = t;
+          bestNew = added;
+          bestDot = dot;
+        }
+      }
+      candidates.resize(kept);
+    }
+
+    meshlet.indexCount = (uint32_t)(output.size() - meshlet.firstIndex);
+    meshlets.push_back(meshlet);
+  }
+
+  indices.swap(output);
+  std::vector<float> orderedNormals(indices.size());
+  for (size_t t = 0; t < triangleCount; t++) {
+    std::copy(&normals[order[t] * 3], &normals[order[t] * 3] + 3, &orderedNormals[t * 3]);
+  }
+  // Stamps are reused for the bounds pass, so start them over
+  std::fill(stamp.begin(), stamp.end(), UINT32_MAX);
+  for (size_t m = 0; m < meshlets.size(); m++) {
+    computeBounds(meshlets[m], indices, positions, positionStride, orderedNormals, stamp, (uint32_t)m);
+  }
+  return meshlets;
+}
+
+CullView CullView::orthographicBox(const float boxMin[3], const float boxMax[3]) {
+  CullView view;
+  for (int k = 0; k < 3; k++) {
+    float *low = view.planes[k * 2], *high = view.planes[k * 2 + 1];
+    std::fill(low, low + 4, 0.0f);
+    std::fill(high, high + 4, 0.0f);
+    low[k] = 1.0f;
+    low[3] = -boxMin[k];
+    high[k] = -1.0f;
+    high[3] = boxMax[k];
+  }
+  return view;
+}
+
+MeshletCuller::MeshletCuller(const std::vector<Meshlet> &meshlets) {
+  for (const Meshlet &meshlet : meshlets) {
+    centreX.push_back(meshlet.centre[0]);
+    centreY.push_back(meshlet.centre[1]);
+    centreZ.push_back(meshlet.centre[2]);
+    radius.push_back(meshlet.radius);
+    axisX.push_back(meshlet.coneAxis[0]);
+    axisY.push_back(meshlet.coneAxis[1]);
+    axisZ.push_back(meshlet.coneAxis[2]);
+    cutoff.push_back(meshlet.coneCutoff);
+    firstIndices.push_back(meshlet.firstIndex);
+    indexCounts.push_back(meshlet.indexCount);
+  }
+}
+
+bool MeshletCuller::visible(size_t i, const CullView &view, bool &frustumCulled) const {
+  frustumCulled = false;
+  for (const float *plane : view.planes) {
+    if (plane[0] * centreX[i] + plane[1] * centreY[i] + plane[2] * centreZ[i] + plane[3] < -radius[i]) {
+      frustumCulled = true;
+      return false;
+    }
+  }
+  if (view.perspective) {
+    float dx = centreX[i] - view.eye[0], dy = centreY[i] - view.eye[1], dz = centreZ[i] - view.eye[2];
+    float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+    return dx * axisX[i] + dy * axisY[i] + dz * axisZ[i] <= cutoff[i] * distance + radius[i];
+  }
+  return view.direction[0] * axisX[i] + view.direction[1] * axisY[i] + view.direction[2] * axisZ[i] <= cutoff[i];
+}
+
+void MeshletCuller::cull(const CullView &view,
+                         std::vector<DrawElementsIndirectCommand> &commands,
+                         GLuint firstIndex,
+                         MeshletCullStats *stats) const {
+  size_t count = firstIndices.size(), frustumCulled = 0, backfaceCulled = 0, visibleIndices = 0;
+  size_t firstCommand = commands.size();
+
+  auto emit = [&](size_t i) {
+    visibleIndices += indexCounts[i];
+    GLuint first = firstIndex + firstIndices[i];
+    // Meshlets are contiguous in the index buffer, so visible neighbours extend one command
+    if (commands.size() > firstCommand && commands.back().firstIndex + commands.back().count == first) {
+      commands.back().count += indexCounts[i];
+    } else {
+      commands.push_back({indexCounts[i], 1, first, 0, 0});
+    }
+  };
+
+  size_t i = 0;
+#if defined(__SSE__)
+  // Four meshlets per iteration, the masks say which were rejected by which test
+  __m128 directionX = _mm_set1_ps(view.direction[0]), directionY = _mm_set1_ps(view.direction[1]),
+         directionZ = _mm_set1_ps(view.direction[2]);
+  __m128 eyeX = _mm_set1_ps(view.eye[0]), eyeY = _mm_set1_ps(view.eye[1]), eyeZ = _mm_set1_ps(view.eye[2]);
+  for (; i + 4 <= count; i += 4) {
+    __m128 x = _mm_loadu_ps(&centreX[i]), y = _mm_loadu_ps(&centreY[i]), z = _mm_loadu_ps(&centreZ[i]);
+    __m128 r = _mm_loadu_ps(&radius[i]);
+    __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), r);
+    __m128 outside = _mm_setzero_ps();
+    for (const float *plane : view.planes) {
+      __m128 px = _mm_mul_ps(_mm_set1_ps(plane[0]), x), py = _mm_mul_ps(_mm_set1_ps(plane[1]), y);
+      __m128 pz = _mm_mul_ps(_mm_set1_ps(plane[2]), z);
+      __m128 distance = _mm_add_ps(_mm_add_ps(px, py), _mm_add_ps(pz, _mm_set1_ps(plane[3])));
+      outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negativeRadius));
+    }
+
+    __m128 ax = _mm_loadu_ps(&axisX[i]), ay = _mm_loadu_ps(&axisY[i]), az = _mm_loadu_ps(&axisZ[i]);
+    __m128 c = _mm_loadu_ps(&cutoff[i]);
+    __m128 back;
+    if (view.perspective) {
+      __m128 dx = _mm_sub_ps(x, eyeX), dy = _mm_sub_ps(y, eyeY), dz = _mm_sub_ps(z, eyeZ);
+      __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, ax), _mm_mul_ps(dy, ay)), _mm_mul_ps(dz, az));
+      __m128 distance =
+          _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+      back = _mm_cmpgt_ps(dot, _mm_add_ps(_mm_mul_ps(c, distance), r));
+    } else {
+      __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(directionX, ax), _mm_mul_ps(directionY, ay)),
+                              _mm_mul_ps(directionZ, az));
+      back = _mm_cmpgt_ps(dot, c);
+    }
+
+    int outsideMask = _mm_movemask_ps(outside), backMask = _mm_movemask_ps(_mm_andnot_ps(outside, back));
+    int visibleMask = ~(outsideMask | backMask) & 0xF;
+    frustumCulled += __builtin_popcount(outsideMask);
+    backfaceCulled += __builtin_popcount(backMask);
+    for (int k = 0; k < 4; k++) {
+      if (visibleMask & (1 << k)) {
+        emit(i + k);
+      }
+    }
+  }
+#endif
+  for (; i < count; i++) {
+    bool outside;
+    if (visible(i, view, outside)) {
+      emit(i);
+    } else if (outside) {
+      frustumCulled++;
+    } else {
+      backfaceCulled++;
+    }
+  }
+
+  if (stats != nullptr) {
+    stats->meshlets = count;
+    stats->frustumCulled = frustumCulled;
+    stats->backfaceCulled = backfaceCulled;
+    stats->triangles = 0;
+    for (uint32_t indexCount : indexCounts) {
+      stats->triangles += indexCount / 3;
+    }
+    stats->visibleTriangles = visibleIndices / 3;
+    stats->commands = commands.size() - firstCommand;
+  }
+}
+
+void MeshletCullStats::print() const {
+  printf("Meshlets: %zu visible of %zu (%zu outside the view, %zu back facing), %zu of %zu triangles in %zu draws\n",
+         meshlets - frustumCulled - backfaceCulled,
+         meshlets,
+         frustumCulled,
+         backfaceCulled,
+         visibleTriangles,
+         triangles,
+         commands);
+}
@@ -0,0 +1,79 @@
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include "indirect_batch.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Cluster of nearby triangles, a contiguous range of the mesh's index buffer
+struct Meshlet {
+  uint32_t firstIndex = 0;
+  uint32_t indexCount = 0;
+  uint32_t vertexCount = 0;
+  // Bounding sphere
+  float centre[3] = {0.0f, 0.0f, 0.0f};
+  float radius = 0.0f;
+  // Normal cone: every triangle faces within the cone around coneAxis. coneCutoff is the sine of its half angle, 1
+  // when the normals spread too far for the cluster to ever be entirely back facing.
+  float coneAxis[3] = {0.0f, 0.0f, 1.0f};
+  float coneCutoff = 1.0f;
+};
+
+// Split a triangle list into meshlets, growing each one greedily through triangles that add the fewest new vertices.
+// indices is rewritten so every meshlet is contiguous. Run after optimizeVertexCache, which gives the seeds locality.
+std::vector<Meshlet> buildMeshlets(std::vector<uint32_t> &indices,
+                                   const float *positions,
+                                   size_t positionStride,
+                                   size_t vertexCount,
+                                   size_t maxVertices = 64,
+                                   size_t maxTriangles = 124);
+
+// View to cull against, in the same space as the mesh positions
+struct CullView {
+  // (a, b, c, d) with the inside where ax + by + cz + d >= 0
+  float planes[6][4];
+  // Camera position for perspective views, for orthographic ones the direction the camera looks in
+  float eye[3] = {0.0f, 0.0f, 0.0f};
+  float direction[3] = {0.0f, 0.0f, -1.0f};
+  bool perspective = false;
+
+  // Orthographic view of an axis aligned box looking down -z, which is what the scene's untransformed clip space is
+  static CullView orthographicBox(const float boxMin[3], const float boxMax[3]);
+};
+
+struct MeshletCullStats {
+  size_t meshlets = 0;
+  size_t frustumCulled = 0;
+  size_t backfaceCulled = 0;
+  size_t triangles = 0;
+  size_t visibleTriangles = 0;
+  // Commands left after merging neighbouring visible meshlets
+  size_t commands = 0;
+
+  void print() const;
+};
+
+// Meshlet bounds stored as structure of arrays, so four meshlets are tested at once with SSE
+class MeshletCuller {
+public:
+  explicit MeshletCuller(const std::vector<Meshlet> &meshlets);
+
+  // Append one indirect command per run of visible meshlets. firstIndex is added to every command, for meshes that
+  // do not start at the beginning of their index buffer.
+  void cull(const CullView &view,
+            std::vector<DrawElementsIndirectCommand> &commands,
+            GLuint firstIndex = 0,
+            MeshletCullStats *stats = nullptr) const;
+
+  size_t size() const { return firstIndices.size(); }
+
+private:
+  std::vector<float> centreX, centreY, centreZ, radius;
+  std::vector<float> axisX, axisY, axisZ, cutoff;
+  std::vector<uint32_t> firstIndices, indexCounts;
+
+  bool visible(size_t i, const CullView &view, bool &frustumCulled) const;
+};
+
+#endif
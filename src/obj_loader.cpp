@@ -0,0 +1,374 @@
+#include "obj_loader.hpp"
+#include "mapped_file.hpp"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// Chunks are at least this big so small files are not split into more tasks than lines
+static constexpr size_t MIN_CHUNK_BYTES = 1024 * 1024;
+static constexpr size_t CHUNKS_PER_THREAD = 4;
+// Marks a face corner without a texture coordinate or normal
+static constexpr int32_t NO_INDEX = INT32_MIN;
+
+namespace {
+
+// Face corner as written. Negative indices are relative to the element count at that line, which is only known
+// within the chunk, so they are stored as chunk local offsets and flagged for resolving once every chunk is parsed.
+struct Corner {
+  int32_t index[3];
+  uint8_t relative;
+};
+
+struct ObjChunk {
+  std::vector<float> positions;
+  std::vector<float> texCoords;
+  std::vector<float> normals;
+  std::vector<Corner> corners;
+  size_t invalidLines = 0;
+};
+
+const char *skipSpaces(const char *cursor, const char *end) {
+  while (cursor < end && (*cursor == ' ' || *cursor == '\t')) {
+    cursor++;
+  }
+  return cursor;
+}
+
+// Parse up to count floats, missing trailing values keep their defaults
+const char *parseFloats(const char *cursor, const char *end, float *values, int count) {
+  for (int k = 0; k < count; k++) {
+    cursor = skipSpaces(cursor, end);
+    auto result = std::from_chars(cursor, end, values[k]);
+    if (result.ec != std::errc()) {
+      break;
+    }
+    cursor = result.ptr;
+  }
+  return cursor;
+}
+
+void parseChunk(const char *begin, const char *end, ObjChunk &chunk) {
+  std::vector<Corner> polygon;
+  const char *cursor = begin;
+  while (cursor < end) {
+    const char *lineEnd = static_cast<const char *>(std::memchr(cursor, '\n', end - cursor));
+    if (lineEnd == nullptr) {
+      lineEnd = end;
+    }
+    const char *line = skipSpaces(cursor, lineEnd);
+    cursor = lineEnd + 1;
+    if (lineEnd - line < 2) {
+      continue;
+    }
+
+    if (line[0] == 'v' && (line[1] == ' ' || line[1] == '\t')) {
+      float position[3] = {0.0f, 0.0f, 0.0f};
+      parseFloats(line + 2, lineEnd, position, 3);
+      chunk.positions.insert(chunk.positions.end(), position, position + 3);
+    } else if (line[0] == 'v' && line[1] == 't') {
+      float texCoord[2] = {0.0f, 0.0f};
+      parseFloats(line + 2, lineEnd, texCoord, 2);
+      chunk.texCoords.insert(chunk.texCoords.end(), texCoord, texCoord + 2);
+    } else if (line[0] == 'v' && line[1] == 'n') {
+      float normal[3] = {0.0f, 0.0f, 0.0f};
+      parseFloats(line + 2, lineEnd, normal, 3);
+      chunk.normals.insert(chunk.normals.end(), normal, normal + 3);
+    } else if (line[0] == 'f' && (line[1] == ' ' || line[1] == '\t')) {
+      int32_t counts[3] = {(int32_t)(chunk.positions.size() / 3),
+                           (int32_t)(chunk.texCoords.size() / 2),
+                           (int32_t)(chunk.normals.size() / 3)};
+      polygon.clear();
+      const char *token = skipSpaces(line + 2, lineEnd);
+      while (token < lineEnd && *token != '\r' && *token != '#') {
+        // v, v/t, v//n or v/t/n
+        Corner corner = {{NO_INDEX, NO_INDEX, NO_INDEX}, 0};
+        for (int k = 0; k < 3 && token < lineEnd; k++) {
+          int32_t value;
+          auto result = std::from_chars(token, lineEnd, value);
+          if (result.ec == std::errc() && value != 0) {
+            if (value < 0) {
+              corner.index[k] = counts[k] + value;
+              corner.relative |= 1 << k;
+            } else {
+              corner.index[k] = value - 1;
+            }
+            token = result.ptr;
+          }
+          if (token >= lineEnd || *token != '/') {
+            break;
+          }
+          token++;
+        }
+        if (corner.index[0] == NO_INDEX) {
+          break;
+        }
+        polygon.push_back(corner);
+        token = skipSpaces(token, lineEnd);
+      }
+      if (polygon.size() < 3) {
+        chunk.invalidLines++;
+        continue;
+      }
+      for (size_t k = 1; k + 1 < polygon.size(); k++) {
+        chunk.corners.insert(chunk.corners.end(), {polygon[0], polygon[k], polygon[k + 1]});
+      }
+    }
+  }
+}
+
+// Open addressing table from a position/uv/normal tuple to its welded vertex
+class WeldTable {
+public:
+  explicit WeldTable(size_t expected) {
+    size_t capacity = 16;
+    while (capacity < expected * 2) {
+      capacity *= 2;
+    }
+    slots.assign(capacity, Slot{});
+  }
+
+  // Returns the vertex for the key, or the next vertex id if it was inserted
+  uint32_t findOrInsert(const uint32_t key[3], uint32_t next, bool &inserted) {
+    if ((count + 1) * 2 > slots.size()) {
+      grow();
+    }
+    size_t mask = slots.size() - 1;
+    for (size_t slot = hash(key) & mask;; slot = (slot + 1) & mask) {
+      Slot &entry = slots[slot];
+      if (entry.vertex == EMPTY) {
+        std::memcpy(entry.key, key, sizeof(entry.key));
+        entry.vertex = next;
+        count++;
+        inserted = true;
+        return next;
+      }
+      if (entry.key[0] == key[0] && entry.key[1] == key[1] && entry.key[2] == key[2]) {
+        inserted = false;
+        return entry.vertex;
+      }
+    }
+  }
+
+private:
+  static constexpr uint32_t EMPTY = UINT32_MAX;
+  struct Slot {
+    uint32_t key[3] = {0, 0, 0};
+    uint32_t vertex = EMPTY;
+  };
+  std::vector<Slot> slots;
+  size_t count = 0;
+
+  static size_t hash(const uint32_t key[3]) {
+    uint64_t h = key[0] * 0x9E3779B97F4A7C15ull;
+    h ^= (key[1] + 0x632BE59BD9B4E019ull) * 0xC2B2AE3D27D4EB4Full;
+    h ^= (key[2] + 0x165667B19E3779F9ull) * 0x85EBCA77C2B2AE63ull;
+    return (size_t)(h ^ (h >> 29));
+  }
+
+  void grow() {
+    std::vector<Slot> old;
+    old.swap(slots);
+    slots.assign(old.size() * 2, Slot{});
+    size_t mask = slots.size() - 1;
+    for (const Slot &entry : old) {
+      if (entry.vertex == EMPTY) {
+        continue;
+      }
+      size_t slot = hash(entry.key) & mask;
+      while (slots[slot].vertex != EMPTY) {
+        slot = (slot + 1) & mask;
+      }
+      slots[slot] = entry;
+    }
+  }
+};
+
+// Chunk local welding result: distinct keys (three global indices each, UINT32_MAX when absent) and the triangles
+// as indices into them. remap is filled by the global merge.
+struct ChunkWeld {
+  std::vector<uint32_t> keys;
+  std::vector<uint32_t> indices;
+  std::vector<uint32_t> remap;
+  size_t invalidTriangles = 0;
+};
+
+void weldChunk(const ObjChunk &chunk, const int32_t base[3], const int32_t totals[3], ChunkWeld &weld) {
+  WeldTable table(chunk.corners.size() / 4);
+  weld.indices.reserve(chunk.corners.size());
+  for (size_t c = 0; c + 2 < chunk.corners.size(); c += 3) {
+    uint32_t keys[3][3];
+    bool valid = true;
+    for (int k = 0; k < 3 && valid; k++) {
+      const Corner &corner = chunk.corners[c + k];
+      for (int a = 0; a < 3; a++) {
+        int32_t index = corner.index[a];
+        if (index == NO_INDEX) {
+          keys[k][a] = UINT32_MAX;
+          continue;
+        }
+        if (corner.relative & (1 << a)) {
+          index += base[a];
+        }
+        if (index < 0 || index >= totals[a]) {
+          valid = false;
+        }
+        keys[k][a] = (uint32_t)index;
+      }
+    }
+    if (!valid) {
+      weld.invalidTriangles++;
+      continue;
+    }
+    for (int k = 0; k < 3; k++) {
+      bool inserted;
+      uint32_t vertex = table.findOrInsert(keys[k], (uint32_t)(weld.keys.size() / 3), inserted);
+      if (inserted) {
+        weld.keys.insert(weld.keys.end(), keys[k], keys[k] + 3);
+      }
+      weld.indices.push_back(vertex);
+    }
+  }
+}
+
+} // namespace
+
+ObjMesh loadObj(const std::string &path, ThreadPool &pool, ObjLoadStats *stats) {
+  auto wallStart = std::chrono::steady_clock::now();
+  ObjMesh mesh;
+  mesh.path = path;
+
+  MappedFile file(path);
+  if (file.data == nullptr) {
+    std::cout << "ERROR::OBJ::OPEN_FAILED " << path << std::endl;
+    return mesh;
+  }
+
+  // Split at newlines into roughly equal chunks
+  size_t targetBytes = std::max(MIN_CHUNK_BYTES, file.size / (pool.size() * CHUNKS_PER_THREAD));
+  std::vector<std::pair<size_t, size_t>> ranges;
+  for (size_t start = 0; start < file.size;) {
+    size_t stop = std::min(file.size, start + targetBytes);
+    const void *newline = stop < file.size ? std::memchr(file.data + stop, '\n', file.size - stop) : nullptr;
+    stop = newline != nullptr ? (size_t)(static_cast<const char *>(newline) - file.data) + 1 : file.size;
+    ranges.emplace_back(start, stop);
+    start = stop;
+  }
+
+  std::vector<ObjChunk> chunks(ranges.size());
+  for (size_t i = 0; i < ranges.size(); i++) {
+    pool.enqueue([&, i]() { parseChunk(file.data + ranges[i].first, file.data + ranges[i].second, chunks[i]); });
+  }
+  pool.waitIdle();
+  auto parseEnd = std::chrono::steady_clock::now();
+
+  // Weld within each chunk in parallel: resolve every corner to global attribute indices and give each distinct
+  // tuple a chunk local vertex. Only those local vertices go through the shared table afterwards.
+  int32_t totals[3] = {0, 0, 0};
+  std::vector<std::array<int32_t, 3>> bases(chunks.size());
+  for (size_t i = 0; i < chunks.size(); i++) {
+    bases[i] = {totals[0], totals[1], totals[2]};
+    totals[0] += (int32_t)(chunks[i].positions.size() / 3);
+    totals[1] += (int32_t)(chunks[i].texCoords.size() / 2);
+    totals[2] += (int32_t)(chunks[i].normals.size() / 3);
+  }
+  std::vector<ChunkWeld> welds(chunks.size());
+  for (size_t i = 0; i < chunks.size(); i++) {
+    pool.enqueue([&, i]() { weldChunk(chunks[i], bases[i].data(), totals, welds[i]); });
+  }
+  pool.waitIdle();
+
+  // Attributes in file order, so the global indices address them directly
+  std::vector<float> positions, texCoords, normals;
+  positions.reserve((size_t)totals[0] * 3);
+  texCoords.reserve((size_t)totals[1] * 2);
+  normals.reserve((size_t)totals[2] * 3);
+  size_t corners = 0, skipped = 0, localVertices = 0;
+  for (ObjChunk &chunk : chunks) {
+    positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+    texCoords.insert(texCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
+    normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+    corners += chunk.corners.size();
+    skipped += chunk.invalidLines;
+    chunk = ObjChunk();
+  }
+  for (const ChunkWeld &weld : welds) {
+    skipped += weld.invalidTriangles;
+    localVertices += weld.keys.size() / 3;
+  }
+
+  // Merge local vertices across chunks, in chunk order so the result does not depend on scheduling
+  WeldTable table(localVertices);
+  std::vector<size_t> indexOffsets(welds.size());
+  size_t indexCount = 0;
+  for (size_t i = 0; i < welds.size(); i++) {
+    ChunkWeld &weld = welds[i];
+    indexOffsets[i] = indexCount;
+    indexCount += weld.indices.size();
+    weld.remap.resize(weld.keys.size() / 3);
+    for (size_t v = 0; v < weld.remap.size(); v++) {
+      const uint32_t *key = &weld.keys[v * 3];
+      bool inserted;
+      weld.remap[v] = table.findOrInsert(key, (uint32_t)mesh.vertices.size(), inserted);
+      if (!inserted) {
+        continue;
+      }
+      TexturedVertex vertex = {{0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}, {0.0f, 0.0f}};
+      std::memcpy(vertex.position, &positions[(size_t)key[0] * 3], sizeof(vertex.position));
+      if (key[1] != UINT32_MAX) {
+        std::memcpy(vertex.texCoord, &texCoords[(size_t)key[1] * 2], sizeof(vertex.texCoord));
+      }
+      if (key[2] != UINT32_MAX) {
+        for (int a = 0; a < 3; a++) {
+          vertex.colour[a] = normals[(size_t)key[2] * 3 + a] * 0.5f + 0.5f;
+        }
+      }
+      mesh.vertices.push_back(vertex);
+    }
+  }
+
+  mesh.indices.resize(indexCount);
+  for (size_t i = 0; i < welds.size(); i++) {
+    pool.enqueue([&, i]() {
+      const ChunkWeld &weld = welds[i];
+      uint32_t *out = mesh.indices.data() + indexOffsets[i];
+      for (size_t k = 0; k < weld.indices.size(); k++) {
+        out[k] = weld.remap[weld.indices[k]];
+      }
+    });
+  }
+  pool.waitIdle();
+  auto wallEnd = std::chrono::steady_clock::now();
+
+  if (skipped > 0) {
+    std::cout << "ERROR::OBJ::INVALID_FACES " << path << " skipped " << skipped << std::endl;
+  }
+
+  if (stats != nullptr) {
+    stats->fileBytes = file.size;
+    stats->chunks = chunks.size();
+    stats->threads = pool.size();
+    stats->corners = corners;
+    stats->vertices = mesh.vertices.size();
+    stats->triangles = mesh.indices.size() / 3;
+    stats->parseSeconds = std::chrono::duration<double>(parseEnd - wallStart).count();
+    stats->weldSeconds = std::chrono::duration<double>(wallEnd - parseEnd).count();
+    stats->wallSeconds = std::chrono::duration<double>(wallEnd - wallStart).count();
+  }
+  return mesh;
+}
+
+void ObjLoadStats::print() const {
+  printf("Loaded OBJ of %.1f MiB in %zu chunks on %u threads: %.1f ms (parse %.1f ms, weld %.1f ms), %.1f MiB/s\n",
+         fileBytes / (1024.0 * 1024.0),
+         chunks,
+         threads,
+         wallSeconds * 1000.0,
+         parseSeconds * 1000.0,
+         weldSeconds * 1000.0,
+         megabytesPerSecond());
+  printf("  %zu triangles, %zu corners welded to %zu vertices\n", triangles, corners, vertices);
+}
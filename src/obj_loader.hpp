@@ -0,0 +1,42 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include "thread_pool.hpp"
+#include "vertex_format.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Welded triangle mesh in the interleaved layout the scene draws. The colour holds the normal mapped to [0, 1] when
+// the file has normals, and white otherwise.
+struct ObjMesh {
+  std::string path;
+  std::vector<TexturedVertex> vertices;
+  std::vector<uint32_t> indices;
+
+  bool loaded() const { return !indices.empty(); }
+};
+
+struct ObjLoadStats {
+  size_t fileBytes = 0;
+  size_t chunks = 0;
+  unsigned threads = 0;
+  // Corners referenced by faces, and the distinct position/uv/normal tuples they welded to
+  size_t corners = 0;
+  size_t vertices = 0;
+  size_t triangles = 0;
+  double parseSeconds = 0.0;
+  double weldSeconds = 0.0;
+  double wallSeconds = 0.0;
+
+  double megabytesPerSecond() const { return wallSeconds > 0.0 ? fileBytes / (wallSeconds * 1024.0 * 1024.0) : 0.0; }
+  void print() const;
+};
+
+// Map the file and parse line aligned chunks of it on the pool, then weld the face corners into shared vertices.
+// Supports v, vt, vn and f (polygons are fanned into triangles, negative indices count back from the end), other
+// statements are skipped.
+ObjMesh loadObj(const std::string &path, ThreadPool &pool, ObjLoadStats *stats = nullptr);
+
+#endif
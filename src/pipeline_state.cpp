@@ -0,0 +1,24 @@
+#include "pipeline_state.hpp"
+#include "hash.hpp"
+
+uint64_t PipelineDesc::hash() const {
+  // Field by field, the structs have padding
+  uint64_t hash = hashCombine(program, vertexArray);
+  hash = hashCombine(hash, (uint64_t)blend.enabled << 32 | blend.source);
+  hash = hashCombine(hash, blend.destination);
+  hash = hashCombine(hash, (uint64_t)depth.test << 33 | (uint64_t)depth.write << 32 | depth.func);
+  hash = hashCombine(hash, (uint64_t)raster.cull << 33 | (uint64_t)raster.multisample << 32 | raster.cullFace);
+  return hashCombine(hash, raster.polygonMode);
+}
+
+const PipelineState *PipelineCache::get(const PipelineDesc &desc) {
+  uint64_t hash = desc.hash();
+  std::vector<std::unique_ptr<PipelineState>> &bucket = pipelines[hash];
+  for (const std::unique_ptr<PipelineState> &pipeline : bucket) {
+    if (pipeline->desc() == desc) {
+      return pipeline.get();
+    }
+  }
+  bucket.push_back(std::unique_ptr<PipelineState>(new PipelineState(desc, hash, (uint32_t)count++)));
+  return bucket.back().get();
+}
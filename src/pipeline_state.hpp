@@ -0,0 +1,98 @@
+#ifndef PIPELINE_STATE_H
+#define PIPELINE_STATE_H
+
+#include <glad/gl.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+struct BlendState {
+  bool enabled = false;
+  GLenum source = GL_ONE;
+  GLenum destination = GL_ZERO;
+
+  bool operator==(const BlendState &other) const {
+    return enabled == other.enabled && source == other.source && destination == other.destination;
+  }
+};
+
+struct DepthState {
+  bool test = false;
+  bool write = true;
+  GLenum func = GL_LESS;
+
+  bool operator==(const DepthState &other) const {
+    return test == other.test && write == other.write && func == other.func;
+  }
+};
+
+struct RasterState {
+  bool cull = false;
+  GLenum cullFace = GL_BACK;
+  bool multisample = true;
+  // Front and back alike, GL_LINE draws wireframes
+  GLenum polygonMode = GL_FILL;
+
+  bool operator==(const RasterState &other) const {
+    return cull == other.cull && cullFace == other.cullFace && multisample == other.multisample &&
+           polygonMode == other.polygonMode;
+  }
+};
+
+// Everything a draw needs bound besides its resources. The defaults are GL's own, except for multisampling.
+struct PipelineDesc {
+  GLuint program = 0;
+  // Vertex array holding the attribute formats (see VertexArray), or 0 to leave vertex arrays to the draws, e.g. for
+  // meshes of several layouts
+  GLuint vertexArray = 0;
+  BlendState blend;
+  DepthState depth;
+  RasterState raster;
+
+  bool operator==(const PipelineDesc &other) const {
+    return program == other.program && vertexArray == other.vertexArray && blend == other.blend &&
+           depth == other.depth && raster == other.raster;
+  }
+  uint64_t hash() const;
+};
+
+// Immutable, interned pipeline state, only made by PipelineCache. Equal descriptions share one object, so
+// pipelines compare by address, and GlStateCache::bindPipeline() only issues the groups that differ from the
+// pipeline bound before.
+class PipelineState {
+public:
+  PipelineState(const PipelineState &) = delete;
+  PipelineState &operator=(const PipelineState &) = delete;
+
+  const PipelineDesc &desc() const { return description; }
+  uint64_t hash() const { return descHash; }
+  // Dense, in order of creation, small enough for sort keys
+  uint32_t id() const { return index; }
+
+private:
+  friend class PipelineCache;
+
+  const PipelineDesc description;
+  const uint64_t descHash;
+  const uint32_t index;
+
+  PipelineState(const PipelineDesc &description, uint64_t descHash, uint32_t index)
+      : description(description), descHash(descHash), index(index) {}
+};
+
+// Owns every pipeline, which stays valid as long as the cache
+class PipelineCache {
+public:
+  // The pipeline for desc, created on first request
+  const PipelineState *get(const PipelineDesc &desc);
+  size_t size() const { return count; }
+
+private:
+  // By hash, a bucket only holds more than one pipeline when hashes collide
+  std::unordered_map<uint64_t, std::vector<std::unique_ptr<PipelineState>>> pipelines;
+  size_t count = 0;
+};
+
+#endif
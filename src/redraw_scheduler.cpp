@@ -0,0 +1,67 @@
+#include "redraw_scheduler.hpp"
+#include <chrono>
+#include <cstdio>
+
+void RedrawStats::print() const {
+  printf("Redraw: %zu frames drawn, %zu idle wakeups, idle for %.2f s\n", framesDrawn, idleWakeups, idleSeconds);
+}
+
+RedrawScheduler::RedrawScheduler(bool onDemand, double idleTimeout) : onDemand(onDemand), idleTimeout(idleTimeout) {}
+
+RedrawScheduler::~RedrawScheduler() {
+  if (watched != nullptr) {
+    glfwSetWindowUserPointer(watched, nullptr);
+  }
+}
+
+void RedrawScheduler::watchInput(GLFWwindow *window) {
+  watched = window;
+  glfwSetWindowUserPointer(window, this);
+  glfwSetKeyCallback(window, [](GLFWwindow *window, int, int, int, int) { requestRedraw(window); });
+  glfwSetCharCallback(window, [](GLFWwindow *window, unsigned int) { requestRedraw(window); });
+  glfwSetMouseButtonCallback(window, [](GLFWwindow *window, int, int, int) { requestRedraw(window); });
+  glfwSetCursorPosCallback(window, [](GLFWwindow *window, double, double) { requestRedraw(window); });
+  glfwSetScrollCallback(window, [](GLFWwindow *window, double, double) { requestRedraw(window); });
+  glfwSetWindowRefreshCallback(window, [](GLFWwindow *window) { requestRedraw(window); });
+  glfwSetWindowFocusCallback(window, [](GLFWwindow *window, int) { requestRedraw(window); });
+  glfwSetWindowIconifyCallback(window, [](GLFWwindow *window, int) { requestRedraw(window); });
+}
+
+void RedrawScheduler::requestRedraw() {
+  // Only the request that finds the scene clean has to wake the main thread
+  if (!dirty.exchange(true, std::memory_order_acq_rel) && onDemand) {
+    glfwPostEmptyEvent();
+  }
+}
+
+void RedrawScheduler::requestRedraw(GLFWwindow *window) {
+  if (RedrawScheduler *scheduler = static_cast<RedrawScheduler *>(glfwGetWindowUserPointer(window))) {
+    scheduler->requestRedraw();
+  }
+}
+
+void RedrawScheduler::waitForFrame(GLFWwindow *window) {
+  if (!onDemand || animating) {
+    dirty.store(false, std::memory_order_relaxed);
+    counts.framesDrawn++;
+    return;
+  }
+
+  // Requests made while drawing the last frame left the scene dirty again, and are drawn without waiting
+  glfwPollEvents();
+  bool draw = dirty.exchange(false, std::memory_order_acq_rel);
+  auto start = std::chrono::steady_clock::now();
+  while (!draw && !glfwWindowShouldClose(window)) {
+    glfwWaitEventsTimeout(idleTimeout);
+    draw = dirty.exchange(false, std::memory_order_acq_rel);
+    counts.idleWakeups += !draw;
+  }
+  counts.idleSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  counts.framesDrawn += draw;
+}
+
+RedrawStats RedrawScheduler::takeStats() {
+  RedrawStats stats = counts;
+  counts = {};
+  return stats;
+}
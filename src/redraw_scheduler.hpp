@@ -0,0 +1,61 @@
+#ifndef REDRAW_SCHEDULER_H
+#define REDRAW_SCHEDULER_H
+
+#include <GLFW/glfw3.h>
+#include <atomic>
+#include <cstddef>
+
+struct RedrawStats {
+  size_t framesDrawn = 0;
+  // Times the loop woke up without anything to draw, timeouts included
+  size_t idleWakeups = 0;
+  double idleSeconds = 0.0;
+
+  void print() const;
+};
+
+// Decides when the render loop draws. Continuous scheduling draws every iteration. On demand, a frame is only drawn
+// when something marked the scene dirty, such as input, a resize or an asset update, or while an animation runs. The
+// rest of the time the main thread sleeps in glfwWaitEventsTimeout. Any thread may request a redraw, requests post
+// an empty event so the sleeping main thread wakes up at once.
+class RedrawScheduler {
+public:
+  // The timeout only bounds how long a lost wakeup could go unnoticed, wakeups normally come from events
+  explicit RedrawScheduler(bool onDemand, double idleTimeout = 0.5);
+  // Unregisters from the watched window
+  ~RedrawScheduler();
+
+  RedrawScheduler(const RedrawScheduler &) = delete;
+  RedrawScheduler &operator=(const RedrawScheduler &) = delete;
+
+  // Register as the window's user pointer and mark the scene dirty on any input or expose event. Other callbacks
+  // of the window, such as the framebuffer size one, should call requestRedraw(window) themselves.
+  void watchInput(GLFWwindow *window);
+
+  // Any thread
+  void requestRedraw();
+  // From GLFW callbacks, a no-op for windows without a scheduler
+  static void requestRedraw(GLFWwindow *window);
+
+  // Main thread. An animating scene draws every iteration like continuous scheduling does.
+  void setAnimating(bool animating) { this->animating = animating; }
+  bool isOnDemand() const { return onDemand; }
+
+  // Main thread, at the top of the loop. Processes events, and sleeps while there is nothing to draw. Returns once
+  // a frame should be drawn or the window should close.
+  void waitForFrame(GLFWwindow *window);
+
+  // Counts since the last call
+  RedrawStats takeStats();
+
+private:
+  bool onDemand;
+  double idleTimeout;
+  bool animating = false;
+  GLFWwindow *watched = nullptr;
+  // Starts dirty, the first frame has never been drawn
+  std::atomic<bool> dirty{true};
+  RedrawStats counts;
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include "render_thread.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+std::vector<CommandBuffer> &FrameCommands::recordBuffers(size_t count) {
+  if (bufferSetsUsed == bufferSets.size()) {
+    bufferSets.emplace_back();
+  }
+  size_t set = bufferSetsUsed++;
+  bufferSets[set].resize(count);
+  for (CommandBuffer &buffer : bufferSets[set]) {
+    buffer.clear();
+  }
+  // By index, growing bufferSets moves the inner vectors
+  record([this, set]() { executeInOrder(bufferSets[set]); });
+  return bufferSets[set];
+}
+
+void FrameCommands::clear() {
+  commands.clear();
+  bufferSetsUsed = 0;
+}
+
+void FrameCommands::execute() const {
+  for (const std::function<void()> &command : commands) {
+    command();
+  }
+}
+
+void RenderThreadStats::print() const {
+  printf("Render thread: %zu frames, main thread waited %.2f ms, render thread idle %.2f ms\n",
+         frames,
+         recordWaitSeconds * 1000.0,
+         renderIdleSeconds * 1000.0);
+}
+
+RenderThread::RenderThread(GLFWwindow *window, size_t maxFramesAhead)
+    : window(window), queue(std::max<size_t>(maxFramesAhead, 1) + 1) {
+  // A context can only be current on one thread at a time
+  glfwMakeContextCurrent(nullptr);
+  thread = std::thread(&RenderThread::run, this);
+}
+
+RenderThread::~RenderThread() {
+  stopping.store(true, std::memory_order_release);
+  {
+    std::lock_guard<std::mutex> lock(wakeMutex);
+  }
+  wake.notify_one();
+  thread.join();
+  glfwMakeContextCurrent(window);
+}
+
+FrameCommands &RenderThread::beginFrame() {
+  auto start = std::chrono::steady_clock::now();
+  while ((recording = queue.acquireWrite()) == nullptr) {
+    if (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < IDLE_SPIN_SECONDS) {
+      std::this_thread::yield();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    freed.wait(lock, [this]() { return queue.acquireWrite() != nullptr; });
+  }
+  waitNanoseconds +=
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  recording->clear();
+  return *recording;
+}
+
+void RenderThread::endFrame() {
+  if (recording != nullptr) {
+    queue.publish();
+    recording = nullptr;
+    // Taking the lock orders the publish before the check of a GL thread that is about to sleep
+    {
+      std::lock_guard<std::mutex> lock(wakeMutex);
+    }
+    wake.notify_one();
+  }
+}
+
+RenderThreadStats RenderThread::takeStats() {
+  RenderThreadStats stats;
+  stats.frames = framesRendered.exchange(0, std::memory_order_relaxed);
+  stats.renderIdleSeconds = idleNanoseconds.exchange(0, std::memory_order_relaxed) * 1e-9;
+  stats.recordWaitSeconds = waitNanoseconds * 1e-9;
+  waitNanoseconds = 0;
+  return stats;
+}
+
+void RenderThread::run() {
+  glfwMakeContextCurrent(window);
+  while (true) {
+    auto start = std::chrono::steady_clock::now();
+    FrameCommands *frame;
+    // Check for a frame before the stop flag, so every frame published before stopping still renders
+    while ((frame = queue.acquireRead()) == nullptr && !stopping.load(std::memory_order_acquire)) {
+      if (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < IDLE_SPIN_SECONDS) {
+        std::this_thread::yield();
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(wakeMutex);
+      wake.wait(lock, [this]() {
+        return queue.acquireRead() != nullptr || stopping.load(std::memory_order_acquire);
+      });
+    }
+    if (frame == nullptr && (frame = queue.acquireRead()) == nullptr) {
+      break;
+    }
+    idleNanoseconds.fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(),
+        std::memory_order_relaxed);
+
+    frame->execute();
+    glfwSwapBuffers(window);
+    queue.release();
+    framesRendered.fetch_add(1, std::memory_order_relaxed);
+    // Same ordering as endFrame(), for a main thread about to sleep on a full queue
+    {
+      std::lock_guard<std::mutex> lock(wakeMutex);
+    }
+    freed.notify_one();
+  }
+  glfwMakeContextCurrent(nullptr);
+}
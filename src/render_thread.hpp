@@ -0,0 +1,125 @@
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include "command_buffer.hpp"
+#include <glad/gl.h>
+#include <GLFW/glfw3.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// GL work for one frame, recorded on the main thread and executed in order on the thread that owns the context.
+// Commands capture everything that changes between frames by value, so recording the next frame never races with
+// executing this one.
+class FrameCommands {
+public:
+  void record(std::function<void()> command) { commands.push_back(std::move(command)); }
+  // count empty command buffers replayed in index order at this point of the frame. They stay valid until the frame
+  // is cleared, and are reused by later frames in the same slot, so filling them every frame stops allocating.
+  std::vector<CommandBuffer> &recordBuffers(size_t count);
+  void execute() const;
+  // Keeps the capacity, slots are reused frame after frame
+  void clear();
+  size_t size() const { return commands.size(); }
+
+private:
+  std::vector<std::function<void()>> commands;
+  std::vector<std::vector<CommandBuffer>> bufferSets;
+  size_t bufferSetsUsed = 0;
+};
+
+// Lock-free single producer, single consumer ring of reusable slots. The producer fills the slot from
+// acquireWrite() and hands it over with publish(), the consumer returns it with release() once done. Indices only
+// ever grow, so full and empty are told apart without a spare slot.
+template <typename T> class FrameQueue {
+public:
+  explicit FrameQueue(size_t capacity) : slots(capacity) {}
+
+  FrameQueue(const FrameQueue &) = delete;
+  FrameQueue &operator=(const FrameQueue &) = delete;
+
+  // nullptr while every slot is recorded or being executed
+  T *acquireWrite() {
+    size_t head = written.load(std::memory_order_relaxed);
+    return head - read.load(std::memory_order_acquire) == slots.size() ? nullptr : &slots[head % slots.size()];
+  }
+  void publish() { written.store(written.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+  // nullptr while no published slot is waiting
+  T *acquireRead() {
+    size_t tail = read.load(std::memory_order_relaxed);
+    return written.load(std::memory_order_acquire) == tail ? nullptr : &slots[tail % slots.size()];
+  }
+  void release() { read.store(read.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+  size_t capacity() const { return slots.size(); }
+
+private:
+  std::vector<T> slots;
+  // Kept on separate cache lines, each is written by one side only
+  alignas(64) std::atomic<size_t> written{0};
+  alignas(64) std::atomic<size_t> read{0};
+};
+
+struct RenderThreadStats {
+  size_t frames = 0;
+  // Main thread blocked because it was maxFramesAhead frames ahead of the GL thread
+  double recordWaitSeconds = 0.0;
+  // GL thread waiting for the next frame to be recorded
+  double renderIdleSeconds = 0.0;
+
+  void print() const;
+};
+
+// Takes the window's GL context to a thread of its own, which executes recorded frames and swaps buffers. The main
+// thread keeps polling events and records frame N+1 while frame N renders, so a frame costs max(simulate, render)
+// instead of their sum. beginFrame() blocks once the main thread is maxFramesAhead frames ahead, which bounds input
+// latency: 1 is double buffering, 2 triple buffering.
+//
+// Waiting for a frame, the GL thread spins for IDLE_SPIN_SECONDS and then sleeps until one is published, so a loop
+// that stops recording frames also stops using the CPU. The main thread waits for a free slot the same way, so it does
+// not burn a core while the GL thread is blocked on vsync.
+//
+// Nothing else may call GL while the render thread exists. Destroying it executes the frames still queued and makes
+// the context current on the destroying thread again.
+class RenderThread {
+public:
+  static constexpr double IDLE_SPIN_SECONDS = 0.001;
+
+  RenderThread(GLFWwindow *window, size_t maxFramesAhead = 1);
+  ~RenderThread();
+
+  RenderThread(const RenderThread &) = delete;
+  RenderThread &operator=(const RenderThread &) = delete;
+
+  // The next free frame, empty, waiting for one if needed
+  FrameCommands &beginFrame();
+  // Hand the frame from beginFrame() to the GL thread
+  void endFrame();
+
+  // Counts since the last call
+  RenderThreadStats takeStats();
+
+private:
+  GLFWwindow *window;
+  FrameQueue<FrameCommands> queue;
+  FrameCommands *recording = nullptr;
+  std::atomic<bool> stopping{false};
+  std::mutex wakeMutex;
+  // GL thread waiting for a published frame, main thread waiting for a released slot
+  std::condition_variable wake;
+  std::condition_variable freed;
+  std::atomic<size_t> framesRendered{0};
+  std::atomic<int64_t> idleNanoseconds{0};
+  int64_t waitNanoseconds = 0;
+  std::thread thread;
+
+  void run();
+};
+
+#endif
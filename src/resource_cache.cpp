@@ -0,0 +1,74 @@
+#include "resource_cache.hpp"
+#include "hash.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+
+std::shared_ptr<Texture> ResourceCache::texture(const Image &image, const TextureParams &params) {
+  cacheStats.textureRequests++;
+
+  // Key on the sampling parameters and shape too, the same pixels sampled differently are different textures
+  uint64_t key = hashBytes(image.pixels.get(), image.byteSize());
+  key = hashCombine(key, ((uint64_t)image.width << 32) | (uint64_t)image.height);
+  key = hashCombine(key, (uint64_t)image.channels);
+  key = hashCombine(key, ((uint64_t)params.wrap << 32) | (uint64_t)params.mipmaps);
+  key = hashCombine(key, ((uint64_t)params.minFilter << 32) | (uint64_t)params.magFilter);
+
+  collectIfGrown();
+  std::weak_ptr<Texture> &entry = textures[key];
+  // A texture respecified since, or a hash collision, no longer matches and is replaced in the cache
+  std::shared_ptr<Texture> existing = entry.lock();
+  if (existing && existing->matches(image) && existing->params == params) {
+    cacheStats.textureHits++;
+    cacheStats.textureBytesSaved += existing->gpuBytes();
+    return existing;
+  }
+
+  auto created = std::make_shared<Texture>(image, params);
+  entry = created;
+  return created;
+}
+
+std::shared_ptr<Buffer> ResourceCache::buffer(const void *data, size_t size) {
+  cacheStats.bufferRequests++;
+
+  uint64_t key = hashBytes(data, size);
+  collectIfGrown();
+  std::weak_ptr<Buffer> &entry = buffers[key];
+  std::shared_ptr<Buffer> existing = entry.lock();
+  if (existing && existing->size == size) {
+    cacheStats.bufferHits++;
+    cacheStats.bufferBytesSaved += existing->size;
+    return existing;
+  }
+
+  auto created = std::make_shared<Buffer>(size, data);
+  entry = created;
+  return created;
+}
+
+void ResourceCache::collect() {
+  for (auto it = textures.begin(); it != textures.end();) {
+    it = it->second.expired() ? textures.erase(it) : std::next(it);
+  }
+  for (auto it = buffers.begin(); it != buffers.end();) {
+    it = it->second.expired() ? buffers.erase(it) : std::next(it);
+  }
+  collectAt = std::max(MIN_COLLECT_ENTRIES, (textures.size() + buffers.size()) * 2);
+}
+
+void ResourceCache::collectIfGrown() {
+  if (textures.size() + buffers.size() >= collectAt) {
+    collect();
+  }
+}
+
+void ResourceCacheStats::print() const {
+  printf("Resource cache: %zu/%zu texture hits (%.1f KiB saved), %zu/%zu buffer hits (%.1f KiB saved)\n",
+         textureHits,
+         textureRequests,
+         textureBytesSaved / 1024.0,
+         bufferHits,
+         bufferRequests,
+         bufferBytesSaved / 1024.0);
+}
@@ -0,0 +1,50 @@
+#ifndef RESOURCE_CACHE_H
+#define RESOURCE_CACHE_H
+
+#include "buffer.hpp"
+#include "image_loader.hpp"
+#include "texture.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+struct ResourceCacheStats {
+  size_t textureRequests = 0;
+  size_t textureHits = 0;
+  size_t bufferRequests = 0;
+  size_t bufferHits = 0;
+  // Video memory that would have been allocated without deduplication
+  size_t textureBytesSaved = 0;
+  size_t bufferBytesSaved = 0;
+
+  void print() const;
+};
+
+// Content addressed cache for GPU resources. Identical pixels or buffer contents map to one shared GL object, which
+// is released once the last owner drops its reference. Hits are keyed on a 64 bit hash of the contents and only
+// checked against the size, dimensions and parameters, so two different contents of the same shape whose hashes
+// collide would silently share one object.
+class ResourceCache {
+public:
+  std::shared_ptr<Texture> texture(const Image &image, const TextureParams &params = TextureParams());
+  std::shared_ptr<Buffer> buffer(const void *data, size_t size);
+
+  // Forget entries whose resources have been destroyed. Also runs by itself whenever the entries double since the
+  // last time, so dead entries never outnumber live ones for long.
+  void collect();
+  const ResourceCacheStats &stats() const { return cacheStats; }
+
+private:
+  static constexpr size_t MIN_COLLECT_ENTRIES = 64;
+
+  std::unordered_map<uint64_t, std::weak_ptr<Texture>> textures;
+  std::unordered_map<uint64_t, std::weak_ptr<Buffer>> buffers;
+  ResourceCacheStats cacheStats;
+  // Entry count of both maps that triggers the next collect()
+  size_t collectAt = MIN_COLLECT_ENTRIES;
+
+  void collectIfGrown();
+};
+
+#endif
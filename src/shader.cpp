@@ -1,84 +1,105 @@
 #include "shader.hpp"
+#include "gl_state.hpp"
 #include "glad/gl.h"
 #include <filesystem>
 #include <fstream>
+#include <initializer_list>
 #include <iostream>
 #include <sstream>
 #include <string>
 
-Shader::Shader(const char *vertexPath, const char *fragmentPath) {
-  std::string vertexSource_str, fragmentSource_str;
-  std::ifstream vShaderFile, fShaderFile;
+// Read a whole shader file, reporting where it is loaded from
+static std::string readSource(const char *description, const char *path) {
+  std::cout << "Loading " << description << " from path: " << std::filesystem::current_path().string() << "/" << path
+            << std::endl;
 
-  vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-  fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-
-  std::cout << "Loading vertex shader from path: " << std::filesystem::current_path().string() << "/" << vertexPath << std::endl;
-  std::cout << "Loading fragment shader from path: " << std::filesystem::current_path().string() << "/" << fragmentPath << std::endl;
-
-  // Read vertex and shader files
-  // ----------------------------
+  std::ifstream file;
+  file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
   try {
-    vShaderFile.open(vertexPath);
-    fShaderFile.open(fragmentPath);
-    std::stringstream vShaderStream, fShaderStream;
-    // Read file's buffer contents into respective shader streams
-    vShaderStream << vShaderFile.rdbuf();
-    fShaderStream << fShaderFile.rdbuf();
-    // Close file handles
-    vShaderFile.close();
-    fShaderFile.close();
-
-    vertexSource_str = vShaderStream.str();
-    fragmentSource_str = fShaderStream.str();
-  } catch (std::ifstream::failure e) {
+    file.open(path);
+    std::stringstream stream;
+    // Read file's buffer contents into the shader stream
+    stream << file.rdbuf();
+    file.close();
+    return stream.str();
+  } catch (const std::ifstream::failure &e) {
     std::cout << "ERROR::SHADER::FILE_NOT_READ\n" << e.what() << std::endl;
   }
+  return "";
+}
 
-  const char *vertexShaderSource = vertexSource_str.c_str();
-  const char *fragmentShaderSource = fragmentSource_str.c_str();
+// stage names the shader in the error message, e.g. "VERTEX"
+static GLuint compileStage(GLenum type, const std::string &source, const char *stage) {
+  const char *sourcePointer = source.c_str();
+  GLuint shader = glCreateShader(type);
+  glShaderSource(shader, 1, &sourcePointer, NULL);
+  glCompileShader(shader);
 
-  // Build and compile the shader program
-  // ------------------------------------
-  GLuint vertexShader, fragmentShader;
   GLint success;
   GLchar infoLog[512];
+  glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+  if (!success) {
+    glGetShaderInfoLog(shader, std::size(infoLog), NULL, infoLog);
+    std::cout << "ERROR::SHADER::" << stage << "::COMPILATION_FAILED\n" << infoLog << std::endl;
+  }
+  return shader;
+}
 
-  vertexShader = glCreateShader(GL_VERTEX_SHADER);
-  glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-  glCompileShader(vertexShader);
+// Link the attached shaders, then delete them. After linking they are obselete.
+static void linkProgram(GLuint program, std::initializer_list<GLuint> shaders) {
+  glLinkProgram(program);
 
-  glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
+  GLint success;
+  GLchar infoLog[512];
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
   if (!success) {
-    glGetShaderInfoLog(vertexShader, std::size(infoLog), NULL, infoLog);
-    std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+    glGetProgramInfoLog(program, std::size(infoLog), NULL, infoLog);
+    std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+  }
+  for (GLuint shader : shaders) {
+    glDeleteShader(shader);
   }
+}
 
-  fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-  glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-  glCompileShader(fragmentShader);
-  glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-  if (!success) {
-    glGetShaderInfoLog(fragmentShader, std::size(infoLog), NULL, infoLog);
-    std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+Shader::Shader(const char *vertexPath, const char *fragmentPath, const std::string &vertexDeclarations) {
+  // Read vertex and shader files
+  // ----------------------------
+  std::string vertexSource = readSource("vertex shader", vertexPath);
+  std::string fragmentSource = readSource("fragment shader", fragmentPath);
+
+  // #version has to stay the first line, so declarations go right after it
+  if (!vertexDeclarations.empty() && !vertexSource.empty()) {
+    size_t versionEnd = vertexSource.find('\n');
+    vertexSource.insert(versionEnd == std::string::npos ? vertexSource.size() : versionEnd + 1, vertexDeclarations);
   }
 
+  // Build and compile the shader program
+  // ------------------------------------
+  GLuint vertexShader = compileStage(GL_VERTEX_SHADER, vertexSource, "VERTEX");
+  GLuint fragmentShader = compileStage(GL_FRAGMENT_SHADER, fragmentSource, "FRAGMENT");
+
   id = glCreateProgram();
   glAttachShader(id, vertexShader);
   glAttachShader(id, fragmentShader);
-  glLinkProgram(id);
-  glGetProgramiv(id, GL_LINK_STATUS, &success);
-  if (!success) {
-    glGetProgramInfoLog(id, std::size(infoLog), NULL, infoLog);
-    std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-  }
+  linkProgram(id, {vertexShader, fragmentShader});
+}
 
-  // After linking both shaders, both shaders are now obselete, so we can delete them
-  glDeleteShader(vertexShader);
-  glDeleteShader(fragmentShader);
+Shader Shader::capture(const char *vertexPath, const std::vector<const char *> &capturedVaryings) {
+  GLuint vertexShader = compileStage(GL_VERTEX_SHADER, readSource("capture shader", vertexPath), "VERTEX");
+
+  // The captured outputs have to be named before linking
+  Shader shader;
+  shader.id = glCreateProgram();
+  glAttachShader(shader.id, vertexShader);
+  glTransformFeedbackVaryings(
+      shader.id, (GLsizei)capturedVaryings.size(), capturedVaryings.data(), GL_INTERLEAVED_ATTRIBS);
+  linkProgram(shader.id, {vertexShader});
+  return shader;
 }
 
-void Shader::use() { glUseProgram(id); }
+void Shader::use() { glState().useProgram(id); }
+
+GLint Shader::uniformLocation(const std::string &name) const { return glGetUniformLocation(id, name.c_str()); }
 
 void Shader::setUniform1b(const std::string &name, GLboolean value) {
   glUniform1i(glGetUniformLocation(id, name.c_str()), (int)value);
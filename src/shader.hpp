@@ -3,18 +3,27 @@
 
 #include <glad/gl.h>
 #include <string>
+#include <vector>
 
 class Shader {
 public:
   // Program ID
   GLuint id;
-  Shader(const char *vertexPath, const char *fragmentPath);
+  // vertexDeclarations is inserted after the #version line of the vertex shader, e.g. generated attribute inputs
+  Shader(const char *vertexPath, const char *fragmentPath, const std::string &vertexDeclarations = "");
+  // Vertex-only program whose capturedVaryings (e.g. "gl_Position") are written interleaved to transform feedback
+  static Shader capture(const char *vertexPath, const std::vector<const char *> &capturedVaryings);
   void use();
+  // For recording uniform writes into a CommandBuffer, look up on the GL thread
+  GLint uniformLocation(const std::string &name) const;
   // Utility uniform var functions
   void setUniform1b(const std::string &name, GLboolean value);
   void setUniform1i(const std::string &name, GLint value);
   void setUniform1f(const std::string &name, GLfloat value);
   void setUniform4f(const std::string &name, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3);
+
+private:
+  Shader() = default;
 };
 
 #endif
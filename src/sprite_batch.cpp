@@ -0,0 +1,138 @@
+#include "sprite_batch.hpp"
+#include "draw_queue.hpp"
+#include "gl_state.hpp"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// Sort key bit layout, most significant first
+static constexpr int LAYER_SHIFT = 56;
+static constexpr int SHADER_SHIFT = 48;
+static constexpr int TEXTURE_SHIFT = 32;
+static constexpr uint32_t SHADER_MASK = 0xff;
+static constexpr uint32_t TEXTURE_MASK = 0xffff;
+
+// Map a float onto an unsigned integer with the same ordering
+static uint32_t orderedBits(float value) {
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+}
+
+SpriteBatch::SpriteBatch() {
+  std::vector<uint16_t> indices;
+  indices.reserve(MAX_BATCH_SPRITES * 6);
+  for (size_t i = 0; i < MAX_BATCH_SPRITES; i++) {
+    uint16_t first = (uint16_t)(i * 4);
+    // Corners go top right, bottom right, bottom left, top left like the quad in main.cpp
+    indices.insert(indices.end(), {first, (uint16_t)(first + 1), (uint16_t)(first + 3)});
+    indices.insert(indices.end(), {(uint16_t)(first + 1), (uint16_t)(first + 2), (uint16_t)(first + 3)});
+  }
+  quadIndices = std::make_unique<Buffer>(indices.size() * sizeof(uint16_t), indices.data());
+  glState().vertexArrayElementBuffer(vertexArray.id, quadIndices->id);
+}
+
+uint64_t SpriteBatch::sortKey(const Sprite &sprite) {
+  // Ids are handed out in order of first use, so they stay stable for the lifetime of the batch
+  auto shader = shaderIds.try_emplace(sprite.shader, (uint32_t)shaderIds.size()).first->second;
+  auto texture = textureIds.try_emplace(sprite.texture, (uint32_t)textureIds.size()).first->second;
+  return ((uint64_t)sprite.layer << LAYER_SHIFT) | ((uint64_t)(shader & SHADER_MASK) << SHADER_SHIFT) |
+         ((uint64_t)(texture & TEXTURE_MASK) << TEXTURE_SHIFT) | orderedBits(sprite.depth);
+}
+
+void SpriteBatch::submit(const Sprite &sprite) {
+  keys.emplace_back(sortKey(sprite), (uint32_t)sprites.size());
+  sprites.push_back(sprite);
+}
+
+void SpriteBatch::flush(StreamBuffer &stream) {
+  lastStats = SpriteBatchStats();
+  if (sprites.empty()) {
+    return;
+  }
+
+  radixSort(keys, sortScratch);
+
+  StreamAllocation vertices = stream.allocate(sprites.size() * 4 * sizeof(TexturedVertex), sizeof(TexturedVertex));
+  if (!vertices.valid()) {
+    std::cout << "ERROR::SPRITE_BATCH::STREAM_BUFFER_FULL" << std::endl;
+    sprites.clear();
+    keys.clear();
+    return;
+  }
+
+  // Expand every sprite to four corners in sorted order
+  TexturedVertex *out = static_cast<TexturedVertex *>(vertices.data);
+  for (const auto &key : keys) {
+    const Sprite &sprite = sprites[key.second];
+    float c = std::cos(sprite.rotation), s = std::sin(sprite.rotation);
+    float halfWidth = sprite.size[0] * 0.5f, halfHeight = sprite.size[1] * 0.5f;
+    const float corners[4][2] = {{1.0f, 1.0f}, {1.0f, -1.0f}, {-1.0f, -1.0f}, {-1.0f, 1.0f}};
+    for (const auto &corner : corners) {
+      float x = corner[0] * halfWidth, y = corner[1] * halfHeight;
+      TexturedVertex &vertex = *out++;
+      vertex.position[0] = sprite.position[0] + x * c - y * s;
+      vertex.position[1] = sprite.position[1] + x * s + y * c;
+      vertex.position[2] = 0.0f;
+      std::memcpy(vertex.colour, sprite.colour, sizeof(vertex.colour));
+      vertex.texCoord[0] = corner[0] > 0.0f ? sprite.uvRect[2] : sprite.uvRect[0];
+      vertex.texCoord[1] = corner[1] > 0.0f ? sprite.uvRect[3] : sprite.uvRect[1];
+    }
+  }
+
+  // Walk the sorted sprites and cut a new batch wherever state changes or the batch is full
+  size_t runStart = 0;
+  for (size_t i = 1; i <= keys.size(); i++) {
+    if (i < keys.size()) {
+      const Sprite &previous = sprites[keys[i - 1].second];
+      const Sprite &next = sprites[keys[i].second];
+      BatchBreak reason;
+      if (next.shader != previous.shader) {
+        reason = BatchBreak::Shader;
+      } else if (next.texture != previous.texture) {
+        reason = BatchBreak::Texture;
+      } else if (i - runStart >= MAX_BATCH_SPRITES) {
+        reason = BatchBreak::Capacity;
+      } else {
+        continue;
+      }
+      lastStats.breaks[(size_t)reason]++;
+    }
+    drawRun(vertices, runStart, i - runStart);
+    runStart = i;
+  }
+
+  lastStats.sprites = sprites.size();
+  sprites.clear();
+  keys.clear();
+}
+
+void SpriteBatch::drawRun(const StreamAllocation &vertices, size_t firstSprite, size_t count) {
+  const Sprite &sprite = sprites[keys[firstSprite].second];
+  if (sprite.shader != nullptr) {
+    sprite.shader->use();
+  }
+  if (sprite.texture != nullptr) {
+    sprite.texture->bind();
+  }
+
+  // Point the vertex binding at the batch's first corner, so the shared 16 bit indices start from zero again
+  glState().bindVertexArray(vertexArray.id);
+  glState().vertexArrayVertexBuffer(vertexArray.id,
+                                    0,
+                                    vertices.buffer,
+                                    vertices.offset + (GLintptr)(firstSprite * 4 * sizeof(TexturedVertex)),
+                                    TexturedFormat::stride);
+  glDrawElements(GL_TRIANGLES, (GLsizei)(count * 6), GL_UNSIGNED_SHORT, nullptr);
+  lastStats.batches++;
+}
+
+void SpriteBatchStats::print() const {
+  printf("Sprite batch: %zu sprites in %zu batches, breaks: %zu shader, %zu texture, %zu capacity\n",
+         sprites,
+         batches,
+         breaks[(size_t)BatchBreak::Shader],
+         breaks[(size_t)BatchBreak::Texture],
+         breaks[(size_t)BatchBreak::Capacity]);
+}
@@ -0,0 +1,75 @@
+#ifndef SPRITE_BATCH_H
+#define SPRITE_BATCH_H
+
+#include "buffer.hpp"
+#include "mesh.hpp"
+#include "shader.hpp"
+#include "stream_buffer.hpp"
+#include "texture.hpp"
+#include "vertex_format.hpp"
+#include <glad/gl.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+struct Sprite {
+  // Drawn with texture.vert/texture.frag or any shader reading TexturedFormat
+  Shader *shader = nullptr;
+  const Texture *texture = nullptr;
+  // Centre in clip space
+  GLfloat position[2] = {0.0f, 0.0f};
+  GLfloat size[2] = {1.0f, 1.0f};
+  // Radians, counter clockwise
+  GLfloat rotation = 0.0f;
+  // Sub-rectangle of the texture as (u0, v0, u1, v1)
+  GLfloat uvRect[4] = {0.0f, 0.0f, 1.0f, 1.0f};
+  GLfloat colour[3] = {1.0f, 1.0f, 1.0f};
+  // Higher layers draw on top, depth orders sprites within a layer (lower first)
+  uint8_t layer = 0;
+  GLfloat depth = 0.0f;
+};
+
+enum class BatchBreak { Shader, Texture, Capacity, Count };
+
+struct SpriteBatchStats {
+  size_t sprites = 0;
+  size_t batches = 0;
+  // Why each batch after the first had to start
+  size_t breaks[(size_t)BatchBreak::Count] = {};
+
+  void print() const;
+};
+
+// Collects sprites for a frame, sorts them by a packed (layer, shader, texture, depth) key and draws each run that
+// shares a shader and texture with one glDrawElements. Vertices are written straight into a StreamBuffer.
+class SpriteBatch {
+public:
+  // One batch addresses at most 65536 vertices, so a shared 16 bit quad index buffer covers every batch
+  static constexpr size_t MAX_BATCH_SPRITES = 65536 / 4;
+
+  SpriteBatch();
+
+  void submit(const Sprite &sprite);
+  // Sort and draw everything submitted since the last flush
+  void flush(StreamBuffer &stream);
+
+  const SpriteBatchStats &stats() const { return lastStats; }
+
+private:
+  VertexArray<TexturedFormat> vertexArray;
+  std::unique_ptr<Buffer> quadIndices;
+
+  std::vector<Sprite> sprites;
+  std::vector<std::pair<uint64_t, uint32_t>> keys, sortScratch;
+  // Small ids for shaders and textures so they fit in the sort key
+  std::unordered_map<const void *, uint32_t> shaderIds;
+  std::unordered_map<const void *, uint32_t> textureIds;
+  SpriteBatchStats lastStats;
+
+  uint64_t sortKey(const Sprite &sprite);
+  void drawRun(const StreamAllocation &vertices, size_t firstSprite, size_t count);
+};
+
+#endif
@@ -0,0 +1,98 @@
+#include "stream_buffer.hpp"
+#include "gl_state.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+StreamBuffer::StreamBuffer(size_t frameSize, unsigned framesInFlight)
+    : regionSize(frameSize), framesInFlight(std::clamp(framesInFlight, 1u, MAX_FRAMES_IN_FLIGHT)) {
+  GLint alignment;
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  uniformAlignment = (size_t)alignment;
+  glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  storageAlignment = (size_t)alignment;
+
+  // Keep every region start aligned for any binding target
+  size_t regionAlignment = std::max(uniformAlignment, storageAlignment);
+  regionSize = (regionSize + regionAlignment - 1) / regionAlignment * regionAlignment;
+
+  GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  glCreateBuffers(1, &id);
+  GLsizeiptr totalSize = (GLsizeiptr)(regionSize * this->framesInFlight);
+  glNamedBufferStorage(id, totalSize, nullptr, flags);
+  mapped = static_cast<unsigned char *>(glMapNamedBufferRange(id, 0, totalSize, flags));
+  if (mapped == nullptr) {
+    std::cout << "ERROR::STREAM_BUFFER::MAP_FAILED" << std::endl;
+  }
+}
+
+StreamBuffer::~StreamBuffer() {
+  for (GLsync fence : fences) {
+    if (fence != nullptr) {
+      glDeleteSync(fence);
+    }
+  }
+  glUnmapNamedBuffer(id);
+  glState().forgetBuffer(id);
+  glDeleteBuffers(1, &id);
+}
+
+void StreamBuffer::beginFrame() {
+  region = (region + 1) % framesInFlight;
+  regionUsed = 0;
+  streamStats.frames++;
+
+  GLsync &fence = fences[region];
+  if (fence == nullptr) {
+    return;
+  }
+
+  // Poll first, a signalled fence is the common case and should not count as a wait
+  GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+  if (result == GL_TIMEOUT_EXPIRED) {
+    streamStats.fenceWaits++;
+    auto waitStart = std::chrono::steady_clock::now();
+    do {
+      result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    } while (result == GL_TIMEOUT_EXPIRED);
+    streamStats.fenceWaitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count();
+  }
+  if (result == GL_WAIT_FAILED) {
+    std::cout << "ERROR::STREAM_BUFFER::FENCE_WAIT_FAILED" << std::endl;
+  }
+  glDeleteSync(fence);
+  fence = nullptr;
+}
+
+void StreamBuffer::endFrame() {
+  fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  streamStats.peakFrameBytes = std::max(streamStats.peakFrameBytes, regionUsed);
+}
+
+StreamAllocation StreamBuffer::allocate(size_t size, size_t alignment) {
+  size_t offset = (regionUsed + alignment - 1) / alignment * alignment;
+  if (mapped == nullptr || offset + size > regionSize) {
+    streamStats.failedAllocations++;
+    return StreamAllocation();
+  }
+  regionUsed = offset + size;
+  streamStats.bytesAllocated += size;
+
+  StreamAllocation allocation;
+  allocation.buffer = id;
+  allocation.offset = (GLintptr)(region * regionSize + offset);
+  allocation.data = mapped + allocation.offset;
+  allocation.size = size;
+  return allocation;
+}
+
+void StreamBufferStats::print() const {
+  printf("Stream buffer: %zu frames, %zu fence waits (%.3f ms), %.1f KiB allocated, peak %.1f KiB/frame, %zu failed\n",
+         frames,
+         fenceWaits,
+         fenceWaitSeconds * 1000.0,
+         bytesAllocated / 1024.0,
+         peakFrameBytes / 1024.0,
+         failedAllocations);
+}
@@ -0,0 +1,77 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <glad/gl.h>
+#include <cstddef>
+#include <cstring>
+
+// Sub-allocation inside the current frame's region of a StreamBuffer. Write through data, then source GL calls from
+// buffer at offset.
+struct StreamAllocation {
+  void *data = nullptr;
+  GLuint buffer = 0;
+  GLintptr offset = 0;
+  size_t size = 0;
+
+  bool valid() const { return data != nullptr; }
+};
+
+struct StreamBufferStats {
+  size_t frames = 0;
+  // Frames that found the GPU still reading their region and had to block on its fence
+  size_t fenceWaits = 0;
+  double fenceWaitSeconds = 0.0;
+  size_t bytesAllocated = 0;
+  size_t peakFrameBytes = 0;
+  // Requests that did not fit in the frame's region
+  size_t failedAllocations = 0;
+
+  void print() const;
+};
+
+// Ring of framesInFlight equal regions in one persistently mapped buffer. The CPU writes frame N's region while the
+// GPU still reads the regions of earlier frames, and a fence per region stops the CPU from lapping the GPU. Uploads
+// become a memcpy into mapped memory with no glBufferSubData calls.
+class StreamBuffer {
+public:
+  GLuint id = 0;
+  // Required offset alignment for binding ranges as uniform or storage buffers
+  size_t uniformAlignment = 256;
+  size_t storageAlignment = 256;
+
+  StreamBuffer(size_t frameSize, unsigned framesInFlight = 3);
+  ~StreamBuffer();
+
+  StreamBuffer(const StreamBuffer &) = delete;
+  StreamBuffer &operator=(const StreamBuffer &) = delete;
+
+  // Move to the next region, waiting for the GPU to finish the frame that last used it
+  void beginFrame();
+  // Fence the commands that read this frame's region. Call after the last draw that sources it.
+  void endFrame();
+
+  StreamAllocation allocate(size_t size, size_t alignment = 16);
+  StreamAllocation upload(const void *data, size_t size, size_t alignment = 16) {
+    StreamAllocation allocation = allocate(size, alignment);
+    if (allocation.valid()) {
+      std::memcpy(allocation.data, data, size);
+    }
+    return allocation;
+  }
+
+  size_t frameSize() const { return regionSize; }
+  const StreamBufferStats &stats() const { return streamStats; }
+
+private:
+  static constexpr unsigned MAX_FRAMES_IN_FLIGHT = 4;
+
+  unsigned char *mapped = nullptr;
+  size_t regionSize;
+  unsigned framesInFlight;
+  unsigned region = 0;
+  size_t regionUsed = 0;
+  GLsync fences[MAX_FRAMES_IN_FLIGHT] = {};
+  StreamBufferStats streamStats;
+};
+
+#endif
@@ -0,0 +1,137 @@
+#include "texture.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+static GLsizei mipLevelsFor(int width, int height) {
+  return 1 + (GLsizei)std::floor(std::log2(std::max(std::max(width, height), 1)));
+}
+
+static GLenum internalFormatFor(int channels) {
+  switch (channels) {
+  case 1:
+    return GL_R8;
+  case 2:
+    return GL_RG8;
+  case 3:
+    return GL_RGB8;
+  default:
+    return GL_RGBA8;
+  }
+}
+
+static GLenum pixelFormatFor(int channels) {
+  switch (channels) {
+  case 1:
+    return GL_RED;
+  case 2:
+    return GL_RG;
+  case 3:
+    return GL_RGB;
+  default:
+    return GL_RGBA;
+  }
+}
+
+Texture::Texture(const Image &image, const TextureParams &params) : params(params) { allocate(image); }
+
+void Texture::allocate(const Image &image) {
+  width = image.width;
+  height = image.height;
+  channels = image.channels;
+  levels = 1;
+  if (params.mipmaps) {
+    levels = mipLevelsFor(width, height);
+  }
+
+  glCreateTextures(GL_TEXTURE_2D, 1, &id);
+  glTextureParameteri(id, GL_TEXTURE_WRAP_S, params.wrap);
+  glTextureParameteri(id, GL_TEXTURE_WRAP_T, params.wrap);
+  glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, params.minFilter);
+  glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, params.magFilter);
+  glTextureStorage2D(id, levels, internalFormatFor(channels), width, height);
+  update(image, 0, 0, width, height);
+}
+
+void Texture::update(const Image &image, int x, int y, int w, int h) {
+  // stb_image rows are tightly packed, which breaks the default 4 byte alignment for odd widths of RGB images
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, image.width);
+  const unsigned char *first = image.pixels.get() + ((size_t)y * image.width + x) * image.channels;
+  glTextureSubImage2D(id, 0, x, y, w, h, pixelFormatFor(channels), GL_UNSIGNED_BYTE, first);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+  if (levels > 1) {
+    glGenerateTextureMipmap(id);
+  }
+}
+
+void Texture::respecify(const Image &image) {
+  glState().forgetTexture(id);
+  glDeleteTextures(1, &id);
+  allocate(image);
+}
+
+Texture::~Texture() {
+  glState().forgetTexture(id);
+  glDeleteTextures(1, &id);
+}
+
+size_t Texture::gpuBytes() const {
+  // RGB8 is padded to 4 bytes per texel by every driver we care about
+  size_t texelBytes = channels == 3 ? 4 : (size_t)channels;
+  size_t bytes = 0;
+  int w = width, h = height;
+  for (GLsizei level = 0; level < levels; level++) {
+    bytes += (size_t)w * h * texelBytes;
+    w = std::max(w / 2, 1);
+    h = std::max(h / 2, 1);
+  }
+  return bytes;
+}
+
+TextureArray::TextureArray(const std::vector<const Image *> &images, const TextureParams &params)
+    : layers((GLsizei)images.size()) {
+  if (!images.empty()) {
+    width = images[0]->width;
+    height = images[0]->height;
+    channels = images[0]->channels;
+  }
+  levels = params.mipmaps ? mipLevelsFor(width, height) : 1;
+
+  glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &id);
+  glTextureParameteri(id, GL_TEXTURE_WRAP_S, params.wrap);
+  glTextureParameteri(id, GL_TEXTURE_WRAP_T, params.wrap);
+  glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, params.minFilter);
+  glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, params.magFilter);
+  glTextureStorage3D(id, levels, internalFormatFor(channels), width, height, std::max(layers, 1));
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  for (GLsizei layer = 0; layer < layers; layer++) {
+    const Image &image = *images[layer];
+    if (image.width != width || image.height != height || image.channels != channels) {
+      std::cout << "ERROR::TEXTURE_ARRAY::LAYER_MISMATCH " << image.path << std::endl;
+      continue;
+    }
+    glTextureSubImage3D(
+        id, 0, 0, 0, layer, width, height, 1, pixelFormatFor(channels), GL_UNSIGNED_BYTE, image.pixels.get());
+  }
+  if (levels > 1) {
+    glGenerateTextureMipmap(id);
+  }
+}
+
+void TextureArray::update(GLsizei layer, const Image &image, int x, int y, int w, int h) {
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, image.width);
+  const unsigned char *first = image.pixels.get() + ((size_t)y * image.width + x) * image.channels;
+  glTextureSubImage3D(id, 0, x, y, layer, w, h, 1, pixelFormatFor(channels), GL_UNSIGNED_BYTE, first);
+  glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+  if (levels > 1) {
+    glGenerateTextureMipmap(id);
+  }
+}
+
+TextureArray::~TextureArray() {
+  glState().forgetTexture(id);
+  glDeleteTextures(1, &id);
+}
@@ -0,0 +1,80 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include "gl_state.hpp"
+#include "image_loader.hpp"
+#include <glad/gl.h>
+#include <cstddef>
+#include <vector>
+
+struct TextureParams {
+  GLint wrap = GL_REPEAT;
+  GLint minFilter = GL_NEAREST_MIPMAP_NEAREST;
+  GLint magFilter = GL_NEAREST;
+  bool mipmaps = true;
+
+  bool operator==(const TextureParams &other) const {
+    return wrap == other.wrap && minFilter == other.minFilter && magFilter == other.magFilter &&
+           mipmaps == other.mipmaps;
+  }
+};
+
+// 2D texture with immutable storage sized from a decoded image
+class Texture {
+public:
+  GLuint id = 0;
+  int width = 0;
+  int height = 0;
+  int channels = 0;
+  GLsizei levels = 1;
+  TextureParams params;
+
+  explicit Texture(const Image &image, const TextureParams &params = TextureParams());
+  ~Texture();
+
+  Texture(const Texture &) = delete;
+  Texture &operator=(const Texture &) = delete;
+
+  void bind(GLuint unit = 0) const { glState().bindTextureUnit(unit, id); }
+  // Re-upload a region of the base level in place and rebuild the mip chain. The image must match the texture's size
+  // and channel count.
+  void update(const Image &image, int x, int y, int w, int h);
+  // Replace the storage with one sized for the image. This changes id, so only use it when update() cannot be used.
+  void respecify(const Image &image);
+  bool matches(const Image &image) const {
+    return image.width == width && image.height == height && image.channels == channels;
+  }
+  // Video memory used by every mip level
+  size_t gpuBytes() const;
+
+private:
+  void allocate(const Image &image);
+};
+
+// Array of same-sized 2D layers, so quads drawn with different images can share one draw
+class TextureArray {
+public:
+  GLuint id = 0;
+  int width = 0;
+  int height = 0;
+  int channels = 0;
+  GLsizei layers = 0;
+  GLsizei levels = 1;
+
+  // Images must all have the same size and channel count, mismatched ones leave their layer empty
+  explicit TextureArray(const std::vector<const Image *> &images, const TextureParams &params = TextureParams());
+  ~TextureArray();
+
+  TextureArray(const TextureArray &) = delete;
+  TextureArray &operator=(const TextureArray &) = delete;
+
+  void bind(GLuint unit = 0) const { glState().bindTextureUnit(unit, id); }
+  // Re-upload a region of one layer's base level in place and rebuild the mip chain, like Texture::update()
+  void update(GLsizei layer, const Image &image, int x, int y, int w, int h);
+  // Layers cannot be resized, an image only fits if it matches the array
+  bool matches(const Image &image) const {
+    return image.width == width && image.height == height && image.channels == channels;
+  }
+};
+
+#endif
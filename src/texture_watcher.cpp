@@ -0,0 +1,222 @@
+#include "texture_watcher.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <unordered_set>
+
+TextureWatcher::TextureWatcher(int desiredChannels, bool flipVertically, std::chrono::milliseconds pollInterval)
+    : desiredChannels(desiredChannels), flipVertically(flipVertically), pollInterval(pollInterval) {
+  thread = std::thread(&TextureWatcher::watchLoop, this);
+}
+
+TextureWatcher::~TextureWatcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wakeup.notify_all();
+  thread.join();
+}
+
+void TextureWatcher::watch(const std::string &path, const Image &uploaded, std::shared_ptr<Texture> texture) {
+  Target target;
+  target.texture = texture;
+  targets[path].push_back(target);
+  addFile(path, uploaded);
+}
+
+void TextureWatcher::watch(const std::string &path,
+                           const Image &uploaded,
+                           std::shared_ptr<TextureArray> array,
+                           GLsizei layer) {
+  Target target;
+  target.array = array;
+  target.layer = layer;
+  targets[path].push_back(target);
+  addFile(path, uploaded);
+}
+
+void TextureWatcher::watchDirectory(const std::string &directory) {
+  std::lock_guard<std::mutex> lock(mutex);
+  addedDirectories.push_back(directory);
+}
+
+void TextureWatcher::onAdded(std::function<void(const Image &)> callback) { addedCallback = std::move(callback); }
+
+void TextureWatcher::addFile(const std::string &path, const Image &uploaded) {
+  // Every target of a path was built from the same file, the watcher thread keeps the first copy it gets
+  if (targets[path].size() > 1) {
+    return;
+  }
+
+  // Compare against the pixels the texture actually holds. The file may have been saved again since they were
+  // decoded, so the timestamp is left unknown and the first poll decodes and diffs the file whatever it says.
+  WatchedFile file;
+  file.path = path;
+  if (uploaded.loaded()) {
+    file.width = uploaded.width;
+    file.height = uploaded.height;
+    file.pixels.assign(uploaded.pixels.get(), uploaded.pixels.get() + uploaded.byteSize());
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  added.push_back(std::move(file));
+}
+
+void TextureWatcher::onPending(std::function<void()> callback) {
+  std::lock_guard<std::mutex> lock(mutex);
+  pendingCallback = std::move(callback);
+}
+
+size_t TextureWatcher::applyPending() {
+  std::vector<PendingUpdate> updates;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    updates.swap(pending);
+  }
+
+  size_t changed = 0;
+  for (PendingUpdate &update : updates) {
+    auto it = targets.find(update.path);
+    if (it == targets.end()) {
+      // New in a watched directory. The callback may call watch(), so the iterator is not used past this point.
+      if (addedCallback) {
+        addedCallback(update.image);
+        changed++;
+      }
+      continue;
+    }
+
+    for (const Target &target : it->second) {
+      if (std::shared_ptr<Texture> texture = target.texture.lock()) {
+        // Same size and format keeps the texture name and storage, so nothing bound to it needs to change
+        if (texture->matches(update.image)) {
+          texture->update(update.image, update.x, update.y, update.w, update.h);
+          inPlaceCount++;
+        } else {
+          texture->respecify(update.image);
+          reallocationCount++;
+        }
+        changed++;
+      } else if (std::shared_ptr<TextureArray> array = target.array.lock()) {
+        if (!array->matches(update.image)) {
+          std::cout << "ERROR::TEXTURE_WATCHER::LAYER_MISMATCH " << update.path << std::endl;
+          continue;
+        }
+        array->update(target.layer, update.image, update.x, update.y, update.w, update.h);
+        inPlaceCount++;
+        changed++;
+      }
+    }
+  }
+  return changed;
+}
+
+void TextureWatcher::watchLoop() {
+  std::vector<WatchedFile> files;
+  std::unordered_set<std::string> known;
+  std::vector<std::string> directories;
+  auto lastScan = std::chrono::steady_clock::time_point();
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wakeup.wait_for(lock, pollInterval, [this]() { return stopping; });
+      if (stopping) {
+        return;
+      }
+      for (WatchedFile &file : added) {
+        if (known.insert(file.path).second) {
+          files.push_back(std::move(file));
+        }
+      }
+      added.clear();
+      directories.insert(directories.end(), addedDirectories.begin(), addedDirectories.end());
+      addedDirectories.clear();
+    }
+
+    // A file found by a scan has no known contents, so its first poll decodes it in full and reports it
+    auto now = std::chrono::steady_clock::now();
+    if (!directories.empty() && now - lastScan >= DIRECTORY_SCAN_INTERVAL) {
+      lastScan = now;
+      for (const std::string &directory : directories) {
+        for (const std::string &path : listImages(directory)) {
+          if (known.insert(path).second) {
+            WatchedFile file;
+            file.path = path;
+            files.push_back(std::move(file));
+          }
+        }
+      }
+    }
+
+    for (WatchedFile &file : files) {
+      poll(file);
+    }
+  }
+}
+
+void TextureWatcher::poll(WatchedFile &file) {
+  std::error_code error;
+  std::filesystem::file_time_type lastWrite = std::filesystem::last_write_time(file.path, error);
+  if (error || (file.lastWrite && lastWrite == *file.lastWrite)) {
+    return;
+  }
+
+  // A file that is still being written fails to decode, leave the timestamp alone so it is retried on the next poll
+  Image image = loadImage(file.path, desiredChannels, flipVertically);
+  if (!image.loaded()) {
+    return;
+  }
+  file.lastWrite = lastWrite;
+
+  PendingUpdate update;
+  update.path = file.path;
+  update.w = image.width;
+  update.h = image.height;
+
+  // Shrink the upload to the bounding box of changed texels when the previous contents are known
+  if (image.width == file.width && image.height == file.height && file.pixels.size() == image.byteSize()) {
+    size_t rowBytes = (size_t)image.width * image.channels;
+    const unsigned char *next = image.pixels.get();
+    const unsigned char *previous = file.pixels.data();
+    int minX = image.width, maxX = -1, minY = image.height, maxY = -1;
+    for (int y = 0; y < image.height; y++) {
+      const unsigned char *nextRow = next + y * rowBytes;
+      const unsigned char *previousRow = previous + y * rowBytes;
+      if (std::memcmp(nextRow, previousRow, rowBytes) == 0) {
+        continue;
+      }
+      minY = std::min(minY, y);
+      maxY = y;
+      for (int x = 0; x < image.width; x++) {
+        if (std::memcmp(nextRow + x * image.channels, previousRow + x * image.channels, image.channels) != 0) {
+          minX = std::min(minX, x);
+          maxX = std::max(maxX, x);
+        }
+      }
+    }
+    // Touched but identical, nothing to upload
+    if (maxY < 0) {
+      return;
+    }
+    update.x = minX;
+    update.y = minY;
+    update.w = maxX - minX + 1;
+    update.h = maxY - minY + 1;
+  }
+
+  file.width = image.width;
+  file.height = image.height;
+  file.pixels.assign(image.pixels.get(), image.pixels.get() + image.byteSize());
+  update.image = std::move(image);
+
+  std::function<void()> callback;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.push_back(std::move(update));
+    callback = pendingCallback;
+  }
+  if (callback) {
+    callback();
+  }
+}
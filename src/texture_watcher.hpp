@@ -0,0 +1,106 @@
+#ifndef TEXTURE_WATCHER_H
+#define TEXTURE_WATCHER_H
+
+#include "image_loader.hpp"
+#include "texture.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Polls image files on a background thread and re-decodes them when they change. Decoded images are handed back to
+// the GL thread through applyPending(), which re-uploads only the rows and columns that differ into every texture
+// and texture array layer built from that file. Polling only reads timestamps, so the default interval is half a
+// 60 Hz frame and an edit shows up within a frame or two. Watched directories are rescanned every
+// DIRECTORY_SCAN_INTERVAL, and images that appear in them are handed to the onAdded() callback once decoded.
+//
+// Watched textures are edited in place, so they should be owned by the watcher's caller rather than shared through
+// ResourceCache, where byte-identical images from other files would change with them.
+class TextureWatcher {
+public:
+  static constexpr std::chrono::milliseconds DIRECTORY_SCAN_INTERVAL{250};
+
+  TextureWatcher(int desiredChannels,
+                 bool flipVertically,
+                 std::chrono::milliseconds pollInterval = std::chrono::milliseconds(8));
+  ~TextureWatcher();
+
+  TextureWatcher(const TextureWatcher &) = delete;
+  TextureWatcher &operator=(const TextureWatcher &) = delete;
+
+  // The image is what was uploaded into the texture, later edits are diffed against it
+  void watch(const std::string &path, const Image &uploaded, std::shared_ptr<Texture> texture);
+  void watch(const std::string &path, const Image &uploaded, std::shared_ptr<TextureArray> array, GLsizei layer);
+  // Also watch images created in the directory later. Call after watching the files already loaded from it, or they
+  // are reported as added.
+  void watchDirectory(const std::string &directory);
+  // Called on the GL thread from applyPending() with each new image, e.g. to create and watch a texture for it
+  void onAdded(std::function<void(const Image &)> callback);
+  // Called on the watcher thread whenever a decode is waiting for applyPending(), e.g. to wake a render loop that
+  // only draws on demand
+  void onPending(std::function<void()> callback);
+  // Upload finished decodes into their textures. Call once per frame on the thread that owns the GL context, returns
+  // the number of textures that changed.
+  size_t applyPending();
+
+  size_t inPlaceUploads() const { return inPlaceCount; }
+  size_t reallocations() const { return reallocationCount; }
+
+private:
+  struct WatchedFile {
+    std::string path;
+    // Unknown until the first poll, which always decodes
+    std::optional<std::filesystem::file_time_type> lastWrite;
+    // Contents of the texture, used to find the region that actually changed
+    int width = 0, height = 0;
+    std::vector<unsigned char> pixels;
+  };
+
+  // A texture or one layer of an array, built from a watched file
+  struct Target {
+    std::weak_ptr<Texture> texture;
+    std::weak_ptr<TextureArray> array;
+    GLsizei layer = 0;
+  };
+
+  struct PendingUpdate {
+    std::string path;
+    Image image;
+    int x = 0, y = 0, w = 0, h = 0;
+  };
+
+  int desiredChannels;
+  bool flipVertically;
+  std::chrono::milliseconds pollInterval;
+
+  // Owned by the GL thread
+  std::unordered_map<std::string, std::vector<Target>> targets;
+  std::function<void(const Image &)> addedCallback;
+  size_t inPlaceCount = 0;
+  size_t reallocationCount = 0;
+
+  // Shared with the watcher thread
+  std::mutex mutex;
+  std::condition_variable wakeup;
+  std::vector<WatchedFile> added;
+  std::vector<std::string> addedDirectories;
+  std::vector<PendingUpdate> pending;
+  std::function<void()> pendingCallback;
+  bool stopping = false;
+
+  std::thread thread;
+
+  void addFile(const std::string &path, const Image &uploaded);
+  void watchLoop();
+  void poll(WatchedFile &file);
+};
+
+#endif
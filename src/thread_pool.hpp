@@ -0,0 +1,52 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+class ThreadPool {
+public:
+  // threadCount of 0 uses one worker per hardware thread
+  explicit ThreadPool(unsigned threadCount = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  unsigned size() const { return (unsigned)workers.size(); }
+
+  // Queue a job and get a future for its result
+  template <typename F> std::future<std::invoke_result_t<F>> submit(F &&job) {
+    using Result = std::invoke_result_t<F>;
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(job));
+    std::future<Result> result = task->get_future();
+    enqueue([task]() { (*task)(); });
+    return result;
+  }
+
+  // Queue a job whose completion is tracked with waitIdle() instead of a future
+  void enqueue(std::function<void()> job);
+  // Block until the queue is empty and no worker is running a job
+  void waitIdle();
+
+private:
+  std::vector<std::thread> workers;
+  std::queue<std::function<void()>> jobs;
+  std::mutex mutex;
+  std::condition_variable jobAvailable;
+  std::condition_variable idle;
+  size_t activeJobs = 0;
+  bool stopping = false;
+
+  void workerLoop();
+};
+
+#endif
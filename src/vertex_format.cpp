@@ -0,0 +1,52 @@
+#include "vertex_format.hpp"
+#include <cstring>
+
+Half Half::fromFloat(float f) {
+  uint32_t x;
+  std::memcpy(&x, &f, sizeof(x));
+  uint16_t sign = (uint16_t)((x >> 16) & 0x8000);
+  uint32_t exponent = (x >> 23) & 0xff;
+  uint32_t mantissa = x & 0x7fffff;
+
+  // Infinity and NaN
+  if (exponent == 0xff) {
+    return {(uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0))};
+  }
+  int32_t halfExponent = (int32_t)exponent - 127 + 15;
+  // Too large, clamp to infinity
+  if (halfExponent >= 31) {
+    return {(uint16_t)(sign | 0x7c00)};
+  }
+  // Too small for a normal half, produce a subnormal or zero
+  if (halfExponent <= 0) {
+    if (halfExponent < -10) {
+      return {sign};
+    }
+    mantissa |= 0x800000;
+    uint32_t shift = (uint32_t)(14 - halfExponent);
+    uint32_t bits = mantissa >> shift;
+    if ((mantissa >> (shift - 1)) & 1) {
+      bits++;
+    }
+    return {(uint16_t)(sign | bits)};
+  }
+  // Round to nearest, a carry out of the mantissa correctly bumps the exponent
+  uint32_t bits = ((uint32_t)halfExponent << 10) | (mantissa >> 13);
+  if (mantissa & 0x1000) {
+    bits++;
+  }
+  return {(uint16_t)(sign | bits)};
+}
+
+PackedTexturedVertex PackedTexturedVertex::pack(const TexturedVertex &vertex) {
+  PackedTexturedVertex packed{};
+  for (int i = 0; i < 3; i++) {
+    packed.position[i] = Snorm16::fromFloat(vertex.position[i]);
+    packed.colour[i] = Unorm8::fromFloat(vertex.colour[i]);
+  }
+  packed.padding1 = {255};
+  for (int i = 0; i < 2; i++) {
+    packed.texCoord[i] = Half::fromFloat(vertex.texCoord[i]);
+  }
+  return packed;
+}
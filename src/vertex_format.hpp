@@ -0,0 +1,182 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glad/gl.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+struct VertexAttribute {
+  GLuint location;
+  GLint size;
+  GLenum type;
+  GLboolean normalized;
+  GLuint offset;
+};
+
+// Quantized component types. Each is stored as its raw integer and read by the shader as a float.
+
+// Unsigned byte mapped to [0, 1], for colours and weights
+struct Unorm8 {
+  uint8_t value;
+  static Unorm8 fromFloat(float f) { return {(uint8_t)std::lround(std::clamp(f, 0.0f, 1.0f) * 255.0f)}; }
+};
+
+// Signed short mapped to [-1, 1], for positions inside a unit box and for normals
+struct Snorm16 {
+  int16_t value;
+  static Snorm16 fromFloat(float f) { return {(int16_t)std::lround(std::clamp(f, -1.0f, 1.0f) * 32767.0f)}; }
+};
+
+// IEEE 754 half precision float, for texture coordinates
+struct Half {
+  uint16_t bits;
+  static Half fromFloat(float f);
+};
+
+// Maps a C++ component type to the GL type it is uploaded as
+template <typename T> struct ComponentType;
+template <> struct ComponentType<GLfloat> {
+  static constexpr GLenum type = GL_FLOAT;
+  static constexpr GLboolean normalized = GL_FALSE;
+};
+template <> struct ComponentType<Half> {
+  static constexpr GLenum type = GL_HALF_FLOAT;
+  static constexpr GLboolean normalized = GL_FALSE;
+};
+template <> struct ComponentType<Unorm8> {
+  static constexpr GLenum type = GL_UNSIGNED_BYTE;
+  static constexpr GLboolean normalized = GL_TRUE;
+};
+template <> struct ComponentType<Snorm16> {
+  static constexpr GLenum type = GL_SHORT;
+  static constexpr GLboolean normalized = GL_TRUE;
+};
+
+// GLSL type of an input with the given number of float components
+constexpr const char *glslFloatType(GLint size) {
+  return size == 1 ? "float" : size == 2 ? "vec2" : size == 3 ? "vec3" : "vec4";
+}
+
+// NUL terminated GLSL source built in a constant expression. Capacity is fixed, so build it into a constexpr
+// variable, where text that does not fit is a compile error.
+template <size_t Capacity> struct GlslSource {
+  char text[Capacity + 1] = {};
+  size_t length = 0;
+
+  constexpr void append(const char *source) {
+    while (*source != '\0') {
+      put(*source++);
+    }
+  }
+  constexpr void append(GLuint number) {
+    char digits[10] = {};
+    size_t count = 0;
+    do {
+      digits[count++] = (char)('0' + number % 10);
+      number /= 10;
+    } while (number > 0);
+    while (count > 0) {
+      put(digits[--count]);
+    }
+  }
+  template <size_t OtherCapacity>
+  constexpr GlslSource<Capacity + OtherCapacity> operator+(const GlslSource<OtherCapacity> &other) const {
+    GlslSource<Capacity + OtherCapacity> joined;
+    joined.append(text);
+    joined.append(other.text);
+    return joined;
+  }
+  const char *c_str() const { return text; }
+
+private:
+  // Past Capacity this indexes out of bounds, which a constant expression rejects, so the terminator is never lost
+  constexpr void put(char c) { text[length < Capacity ? length++ : sizeof(text)] = c; }
+};
+
+// Room for one input declaration with a name of up to 40 characters
+constexpr size_t GLSL_INPUT_BYTES = 80;
+
+// One vertex attribute of N components of type T
+template <typename T, GLint N> struct Attrib {
+  using Component = T;
+  static constexpr GLint size = N;
+  // Attributes start on 4 byte boundaries, which every driver fetches without a slow path
+  static constexpr GLuint bytes = (sizeof(T) * N + 3) & ~3u;
+};
+
+// Vertex layout described at compile time. Attribute locations follow the order of the template arguments, offsets
+// and stride are computed from the attribute sizes.
+template <typename... Attribs> struct VertexFormat {
+  static constexpr size_t attributeCount = sizeof...(Attribs);
+  static constexpr GLsizei stride = (GLsizei)(0 + ... + Attribs::bytes);
+
+  // firstLocation shifts every location, so a second format (e.g. per-instance data) can follow the first one
+  static constexpr std::array<VertexAttribute, attributeCount> attributes(GLuint firstLocation = 0) {
+    std::array<VertexAttribute, attributeCount> result{};
+    GLuint index = 0, offset = 0;
+    ((result[index] = {firstLocation + index,
+                       Attribs::size,
+                       ComponentType<typename Attribs::Component>::type,
+                       ComponentType<typename Attribs::Component>::normalized,
+                       offset},
+      offset += Attribs::bytes,
+      index++),
+     ...);
+    return result;
+  }
+
+  // GLSL input declarations matching the layout, to prepend to a vertex shader body. Only the names come from the
+  // caller, locations and types follow from the format.
+  static constexpr GlslSource<attributeCount * GLSL_INPUT_BYTES>
+  glslInputs(const std::array<const char *, attributeCount> &names, GLuint firstLocation = 0) {
+    GlslSource<attributeCount * GLSL_INPUT_BYTES> declarations;
+    std::array<VertexAttribute, attributeCount> layout = attributes(firstLocation);
+    for (size_t i = 0; i < attributeCount; i++) {
+      declarations.append("layout(location = ");
+      declarations.append(layout[i].location);
+      declarations.append(") in ");
+      declarations.append(glslFloatType(layout[i].size));
+      declarations.append(" ");
+      declarations.append(names[i]);
+      declarations.append(";\n");
+    }
+    return declarations;
+  }
+
+  // Record the attribute formats on a vertex array, all sourced from one buffer binding
+  static void setup(GLuint vao, GLuint bindingIndex = 0, GLuint firstLocation = 0) {
+    for (const VertexAttribute &attribute : attributes(firstLocation)) {
+      glEnableVertexArrayAttrib(vao, attribute.location);
+      glVertexArrayAttribFormat(
+          vao, attribute.location, attribute.size, attribute.type, attribute.normalized, attribute.offset);
+      glVertexArrayAttribBinding(vao, attribute.location, bindingIndex);
+    }
+  }
+};
+
+// Layout read by texture.vert
+using TexturedFormat = VertexFormat<Attrib<GLfloat, 3>, Attrib<GLfloat, 3>, Attrib<GLfloat, 2>>;
+struct TexturedVertex {
+  GLfloat position[3];
+  GLfloat colour[3];
+  GLfloat texCoord[2];
+};
+static_assert(sizeof(TexturedVertex) == TexturedFormat::stride);
+
+// Same attributes as TexturedFormat in 16 bytes instead of 32. Positions must lie inside [-1, 1].
+using PackedTexturedFormat = VertexFormat<Attrib<Snorm16, 3>, Attrib<Unorm8, 3>, Attrib<Half, 2>>;
+struct PackedTexturedVertex {
+  Snorm16 position[3];
+  Snorm16 padding0;
+  Unorm8 colour[3];
+  Unorm8 padding1;
+  Half texCoord[2];
+
+  static PackedTexturedVertex pack(const TexturedVertex &vertex);
+};
+static_assert(sizeof(PackedTexturedVertex) == PackedTexturedFormat::stride);
+
+#endif
@@ -0,0 +1,102 @@
+#include "vertex_pulling.hpp"
+#include "gl_state.hpp"
+#include <iostream>
+
+PulledMeshes::PulledMeshes(size_t vertexBytes, size_t indexCapacity, size_t meshCapacity)
+    : vertexBytes(vertexBytes), indexCapacity(indexCapacity), meshCapacity(meshCapacity) {
+  vertexBuffer = std::make_unique<Buffer>(vertexBytes, nullptr, (GLbitfield)GL_DYNAMIC_STORAGE_BIT);
+  indexBuffer = std::make_unique<Buffer>(indexCapacity * sizeof(uint32_t), nullptr, (GLbitfield)GL_DYNAMIC_STORAGE_BIT);
+  meshBuffer = std::make_unique<Buffer>(meshCapacity * sizeof(PulledMesh), nullptr, (GLbitfield)GL_DYNAMIC_STORAGE_BIT);
+
+  // No attributes at all, the vertex array only carries the index buffer
+  glCreateVertexArrays(1, &vao);
+  glState().vertexArrayElementBuffer(vao, indexBuffer->id);
+}
+
+PulledMeshes::~PulledMeshes() {
+  glState().forgetVertexArray(vao);
+  glDeleteVertexArrays(1, &vao);
+}
+
+uint32_t PulledMeshes::addMesh(PulledFormat format,
+                               GLsizei stride,
+                               const void *vertices,
+                               size_t vertexCount,
+                               const uint32_t *indices,
+                               size_t indexCount) {
+  size_t bytes = vertexCount * stride;
+  if (bytesUsed + bytes > vertexBytes || indicesUsed + indexCount > indexCapacity || meshes.size() >= meshCapacity) {
+    std::cout << "ERROR::VERTEX_PULLING::OUT_OF_SPACE" << std::endl;
+    return INVALID_MESH;
+  }
+
+  PulledMesh record{(GLuint)(bytesUsed / 4), (GLuint)format, (GLuint)(stride / 4), 0};
+  glNamedBufferSubData(vertexBuffer->id, (GLintptr)bytesUsed, (GLsizeiptr)bytes, vertices);
+  glNamedBufferSubData(indexBuffer->id,
+                       (GLintptr)(indicesUsed * sizeof(uint32_t)),
+                       (GLsizeiptr)(indexCount * sizeof(uint32_t)),
+                       indices);
+  glNamedBufferSubData(
+      meshBuffer->id, (GLintptr)(meshes.size() * sizeof(PulledMesh)), (GLsizeiptr)sizeof(PulledMesh), &record);
+
+  meshes.push_back({(GLuint)indicesUsed, (GLuint)indexCount});
+  bytesUsed += bytes;
+  indicesUsed += indexCount;
+  return (uint32_t)(meshes.size() - 1);
+}
+
+void PulledMeshes::bind() const {
+  glState().bindVertexArray(vao);
+  glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, VERTEX_BINDING, vertexBuffer->id);
+  glState().bindBufferBase(GL_SHADER_STORAGE_BUFFER, MESH_BINDING, meshBuffer->id);
+}
+
+void PulledMeshes::draw(uint32_t mesh) const {
+  if (mesh >= meshes.size()) {
+    return;
+  }
+  // The base instance only carries the mesh index to the shader
+  const MeshRange &range = meshes[mesh];
+  glDrawElementsInstancedBaseInstance(GL_TRIANGLES,
+                                      (GLsizei)range.indexCount,
+                                      GL_UNSIGNED_INT,
+                                      (const void *)(range.firstIndex * sizeof(uint32_t)),
+                                      1,
+                                      mesh);
+}
+
+void PulledMeshes::recordBind(CommandBuffer &commands) const {
+  commands.bindVertexArray(vao);
+  commands.bindBufferRange(GL_SHADER_STORAGE_BUFFER, VERTEX_BINDING, vertexBuffer->id, 0, 0);
+  commands.bindBufferRange(GL_SHADER_STORAGE_BUFFER, MESH_BINDING, meshBuffer->id, 0, 0);
+}
+
+void PulledMeshes::record(CommandBuffer &commands, uint32_t mesh) const {
+  if (mesh >= meshes.size()) {
+    return;
+  }
+  const MeshRange &range = meshes[mesh];
+  commands.drawElements(
+      GL_TRIANGLES, (GLsizei)range.indexCount, GL_UNSIGNED_INT, range.firstIndex * sizeof(uint32_t), 1, 0, mesh);
+}
+
+void PulledMeshes::drawAll() {
+  if (meshes.empty()) {
+    return;
+  }
+  // The meshes never move, so the commands only change when meshes are added
+  if (commandMeshes != meshes.size()) {
+    std::vector<DrawElementsIndirectCommand> commands;
+    commands.reserve(meshes.size());
+    for (size_t i = 0; i < meshes.size(); i++) {
+      commands.push_back({meshes[i].indexCount, 1, meshes[i].firstIndex, 0, (GLuint)i});
+    }
+    commandBuffer =
+        std::make_unique<Buffer>(commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+    commandMeshes = meshes.size();
+  }
+
+  bind();
+  glState().bindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer->id);
+  glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, (GLsizei)commandMeshes, 0);
+}
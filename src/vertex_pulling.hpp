@@ -0,0 +1,99 @@
+#ifndef VERTEX_PULLING_H
+#define VERTEX_PULLING_H
+
+#include "buffer.hpp"
+#include "command_buffer.hpp"
+#include "indirect_batch.hpp"
+#include "vertex_format.hpp"
+#include <glad/gl.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Vertex layouts texture_pulled.vert knows how to decode
+enum class PulledFormat : GLuint {
+  Textured = 0,
+  PackedTextured = 1,
+};
+
+template <typename Format> struct PulledFormatOf;
+template <> struct PulledFormatOf<TexturedFormat> {
+  static constexpr PulledFormat value = PulledFormat::Textured;
+};
+template <> struct PulledFormatOf<PackedTexturedFormat> {
+  static constexpr PulledFormat value = PulledFormat::PackedTextured;
+};
+
+// Per-mesh record read by texture_pulled.vert from a storage buffer, std430 layout
+struct PulledMesh {
+  // First 32 bit word of the mesh's vertices in the vertex storage buffer
+  GLuint firstWord;
+  GLuint format;
+  GLuint strideWords;
+  GLuint padding;
+};
+static_assert(sizeof(PulledMesh) == 16);
+
+// Meshes whose vertices the shader fetches itself from a storage buffer by gl_VertexID. The single vertex array has no
+// attributes, only the shared index buffer, so meshes of different layouts draw without any state change between them
+// and drawAll() covers all of them with one glMultiDrawElementsIndirect. Each draw finds its mesh record through
+// gl_BaseInstance.
+class PulledMeshes {
+public:
+  static constexpr uint32_t INVALID_MESH = UINT32_MAX;
+  static constexpr GLuint VERTEX_BINDING = 1;
+  static constexpr GLuint MESH_BINDING = 2;
+
+  PulledMeshes(size_t vertexBytes, size_t indexCapacity, size_t meshCapacity);
+  ~PulledMeshes();
+
+  PulledMeshes(const PulledMeshes &) = delete;
+  PulledMeshes &operator=(const PulledMeshes &) = delete;
+
+  // Copy a mesh into the shared buffers. Indices are relative to the mesh's own vertices. Returns INVALID_MESH when
+  // the buffers are full.
+  template <typename Format, typename Vertex>
+  uint32_t addMesh(const Vertex *vertices, size_t vertexCount, const uint32_t *indices, size_t indexCount) {
+    static_assert(sizeof(Vertex) == Format::stride, "vertex struct does not match its format");
+    static_assert(Format::stride % 4 == 0, "pulled vertices are read as 32 bit words");
+    return addMesh(PulledFormatOf<Format>::value, Format::stride, vertices, vertexCount, indices, indexCount);
+  }
+
+  // Bind the vertex array and storage buffers, after which draw() issues nothing but the draw call
+  void bind() const;
+  void draw(uint32_t mesh) const;
+  // Record bind() and draw() into command buffers, on any thread as long as no mesh is being added
+  void recordBind(CommandBuffer &commands) const;
+  void record(CommandBuffer &commands, uint32_t mesh) const;
+  // Draw every mesh with one indirect call, binding first
+  void drawAll();
+
+  size_t meshCount() const { return meshes.size(); }
+
+private:
+  struct MeshRange {
+    GLuint firstIndex;
+    GLuint indexCount;
+  };
+
+  GLuint vao = 0;
+  std::unique_ptr<Buffer> vertexBuffer;
+  std::unique_ptr<Buffer> indexBuffer;
+  std::unique_ptr<Buffer> meshBuffer;
+  std::unique_ptr<Buffer> commandBuffer;
+  size_t vertexBytes, indexCapacity, meshCapacity;
+  size_t bytesUsed = 0, indicesUsed = 0;
+  std::vector<MeshRange> meshes;
+  // Meshes covered by commandBuffer, it is rebuilt when more have been added since
+  size_t commandMeshes = 0;
+
+  uint32_t addMesh(PulledFormat format,
+                   GLsizei stride,
+                   const void *vertices,
+                   size_t vertexCount,
+                   const uint32_t *indices,
+                   size_t indexCount);
+};
+
+#endif